@@ -0,0 +1,141 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Alessio Zattoni                                    *
+ *                                                                          *
+ * This file is part of CrossCorrelation.                                   *
+ *                                                                          *
+ *   CrossCorrelation is free software: you can redistribute it and/or      *
+ *   modify it under the terms of the GNU Lesser General Public License as  *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   CrossCorrelation is distributed in the hope that it will be            *
+ *   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+
+
+/**
+ * @file    batch_benchmark.cpp
+ * @author  Alessio Zattoni
+ * @date
+ * @brief   Questo file contiene il benchmark CPU del matching a lotti di coppie stereo, confrontato con
+ *          le chiamate singole seriali e parallele, sui formati di matrice d'interesse per il progetto
+ *
+ * ...
+ */
+
+
+
+#include "stereodepth/plan.hpp"
+#include "analysis.hpp"
+#include "formats.hpp"
+
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#define KERNEL_SIZE         5
+#define MAX_DISPARITY       64
+#define BATCH_SIZE          8
+#define ITERATIONS          3
+// Indica il range di valori con cui verrà riempita la matrice → da 0 a RANGE -1
+#define RANGE               50
+
+
+// Coppie al secondo dato il tempo medio in millisecondi di un lotto
+static double pairsPerSecond(const std::vector<double> &times)
+{
+    if (times.empty()) return 0.0;
+    const double mean = std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+    return mean > 0.0 ? BATCH_SIZE * 1000.0 / mean : 0.0;
+}
+
+
+int main()
+{
+    using Traits = WideMatchingTraits<uint8_t>;
+
+    std::srand(time(NULL));
+
+    stereodepth::ThreadPool &pool = stereodepth::ThreadPool::global();
+
+    std::string title("\n=============================================================================");
+    for (auto format : form) {
+        // I formati sono {larghezza, altezza}
+        const std::size_t cols = format.getRows();
+        const std::size_t rows = format.getCols();
+        const std::size_t dst_size = (rows - (KERNEL_SIZE - 1)) * (cols - (KERNEL_SIZE - 1));
+
+        std::vector<std::vector<uint8_t>> left(BATCH_SIZE, std::vector<uint8_t>(rows * cols));
+        std::vector<std::vector<uint8_t>> right(BATCH_SIZE, std::vector<uint8_t>(rows * cols));
+        std::vector<std::vector<Traits::output_type>> dest(BATCH_SIZE, std::vector<Traits::output_type>(dst_size));
+        std::vector<const uint8_t*> src1, src2;
+        std::vector<Traits::output_type*> dst;
+
+        for (std::size_t n = 0; n < BATCH_SIZE; n++) {
+            for (std::size_t i = 0; i < rows * cols; i++) {
+                left[n][i] = rand() % RANGE;
+                right[n][i] = rand() % RANGE;
+            }
+            src1.push_back(left[n].data());
+            src2.push_back(right[n].data());
+            dst.push_back(dest[n].data());
+        }
+
+        // benchmark una chiamata seriale per coppia
+        parco::analysis::TimeVector<double> _serial;
+        // benchmark una chiamata OpenMP per coppia
+        parco::analysis::TimeVector<double> _parallel;
+        // benchmark lotto unico sul thread pool
+        parco::analysis::TimeVector<double> _batch;
+
+        for (std::size_t i = 0; i < ITERATIONS; i++) {
+            _serial.start();
+            for (std::size_t n = 0; n < BATCH_SIZE; n++) {
+                argMaxCorrMatDispatch<uint8_t, Traits>(src1[n], src2[n], dst[n], cols, rows, KERNEL_SIZE, 0, MAX_DISPARITY);
+            }
+            _serial.stop();
+
+            _parallel.start();
+            for (std::size_t n = 0; n < BATCH_SIZE; n++) {
+                argMaxCorrMatParallel<uint8_t, Traits>(src1[n], src2[n], dst[n], cols, rows, KERNEL_SIZE, 0, 0, MAX_DISPARITY);
+            }
+            _parallel.stop();
+
+            _batch.start();
+            stereodepth::argMaxCorrMatBatch<uint8_t, Traits>(src1.data(), src2.data(), dst.data(), BATCH_SIZE,
+                                                             cols, rows, KERNEL_SIZE, 0, MAX_DISPARITY, pool);
+            _batch.stop();
+        }
+
+        std::map<std::string, std::vector<double>&> series = {
+            {"cpu_serial_exec", _serial.values()},
+            {"cpu_parallel_exec", _parallel.values()},
+            {"cpu_batch_exec", _batch.values()}};
+
+        parco::analysis::Matrix<double> matrix_analysis(series,
+            "matrix: " + std::to_string(rows) + "x" + std::to_string(cols) +
+            ",kernel: " + std::to_string(KERNEL_SIZE) + "x" + std::to_string(KERNEL_SIZE) +
+            ",disparity: 0-" + std::to_string(MAX_DISPARITY) +
+            ",batch: " + std::to_string(BATCH_SIZE) +
+            ",threads: " + std::to_string(pool.num_threads()));
+
+        // prima del dump, che svuota i tempi
+        std::cout << "pairs/s serial: " << pairsPerSecond(_serial.values())
+                  << ", parallel: " << pairsPerSecond(_parallel.values())
+                  << ", batch: " << pairsPerSecond(_batch.values()) << std::endl;
+        matrix_analysis.show_analysis();
+        matrix_analysis.dump_analysis("results/batch");
+        std::cout << title + "\n\t\tEND\n" + std::string(title.size(), '=') +  "\n\n";
+    }
+
+    exit(EXIT_SUCCESS);
+}
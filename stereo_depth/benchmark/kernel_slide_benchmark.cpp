@@ -0,0 +1,150 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Alessio Zattoni                                    *
+ *                                                                          *
+ * This file is part of CrossCorrelation.                                   *
+ *                                                                          *
+ *   CrossCorrelation is free software: you can redistribute it and/or      *
+ *   modify it under the terms of the GNU Lesser General Public License as  *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   CrossCorrelation is distributed in the hope that it will be            *
+ *   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+
+
+/**
+ * @file    kernel_slide_benchmark.cpp
+ * @author  Alessio Zattoni
+ * @date
+ * @brief   Questo file contiene il benchmark CPU di Math::kernel_slide con l'operazione passata come
+ *          std::function e come funtore template, sui formati di matrice d'interesse per il progetto
+ *
+ * ...
+ */
+
+
+
+#include "stereodepth/math.hpp"
+#include "analysis.hpp"
+#include "formats.hpp"
+
+#include <cstdlib>
+#include <ctime>
+#include <functional>
+#include <map>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#define KERNEL_SIZE         5
+#define ITERATIONS          3
+// Indica il range di valori con cui verrà riempita la matrice → da 0 a RANGE -1
+#define RANGE               50
+
+
+using stereodepth::Math;
+using stereodepth::SizeType;
+
+// Operazione type-erased, come la accetta il vecchio overload
+using Operation = std::function<void(float*, Math::Shape2d, Math::Coord2d,
+                                     const float*, Math::Shape3d,
+                                     const float*, Math::Shape2d, Math::Shape2d, Math::Shape2d,
+                                     int64_t, int64_t)>;
+
+
+static double mean(const std::vector<double> &times)
+{
+    return times.empty() ? 0.0 : std::accumulate(times.begin(), times.end(), 0.0) / times.size();
+}
+
+
+int main()
+{
+    std::srand(time(NULL));
+
+    std::string title("\n=============================================================================");
+    for (auto format : form) {
+        // I formati sono {larghezza, altezza}
+        const std::size_t cols = format.getRows();
+        const std::size_t rows = format.getCols();
+        if (rows < KERNEL_SIZE || cols < KERNEL_SIZE) continue;
+
+        std::vector<float> src(rows * cols), kernel(KERNEL_SIZE * KERNEL_SIZE);
+        std::vector<float> dest((rows - (KERNEL_SIZE - 1)) * (cols - (KERNEL_SIZE - 1)));
+        for (std::size_t i = 0; i < rows * cols; i++) {
+            src[i] = rand() % RANGE;
+        }
+        for (auto &v : kernel) {
+            v = rand() % RANGE;
+        }
+
+        const Math::Shape3d src_shape(rows, cols, 1);
+        const Math::Shape2d k_shape(KERNEL_SIZE, KERNEL_SIZE);
+
+        // Lo stesso funtore in una lambda senza interior(): una sola regione con i controlli di padding
+        const auto single_region = [](float *d, const Math::Shape2d &d_shape, Math::Coord2d d_coord,
+                                      const float *s, const Math::Shape3d &s_shape,
+                                      const float *k, const Math::Shape2d &k_real_shape,
+                                      const Math::Shape2d &k_sh, const Math::Shape2d &k_offset,
+                                      int64_t row, int64_t col) {
+            Math::CrossCorrelationOp()(d, d_shape, d_coord, s, s_shape, k, k_real_shape, k_sh, k_offset, row, col);
+        };
+
+        // benchmark operazione via std::function
+        parco::analysis::TimeVector<double> _function;
+        // benchmark operazione via funtore template, in una sola regione
+        parco::analysis::TimeVector<double> _single;
+        // benchmark operazione via funtore template, con interno e bordo separati
+        parco::analysis::TimeVector<double> _functor;
+
+        for (std::size_t i = 0; i < ITERATIONS; i++) {
+            _function.start();
+            Math::kernel_slide<float>(Operation(Math::CrossCorrelationOp()), dest.data(), src.data(), src_shape,
+                                      kernel.data(), k_shape, k_shape, {0, 0});
+            _function.stop();
+
+            _single.start();
+            Math::kernel_slide<float>(single_region, dest.data(), src.data(), src_shape,
+                                      kernel.data(), k_shape, k_shape, {0, 0});
+            _single.stop();
+
+            _functor.start();
+            Math::kernel_slide<float>(Math::CrossCorrelationOp(), dest.data(), src.data(), src_shape,
+                                      kernel.data(), k_shape, k_shape, {0, 0});
+            _functor.stop();
+        }
+
+        std::map<std::string, std::vector<double>&> series = {
+            {"cpu_function_exec", _function.values()},
+            {"cpu_functor_single_exec", _single.values()},
+            {"cpu_functor_exec", _functor.values()}};
+
+        parco::analysis::Matrix<double> matrix_analysis(series,
+            "matrix: " + std::to_string(rows) + "x" + std::to_string(cols) +
+            ",kernel: " + std::to_string(KERNEL_SIZE) + "x" + std::to_string(KERNEL_SIZE));
+
+        // prima del dump, che svuota i tempi; i due guadagni sono misurati separatamente
+        const double single = mean(_single.values());
+        const double functor = mean(_functor.values());
+        std::cout << "speedup functor / std::function (una regione): "
+                  << (single > 0.0 ? mean(_function.values()) / single : 0.0) << std::endl;
+        std::cout << "speedup interno e bordo / una regione: "
+                  << (functor > 0.0 ? single / functor : 0.0) << std::endl;
+        // Senza padding l'intera destinazione è interna: sorgente letta e destinazione scritta una volta
+        const double bytes = double(src.size() + kernel.size() + dest.size()) * sizeof(float);
+        std::cout << "banda interno (GB/s): "
+                  << (functor > 0.0 ? bytes / (functor * 1e6) : 0.0) << std::endl;
+        matrix_analysis.show_analysis();
+        matrix_analysis.dump_analysis("results/kernel_slide");
+        std::cout << title + "\n\t\tEND\n" + std::string(title.size(), '=') +  "\n\n";
+    }
+
+    exit(EXIT_SUCCESS);
+}
@@ -0,0 +1,124 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Alessio Zattoni                                    *
+ *                                                                          *
+ * This file is part of CrossCorrelation.                                   *
+ *                                                                          *
+ *   CrossCorrelation is free software: you can redistribute it and/or      *
+ *   modify it under the terms of the GNU Lesser General Public License as  *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   CrossCorrelation is distributed in the hope that it will be            *
+ *   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+
+
+/**
+ * @file    pyramid_benchmark.cpp
+ * @author  Alessio Zattoni
+ * @date
+ * @brief   Questo file contiene il benchmark CPU della cross-correlazione coarse-to-fine
+ *          confrontata con la ricerca piatta, sui formati di matrice d'interesse per il progetto
+ *
+ * ...
+ */
+
+
+
+#include "stereodepth/pyramid.hpp"
+#include "analysis.hpp"
+#include "formats.hpp"
+
+#include <cstdlib>
+#include <ctime>
+#include <map>
+#include <string>
+#include <vector>
+
+#define KERNEL_SIZE_MIN     3
+#define KERNEL_SIZE_MAX     7
+#define PYRAMID_LEVELS_MAX  3
+#define PYRAMID_RADIUS      2
+#define MAX_DISPARITY       128
+#define ITERATIONS          3
+// Indica il range di valori con cui verrà riempita la matrice → da 0 a RANGE -1
+#define RANGE               50
+
+
+int main()
+{
+    using Traits = WideMatchingTraits<uint8_t>;
+
+    std::srand(time(NULL));
+
+    std::string title("\n=============================================================================");
+    for (auto format : form) {
+        // I formati sono {larghezza, altezza}
+        const std::size_t cols = format.getRows();
+        const std::size_t rows = format.getCols();
+
+        std::vector<uint8_t> src1(rows * cols), src2(rows * cols);
+        for (std::size_t i = 0; i < rows * cols; i++) {
+            src1[i] = rand() % RANGE;
+            src2[i] = rand() % RANGE;
+        }
+
+        for (std::size_t kernel_size = KERNEL_SIZE_MIN; kernel_size <= rows && kernel_size <= cols && kernel_size <= KERNEL_SIZE_MAX; kernel_size += 2) {
+            std::vector<Traits::output_type> dest((rows - (kernel_size - 1)) * (cols - (kernel_size - 1)));
+
+            // benchmark ricerca piatta sullo stesso intervallo della piramide
+            parco::analysis::TimeVector<double> _flat;
+
+            for (std::size_t i = 0; i < ITERATIONS; i++) {
+                _flat.start();
+                argMaxCorrMatDispatch<uint8_t, Traits>(src1.data(), src2.data(), dest.data(), cols, rows, kernel_size, 0, MAX_DISPARITY);
+                _flat.stop();
+            }
+
+            // benchmark ricerca piatta sull'intero intervallo, senza limite di disparità
+            parco::analysis::TimeVector<double> _flat_full;
+
+            for (std::size_t i = 0; i < ITERATIONS; i++) {
+                _flat_full.start();
+                argMaxCorrMatDispatch<uint8_t, Traits>(src1.data(), src2.data(), dest.data(), cols, rows, kernel_size);
+                _flat_full.stop();
+            }
+
+            // benchmark piramide con 1 .. PYRAMID_LEVELS_MAX livelli
+            std::vector<parco::analysis::TimeVector<double>> _pyr(PYRAMID_LEVELS_MAX);
+
+            for (std::size_t levels = 1; levels <= PYRAMID_LEVELS_MAX; levels++) {
+                for (std::size_t i = 0; i < ITERATIONS; i++) {
+                    _pyr[levels - 1].start();
+                    argMaxCorrMatPyramid<uint8_t, Traits>(src1.data(), src2.data(), dest.data(), cols, rows, kernel_size,
+                                                          levels, PYRAMID_RADIUS, 0, MAX_DISPARITY);
+                    _pyr[levels - 1].stop();
+                }
+            }
+
+            std::map<std::string, std::vector<double>&> series = {{"cpu_flat_exec", _flat.values()},
+                                                                  {"cpu_flat_full_exec", _flat_full.values()}};
+            for (std::size_t levels = 1; levels <= PYRAMID_LEVELS_MAX; levels++) {
+                series.emplace("cpu_pyr" + std::to_string(levels) + "_exec", _pyr[levels - 1].values());
+            }
+
+            parco::analysis::Matrix<double> matrix_analysis(series,
+                "matrix: " + std::to_string(rows) + "x" + std::to_string(cols) +
+                ",kernel: " + std::to_string(kernel_size) + "x" + std::to_string(kernel_size) +
+                ",disparity: 0-" + std::to_string(MAX_DISPARITY) +
+                ",radius: " + std::to_string(PYRAMID_RADIUS));
+
+            matrix_analysis.show_analysis();
+            matrix_analysis.dump_analysis("results/pyramid");
+            std::cout << title + "\n\t\tEND\n" + std::string(title.size(), '=') +  "\n\n";
+        }
+    }
+
+    exit(EXIT_SUCCESS);
+}
@@ -36,49 +36,13 @@
 #include "cuda_cross_correlation.cuh"
 #include "test_seq_par.hpp"
 #include "analysis.hpp"
+#include "formats.hpp"
 #include <fstream>
 #include <cstdio>
 
 // Indica il range di valori con cui verrà riempita la matrice → da 0 a RANGE -1
 #define RANGE           50
 
-// Rappresenta una matrice in formato standard es(HD, 2k, 4K)
-namespace format {
-    class standardFormat{
-        private:
-            const std::size_t rows;
-            const std::size_t cols;
-        
-        public:
-            standardFormat(int rows, int cols) : cols(cols), rows(rows) {};
-
-            inline const std::size_t getRows() const
-            {
-                return rows;
-            }
-
-            inline std::size_t getCols() const
-            {
-                return cols;
-            }
-
-            friend std::ostream& operator << (std::ostream& os, const format::standardFormat& format)
-            {
-                os << "\nRows: " << format.rows
-                   << "\nCols: " << format.cols << std::endl;
-                return os;
-            }
-    };
-}
-
-// Rappresenta dei formati standard utilizzati in fase di benchmark, se presente un nuovo formato basta aggiungerlo qui
-const static std::vector<format::standardFormat> form = {   {1344, 376}, 
-                                                            {2560, 720},
-                                                            {3840, 1080},
-                                                            {4416, 1242}    };
-
-
-
 /**
  * @brief   Questa funzione esegue il benchmark della matrice \p rows x \p cols, con un kernel di dimensione \p kernel_size
  *          e blocchi di thread della dimensione \p block_dim_x x \p block_dim_y
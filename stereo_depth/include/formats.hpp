@@ -0,0 +1,72 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Alessio Zattoni                                    *
+ *                                                                          *
+ * This file is part of CrossCorrelation.                                   *
+ *                                                                          *
+ *   CrossCorrelation is free software: you can redistribute it and/or      *
+ *   modify it under the terms of the GNU Lesser General Public License as  *
+ *   published by the Free Software Foundation, either version 3 of the     * 
+ *   License, or (at your option) any later version.                        * 
+ *                                                                          *
+ *   CrossCorrelation is distributed in the hope that it will be            *
+ *   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+
+
+/**
+ * @file    formats.hpp
+ * @author  Alessio Zattoni
+ * @date 
+ * @brief   Questo file contiene i formati di matrice usati dai benchmark, condivisi tra le versioni CPU e GPU
+ *
+ * ...
+ */
+
+
+
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include <vector>
+
+// Rappresenta una matrice in formato standard es(HD, 2k, 4K)
+namespace format {
+    class standardFormat{
+        private:
+            const std::size_t rows;
+            const std::size_t cols;
+        
+        public:
+            standardFormat(int rows, int cols) : cols(cols), rows(rows) {};
+
+            inline const std::size_t getRows() const
+            {
+                return rows;
+            }
+
+            inline std::size_t getCols() const
+            {
+                return cols;
+            }
+
+            friend std::ostream& operator << (std::ostream& os, const format::standardFormat& format)
+            {
+                os << "\nRows: " << format.rows
+                   << "\nCols: " << format.cols << std::endl;
+                return os;
+            }
+    };
+}
+
+// Rappresenta dei formati standard utilizzati in fase di benchmark, se presente un nuovo formato basta aggiungerlo qui
+const static std::vector<format::standardFormat> form = {   {1344, 376}, 
+                                                            {2560, 720},
+                                                            {3840, 1080},
+                                                            {4416, 1242}    };
@@ -0,0 +1,358 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Alessio Zattoni                                    *
+ *                                                                          *
+ * This file is part of CrossCorrelation.                                   *
+ *                                                                          *
+ *   CrossCorrelation is free software: you can redistribute it and/or      *
+ *   modify it under the terms of the GNU Lesser General Public License as  *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   CrossCorrelation is distributed in the hope that it will be            *
+ *   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+
+
+/**
+ * @file census.hpp
+ * @author Alessio Zattoni
+ * @date
+ * @brief Questo file contiene il matching basato sulla trasformata census e sulla distanza di Hamming
+ *
+ * Il descrittore census di un pixel codifica in un intero a 64 bit il confronto tra il pixel e i suoi vicini
+ * in una finestra \p CENSUS_WINDOW_HEIGHT X \p CENSUS_WINDOW_WIDTH. I descrittori si calcolano una sola volta
+ * per frame e il costo di un candidato è la distanza di Hamming tra due descrittori (XOR + popcount):
+ * nessuna moltiplicazione per candidato e nessuna dipendenza dall'esposizione assoluta delle due immagini.
+ */
+
+
+
+#pragma once
+
+#include "stereodepth/cross_correlation.hpp"
+#include "stereodepth/cost_volume.hpp"
+
+
+/// Altezza della finestra census
+#define CENSUS_WINDOW_HEIGHT 7
+/// Lunghezza della finestra census: 7 X 9 - 1 = 62 bit per descrittore
+#define CENSUS_WINDOW_WIDTH 9
+/// Costo massimo di un candidato: numero di bit del descrittore
+#define CENSUS_MAX_COST (CENSUS_WINDOW_HEIGHT * CENSUS_WINDOW_WIDTH - 1)
+
+
+/**
+ * @brief Calcola la distanza di Hamming tra due descrittori census.
+ *
+ * @param[in]   a   Primo descrittore
+ * @param[in]   b   Secondo descrittore
+ *
+ * @return Numero di bit diversi tra \p a e \p b
+ * @retval std::uint32_t
+*/
+inline std::uint32_t hammingDistance(const std::uint64_t a, const std::uint64_t b)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return static_cast<std::uint32_t>(__builtin_popcountll(a ^ b));
+#else
+    std::uint64_t v = a ^ b;
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0F0F0F0F0F0F0F0Full;
+    return static_cast<std::uint32_t>((v * 0x0101010101010101ull) >> 56);
+#endif
+}
+
+
+/**
+ * @brief Calcola la trasformata census della matrice \p src.
+ * @note  → Per ogni pixel il bit corrispondente ad un vicino vale 1 se il vicino è minore del pixel centrale;
+ *          i vicini sono visitati per righe, il pixel centrale è escluso. \n
+ *        → Ai bordi le coordinate dei vicini sono limitate alla matrice (bordo replicato), quindi
+ *          \p dst ha la stessa dimensione di \p src. \n
+ *
+ * @tparam      T           Tipo della matrice sorgente
+ *
+ * @param[in]   src         Matrice di input
+ * @param[out]  dst         Matrice dei descrittori, dimensione \p width X \p height
+ * @param[in]   width       Lunghezza della matrice
+ * @param[in]   height      Altezza della matrice
+ *
+ * @return void
+*/
+template <typename T>
+void censusTransform(const T            *src,
+                     std::uint64_t      *dst,
+                     const std::size_t  width,
+                     const std::size_t  height)
+{
+    if (!src || !dst) {
+        std::cerr << "Invalid source or destination matrix" <<
+        "\n→ Line: " << __LINE__ <<
+        "\n→ Function: " << __func__  <<
+        "\n→ File: " << __FILE__ << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const std::int64_t half_h = CENSUS_WINDOW_HEIGHT / 2;
+    const std::int64_t half_w = CENSUS_WINDOW_WIDTH / 2;
+    const std::int64_t w = static_cast<std::int64_t>(width);
+    const std::int64_t h = static_cast<std::int64_t>(height);
+
+    for (std::int64_t r = 0; r < h; r++) {
+        for (std::int64_t c = 0; c < w; c++) {
+            const T centre = *(src + (r * w) + c);
+            std::uint64_t descriptor = 0;
+
+            for (std::int64_t i = -half_h; i <= half_h; i++) {
+                const std::int64_t y = std::min(std::max(r + i, std::int64_t{0}), h - 1);
+                for (std::int64_t j = -half_w; j <= half_w; j++) {
+                    if (i == 0 && j == 0) {
+                        continue;
+                    }
+                    const std::int64_t x = std::min(std::max(c + j, std::int64_t{0}), w - 1);
+                    descriptor = (descriptor << 1) | (*(src + (y * w) + x) < centre ? 1u : 0u);
+                }
+            }
+
+            *(dst + (r * w) + c) = descriptor;
+        }
+    }
+}
+
+
+/**
+ * @brief Cerca per ogni finestra di \p census2 il candidato di \p census1 con distanza di Hamming minima.
+ * @note  → La matrice destinazione e gli indici seguono la stessa convenzione di \p argMaxCorrMat: per ogni
+ *          finestra \p kernel_size X \p kernel_size viene confrontato il descrittore del pixel centrale e
+ *          tra i candidati a pari costo vince l'ultimo (colonna maggiore). \n
+ *        → Il costo per candidato è un solo XOR + popcount, indipendente da \p kernel_size. \n
+ *        → La matrice destinazione deve avere dimensione (width - (kernel_size - 1)) * (height - (kernel_size - 1)). \n
+ *
+ * @tparam      Out             Tipo della matrice destinazione
+ *
+ * @param[in]   census1         Descrittori della prima matrice
+ * @param[in]   census2         Descrittori della seconda matrice
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza delle due matrici
+ * @param[in]   height          Altezza delle due matrici
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ *
+ * @return void
+*/
+template <typename Out>
+void argMinHammingMat(const std::uint64_t   *census1,
+                      const std::uint64_t   *census2,
+                      Out                   *dst,
+                      const std::size_t     width,
+                      const std::size_t     height,
+                      const std::size_t     kernel_size,
+                      const std::int64_t    min_disparity = DISPARITY_MIN_UNBOUNDED,
+                      const std::int64_t    max_disparity = DISPARITY_MAX_UNBOUNDED)
+{
+    inputParsing(census1, census2, kernel_size, width);
+    disparityParsing(min_disparity, max_disparity);
+
+    if (!dst) {
+        std::cerr << "Invalid destination matrix" <<
+        "\n→ Line: " << __LINE__ <<
+        "\n→ Function: " << __func__  <<
+        "\n→ File: " << __FILE__ << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const std::size_t dst_width = width - (kernel_size - 1);
+    const std::size_t dst_height = height - (kernel_size - 1);
+    const std::size_t pos = kernel_size / 2;
+
+    for (std::size_t r = 0; r < dst_height; r++) {
+        const std::uint64_t *row1 = census1 + ((r + pos) * width);
+        const std::uint64_t *row2 = census2 + ((r + pos) * width) + pos;
+
+        for (std::size_t x = 0; x < dst_width; x++) {
+            std::uint32_t min = CENSUS_MAX_COST + 1;
+            std::size_t min_idx{0};
+            std::size_t begin, end;
+
+            disparitySearchRange(x, kernel_size, width, min_disparity, max_disparity, begin, end);
+
+            for (std::size_t i = begin; i < end; i++) {
+                const std::uint32_t cost = hammingDistance(row1[i], row2[x]);
+                if (cost <= min) {
+                    min = cost;
+                    min_idx = i - 1;
+                }
+            }
+
+            *(dst + (r * dst_width) + x) = static_cast<Out>(min_idx);
+        }
+    }
+}
+
+
+/**
+ * @brief Calcola la dimensione in byte del \p MatcherWorkspace usato da \p argMinCensusMat.
+ * @note  La dimensione comprende i descrittori delle due matrici.
+ *
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ *
+ * @return Dimensione in byte del workspace
+ * @retval std::size_t
+*/
+inline std::size_t censusWorkspaceSize(const std::size_t width, const std::size_t height)
+{
+    return 2 * stereodepth::MatcherWorkspace::bytes<std::uint64_t>(width * height);
+}
+
+
+/**
+ * @brief Calcola la disparità tra \p src1 e \p src2 con trasformata census e distanza di Hamming.
+ * @note  → Alternativa a \p argMaxCorrMat con la stessa matrice destinazione e la stessa convenzione sugli indici. \n
+ *        → I descrittori delle due matrici vengono calcolati una sola volta; per riusarli (ad esempio per
+ *          più intervalli di disparità sullo stesso frame) usare \p censusTransform e \p argMinHammingMat. \n
+ *        → I descrittori sono presi da \p workspace (vedi \p censusWorkspaceSize ): dal secondo frame con la
+ *          stessa risoluzione la funzione non alloca memoria. \n
+ *
+ * @tparam      T               Tipo delle matrici sorgenti
+ * @tparam      Traits          Tipo della destinazione (vedi \p MatchingTraits), l'accumulatore non è usato
+ *
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   workspace       Memoria di lavoro
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ *
+ * @return void
+*/
+template <typename T, typename Traits = MatchingTraits<T>>
+void argMinCensusMat(const T                        *src1,
+                     const T                        *src2,
+                     typename Traits::output_type   *dst,
+                     const std::size_t              width,
+                     const std::size_t              height,
+                     const std::size_t              kernel_size,
+                     stereodepth::MatcherWorkspace  &workspace,
+                     const std::int64_t             min_disparity = DISPARITY_MIN_UNBOUNDED,
+                     const std::int64_t             max_disparity = DISPARITY_MAX_UNBOUNDED)
+{
+    inputParsing(src1, src2, kernel_size, width);
+
+    const std::size_t mark = workspace.mark();
+    workspace.reserve(mark + censusWorkspaceSize(width, height));
+    std::uint64_t *census1 = workspace.allocate<std::uint64_t>(width * height);
+    std::uint64_t *census2 = workspace.allocate<std::uint64_t>(width * height);
+
+    censusTransform(src1, census1, width, height);
+    censusTransform(src2, census2, width, height);
+
+    argMinHammingMat(census1, census2, dst, width, height, kernel_size,
+                     min_disparity, max_disparity);
+
+    workspace.rewind(mark);
+}
+
+
+/**
+ * @brief Versione di \p argMinCensusMat con un workspace temporaneo allocato ad ogni chiamata.
+ * @note  Per elaborare più frame senza allocazioni usare la versione con \p MatcherWorkspace.
+ *
+ * @tparam      T               Tipo delle matrici sorgenti
+ * @tparam      Traits          Tipo della destinazione (vedi \p MatchingTraits), l'accumulatore non è usato
+ *
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ *
+ * @return void
+*/
+template <typename T, typename Traits = MatchingTraits<T>>
+void argMinCensusMat(const T            *src1,
+                     const T            *src2,
+                     typename Traits::output_type *dst,
+                     const std::size_t  width,
+                     const std::size_t  height,
+                     const std::size_t  kernel_size,
+                     const std::int64_t min_disparity = DISPARITY_MIN_UNBOUNDED,
+                     const std::int64_t max_disparity = DISPARITY_MAX_UNBOUNDED)
+{
+    stereodepth::MatcherWorkspace workspace(censusWorkspaceSize(width, height));
+    argMinCensusMat<T, Traits>(src1, src2, dst, width, height, kernel_size, workspace,
+                               min_disparity, max_disparity);
+}
+
+
+/**
+ * @brief Riempie il volume dei costi \p volume con le distanze di Hamming tra i descrittori \p census1 e \p census2.
+ * @note  → Il volume viene ridimensionato a (height - (kernel_size - 1)) X (width - (kernel_size - 1)) X D, con la
+ *          stessa geometria di \p costVolumeRunningSum: l'elemento (r, x, n) confronta i pixel centrali delle
+ *          finestre con disparità \p volume.disparity(n). \n
+ *        → Gli elementi che corrispondono a finestre fuori dalla riga valgono \p CENSUS_MAX_COST, così da non
+ *          essere scelti dall'aggregazione SGM. \n
+ *        → \p stereodepth::winner_takes_min sul volume riproduce \p argMinHammingMat. \n
+ *
+ * @tparam      Acc             Tipo dei costi nel volume
+ *
+ * @param[in]   census1         Descrittori della prima matrice
+ * @param[in]   census2         Descrittori della seconda matrice
+ * @param[out]  volume          Volume dei costi
+ * @param[in]   width           Lunghezza delle due matrici
+ * @param[in]   height          Altezza delle due matrici
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ *
+ * @return void
+*/
+template <typename Acc>
+void costVolumeCensus(const std::uint64_t           *census1,
+                      const std::uint64_t           *census2,
+                      stereodepth::CostVolume<Acc>  &volume,
+                      const std::size_t             width,
+                      const std::size_t             height,
+                      const std::size_t             kernel_size,
+                      std::int64_t                  min_disparity = DISPARITY_MIN_UNBOUNDED,
+                      std::int64_t                  max_disparity = DISPARITY_MAX_UNBOUNDED)
+{
+    inputParsing(census1, census2, kernel_size, width);
+    disparityParsing(min_disparity, max_disparity);
+
+    clampDisparityRange(width, kernel_size, min_disparity, max_disparity);
+
+    const std::int64_t limit = static_cast<std::int64_t>(width - kernel_size);
+    const std::size_t dst_width = width - (kernel_size - 1);
+    const std::size_t dst_height = height - (kernel_size - 1);
+    const std::size_t pos = kernel_size / 2;
+
+    volume.resize(dst_height, dst_width, min_disparity, max_disparity);
+
+    for (std::size_t r = 0; r < dst_height; r++) {
+        const std::uint64_t *row1 = census1 + ((r + pos) * width) + pos;
+        const std::uint64_t *row2 = census2 + ((r + pos) * width) + pos;
+
+        for (std::size_t x = 0; x < dst_width; x++) {
+            for (std::size_t n = 0; n < volume.disparities(); n++) {
+                const std::int64_t j = static_cast<std::int64_t>(x) - volume.disparity(n);
+                const bool valid = j >= 0 && j <= limit;
+                volume(r, x, n) = static_cast<Acc>(valid ? hammingDistance(row1[j], row2[x]) : CENSUS_MAX_COST);
+            }
+        }
+    }
+}
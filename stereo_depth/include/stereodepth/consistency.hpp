@@ -0,0 +1,226 @@
+/***************************************************************************
+ *            consistency.hpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+
+/*! \file  consistency.hpp
+ *  \brief Left-right consistency check from a single cost volume.
+ */
+
+#include "type.hpp"
+#include "cost_volume.hpp"
+#include "subpixel.hpp"
+#include "workspace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+#ifndef STEREODEPTH_CONSISTENCY_HPP
+#define STEREODEPTH_CONSISTENCY_HPP
+
+namespace stereodepth {
+
+/**
+ * \brief Size in bytes of the MatcherWorkspace used by right_disparity.
+ * \tparam T    Type of the costs.
+ * \param width Width of the cost volume.
+ * \return The workspace size in bytes.
+ */
+template <typename T>
+SizeType right_disparity_workspace_size(SizeType width)
+{
+    return MatcherWorkspace::bytes<T>(width)
+        + MatcherWorkspace::bytes<std::int64_t>(width);
+}
+
+/**
+ * \brief Winner-takes-all disparities referenced to the windows of the
+ * first matrix, read from a volume referenced to the second one.
+ *
+ * Element (r, x, n) of the volume compares the window x of the second
+ * matrix with the window j = x - d of the first one, so the candidates of
+ * window j lie on the diagonal x = j + d: the map is obtained by re-indexing
+ * the same costs, without matching again with the sources swapped. Ties
+ * keep the larger disparity.
+ * \tparam T     Type of the costs.
+ * \param dst    Destination matrix of shape height x width of the volume,
+ *               receiving disparity x DISPARITY_SCALE of each window j.
+ * \param volume    The cost volume.
+ * \param order     Whether the best cost is a maximum or a minimum.
+ * \param workspace Scratch memory, see right_disparity_workspace_size.
+ * \return The pointer to the destination matrix.
+ * \throw std::invalid_argument if the disparity range of the volume exceeds
+ *        +-DISPARITY_FIXED_MAX, as subpixel_disparity.
+ */
+template <typename T>
+std::int16_t* right_disparity(std::int16_t* dst, const CostVolume<T>& volume,
+                              CostOrder order, MatcherWorkspace& workspace)
+{
+    check_fixed_point_range(volume, "right_disparity");
+
+    const auto width = static_cast<std::int64_t>(volume.width());
+    const auto d_stride = volume.disparity_stride();
+    const std::int16_t invalid = invalid_disparity(volume);
+    const SizeType mark = workspace.mark();
+    workspace.reserve(mark + right_disparity_workspace_size<T>(volume.width()));
+    T* best = workspace.allocate<T>(volume.width());
+    std::int64_t* best_n = workspace.allocate<std::int64_t>(volume.width());
+
+    for (SizeType row = 0; row < volume.height(); ++row)
+    {
+        std::fill(best_n, best_n + volume.width(), std::int64_t{-1});
+        // One pass over the row: (x, n) updates the window j = x - d.
+        for (std::int64_t x = 0; x < width; ++x)
+        {
+            const T* costs = volume.data()
+                + volume.index(row, static_cast<SizeType>(x), 0);
+            for (SizeType n = 0; n < volume.disparities(); ++n)
+            {
+                const std::int64_t j = x - volume.disparity(n);
+                if (j < 0 || j >= width) continue;
+                const T cost = costs[n * d_stride];
+                T& b = best[static_cast<SizeType>(j)];
+                std::int64_t& bn = best_n[static_cast<SizeType>(j)];
+                if (bn < 0 || (order == CostOrder::MAXIMIZE ? cost >= b : cost <= b))
+                {
+                    b = cost;
+                    bn = static_cast<std::int64_t>(n);
+                }
+            }
+        }
+        for (SizeType j = 0; j < volume.width(); ++j)
+        {
+            dst[row * volume.width() + j] = best_n[j] < 0 ? invalid
+                : static_cast<std::int16_t>(
+                    volume.disparity(static_cast<SizeType>(best_n[j])) * DISPARITY_SCALE);
+        }
+    }
+    workspace.rewind(mark);
+    return dst;
+}
+
+/**
+ * \brief right_disparity with a temporary workspace allocated by the call.
+ * \tparam T     Type of the costs.
+ * \param dst    Destination matrix of shape height x width of the volume.
+ * \param volume The cost volume.
+ * \param order  Whether the best cost is a maximum or a minimum.
+ * \return The pointer to the destination matrix.
+ * \throw std::invalid_argument as the workspace overload.
+ */
+template <typename T>
+std::int16_t* right_disparity(std::int16_t* dst, const CostVolume<T>& volume,
+                              CostOrder order)
+{
+    MatcherWorkspace workspace(right_disparity_workspace_size<T>(volume.width()));
+    return right_disparity(dst, volume, order, workspace);
+}
+
+/**
+ * \brief Size in bytes of the MatcherWorkspace used by left_right_check.
+ * \tparam T     Type of the costs.
+ * \param height Height of the cost volume.
+ * \param width  Width of the cost volume.
+ * \return The workspace size in bytes.
+ */
+template <typename T>
+SizeType left_right_workspace_size(SizeType height, SizeType width)
+{
+    return MatcherWorkspace::bytes<std::int16_t>(height * width)
+        + right_disparity_workspace_size<T>(width);
+}
+
+/**
+ * \brief Invalidate the pixels whose disparity disagrees with the disparity
+ * seen from the first matrix, as cv::StereoBM does with disp12MaxDiff.
+ *
+ * The disparity d of pixel x is rounded to the nearest integer and compared
+ * with the disparity of window x - d computed by right_disparity from the
+ * same volume; pixels whose two estimates differ by more than
+ * disp12_max_diff, or whose matching window falls outside the row, are set
+ * to invalid_disparity(volume).
+ * \tparam T             Type of the costs.
+ * \param disparity      Fixed point disparities of the volume, as written
+ *                       by subpixel_disparity, modified in place.
+ * \param volume         The cost volume used to compute disparity.
+ * \param order          Whether the best cost is a maximum or a minimum.
+ * \param disp12_max_diff Maximum allowed difference in integer disparity
+ *                       units; a negative value disables the check.
+ * \param workspace      Scratch memory, see left_right_workspace_size.
+ * \return The number of invalidated pixels.
+ * \throw std::invalid_argument if the check is enabled and the disparity
+ *        range of the volume exceeds +-DISPARITY_FIXED_MAX.
+ */
+template <typename T>
+SizeType left_right_check(std::int16_t* disparity, const CostVolume<T>& volume,
+                          CostOrder order, std::int64_t disp12_max_diff,
+                          MatcherWorkspace& workspace)
+{
+    if (disp12_max_diff < 0) return 0;
+    check_fixed_point_range(volume, "left_right_check");
+
+    const auto width = static_cast<std::int64_t>(volume.width());
+    const SizeType size = volume.height() * volume.width();
+    const std::int16_t invalid = invalid_disparity(volume);
+    const SizeType mark = workspace.mark();
+    // right_disparity nests in the same arena: reserve its rows up front.
+    workspace.reserve(mark + left_right_workspace_size<T>(volume.height(),
+                                                          volume.width()));
+    std::int16_t* right = workspace.allocate<std::int16_t>(size);
+    right_disparity(right, volume, order, workspace);
+
+    SizeType invalidated = 0;
+    for (SizeType row = 0; row < volume.height(); ++row)
+    {
+        std::int16_t* left = disparity + row * volume.width();
+        const std::int16_t* other = right + row * volume.width();
+        for (std::int64_t x = 0; x < width; ++x)
+        {
+            if (left[x] == invalid) continue;
+            const auto d = static_cast<std::int64_t>(std::floor(
+                (left[x] + DISPARITY_SCALE / 2) / double(DISPARITY_SCALE)));
+            const std::int64_t j = x - d;
+            if (j < 0 || j >= width
+                || other[j] == invalid
+                || std::llabs(other[j] / DISPARITY_SCALE - d) > disp12_max_diff)
+            {
+                left[x] = invalid;
+                ++invalidated;
+            }
+        }
+    }
+    workspace.rewind(mark);
+    return invalidated;
+}
+
+/**
+ * \brief left_right_check with a temporary workspace allocated by the call.
+ * \tparam T             Type of the costs.
+ * \param disparity      Fixed point disparities of the volume, modified in
+ *                       place.
+ * \param volume         The cost volume used to compute disparity.
+ * \param order          Whether the best cost is a maximum or a minimum.
+ * \param disp12_max_diff Maximum allowed difference in integer disparity
+ *                       units; a negative value disables the check.
+ * \return The number of invalidated pixels.
+ * \throw std::invalid_argument as the workspace overload.
+ */
+template <typename T>
+SizeType left_right_check(std::int16_t* disparity, const CostVolume<T>& volume,
+                          CostOrder order, std::int64_t disp12_max_diff)
+{
+    if (disp12_max_diff < 0) return 0;
+    check_fixed_point_range(volume, "left_right_check");
+    MatcherWorkspace workspace(
+        left_right_workspace_size<T>(volume.height(), volume.width()));
+    return left_right_check(disparity, volume, order, disp12_max_diff, workspace);
+}
+
+} // namespace stereodepth
+
+#endif // STEREODEPTH_CONSISTENCY_HPP
@@ -0,0 +1,295 @@
+/***************************************************************************
+ *            cost_volume.hpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+
+/*! \file  cost_volume.hpp
+ *  \brief Matching cost volume shared by the CPU matching stages.
+ */
+
+#include "type.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#ifndef STEREODEPTH_COST_VOLUME_HPP
+#define STEREODEPTH_COST_VOLUME_HPP
+
+namespace stereodepth {
+
+/**
+ * \brief Height x Width x Disparities volume of matching costs.
+ *
+ * The volume is stored in a single contiguous buffer whose first element is
+ * aligned to ALIGNMENT bytes. The buffer is only reallocated when a resize
+ * asks for more elements than the current capacity, so a volume allocated
+ * once per resolution can be reused across frames without heap traffic.
+ *
+ * Element (row, col, n) holds the cost of disparity min_disparity() + n.
+ * Consumers should address the volume through row_stride(), col_stride()
+ * and disparity_stride() so that they work with both layouts.
+ * \tparam T Type of the costs.
+ */
+template <typename T>
+class CostVolume
+{
+public:
+    static_assert(std::is_arithmetic<T>::value,
+                  "CostVolume costs must be of arithmetic type");
+
+    /// Alignment in bytes of the first element of the volume.
+    static constexpr SizeType ALIGNMENT = 64;
+
+    enum class Layout {
+        HWD, ///< Disparities contiguous for each pixel (WTA, SGM paths).
+        DHW  ///< One contiguous height x width slice per disparity.
+    };
+
+    CostVolume(Layout layout = Layout::HWD)
+        : _layout{layout}
+        , _height{0}
+        , _width{0}
+        , _disparities{0}
+        , _min_disparity{0}
+        , _capacity{0}
+        , _buffer{nullptr}
+        , _data{nullptr}
+    {}
+
+    CostVolume(SizeType height, SizeType width,
+               std::int64_t min_disparity, std::int64_t max_disparity,
+               Layout layout = Layout::HWD)
+        : CostVolume(layout)
+    {
+        resize(height, width, min_disparity, max_disparity);
+    }
+
+    CostVolume(const CostVolume&) = delete;
+    CostVolume& operator=(const CostVolume&) = delete;
+
+    /// The moved-from volume is left empty, with the same layout.
+    CostVolume(CostVolume&& other) noexcept
+        : _layout{other._layout}
+        , _height{std::exchange(other._height, 0)}
+        , _width{std::exchange(other._width, 0)}
+        , _disparities{std::exchange(other._disparities, 0)}
+        , _min_disparity{std::exchange(other._min_disparity, 0)}
+        , _capacity{std::exchange(other._capacity, 0)}
+        , _buffer{std::move(other._buffer)}
+        , _data{std::exchange(other._data, nullptr)}
+    {}
+
+    CostVolume& operator=(CostVolume&& other) noexcept
+    {
+        if (this != &other)
+        {
+            _layout = other._layout;
+            _height = std::exchange(other._height, 0);
+            _width = std::exchange(other._width, 0);
+            _disparities = std::exchange(other._disparities, 0);
+            _min_disparity = std::exchange(other._min_disparity, 0);
+            _capacity = std::exchange(other._capacity, 0);
+            _buffer = std::move(other._buffer);
+            _data = std::exchange(other._data, nullptr);
+        }
+        return *this;
+    }
+
+    /**
+     * \brief Set the shape of the volume, reallocating only if the current
+     * capacity is not enough.
+     * \param height        Number of rows.
+     * \param width         Number of columns.
+     * \param min_disparity Disparity stored at index 0.
+     * \param max_disparity Last disparity stored (inclusive).
+     * \return True if the buffer has been reallocated.
+     */
+    bool resize(SizeType height, SizeType width,
+                std::int64_t min_disparity, std::int64_t max_disparity)
+    {
+        if (max_disparity < min_disparity)
+        {
+            throw std::invalid_argument(
+                "CostVolume: max_disparity must be >= min_disparity");
+        }
+        _height = height;
+        _width = width;
+        _min_disparity = min_disparity;
+        _disparities = static_cast<SizeType>(max_disparity - min_disparity) + 1;
+
+        if (size() <= _capacity) return false;
+
+        _capacity = size();
+        _buffer.reset(new unsigned char[_capacity * sizeof(T) + ALIGNMENT]);
+        void* ptr = _buffer.get();
+        SizeType space = _capacity * sizeof(T) + ALIGNMENT;
+        _data = static_cast<T*>(
+            std::align(ALIGNMENT, _capacity * sizeof(T), ptr, space));
+        return true;
+    }
+
+    /**
+     * \brief Set every cost of the volume to value.
+     * \param value The cost to assign.
+     */
+    void fill(T value)
+    {
+        std::fill(_data, _data + size(), value);
+    }
+
+    [[nodiscard]] Layout layout() const { return _layout; }
+    [[nodiscard]] SizeType height() const { return _height; }
+    [[nodiscard]] SizeType width() const { return _width; }
+    [[nodiscard]] SizeType disparities() const { return _disparities; }
+    [[nodiscard]] SizeType size() const
+    { return _height * _width * _disparities; }
+    [[nodiscard]] SizeType capacity() const { return _capacity; }
+
+    [[nodiscard]] std::int64_t min_disparity() const { return _min_disparity; }
+    [[nodiscard]] std::int64_t max_disparity() const
+    { return _min_disparity + static_cast<std::int64_t>(_disparities) - 1; }
+    [[nodiscard]] std::int64_t disparity(SizeType n) const
+    { return _min_disparity + static_cast<std::int64_t>(n); }
+
+    [[nodiscard]] SizeType row_stride() const
+    { return _layout == Layout::HWD ? _width * _disparities : _width; }
+    [[nodiscard]] SizeType col_stride() const
+    { return _layout == Layout::HWD ? _disparities : 1; }
+    [[nodiscard]] SizeType disparity_stride() const
+    { return _layout == Layout::HWD ? 1 : _height * _width; }
+
+    [[nodiscard]] SizeType index(SizeType row, SizeType col, SizeType n) const
+    { return row * row_stride() + col * col_stride() + n * disparity_stride(); }
+
+    [[nodiscard]] T* data() { return _data; }
+    [[nodiscard]] const T* data() const { return _data; }
+
+    [[nodiscard]] T& operator()(SizeType row, SizeType col, SizeType n)
+    { return _data[index(row, col, n)]; }
+    [[nodiscard]] const T& operator()(SizeType row, SizeType col, SizeType n) const
+    { return _data[index(row, col, n)]; }
+
+private:
+    Layout _layout;
+    SizeType _height;
+    SizeType _width;
+    SizeType _disparities;
+    std::int64_t _min_disparity;
+    SizeType _capacity;
+    std::unique_ptr<unsigned char[]> _buffer;
+    T* _data;
+};
+
+/**
+ * \brief Winner-takes-all selection of the maximum cost of each pixel.
+ *
+ * Candidates are visited in increasing column of the matching window and ties
+ * keep the last one, as argMaxCorr does, so filling the volume with
+ * correlation costs and calling this function reproduces argMaxCorrMat.
+ * Only disparities whose window lies inside the row are considered; pixels
+ * without candidates get index 0.
+ * \tparam T           Type of the costs.
+ * \tparam U           Type of the destination elements.
+ * \param dst          Destination matrix of shape height x width of the
+ *                     volume, receiving the argMaxCorr column index.
+ * \param volume       The cost volume, width equal to the number of windows
+ *                     of a source row.
+ * \param kernel_size  Size of the matching window.
+ * \return The pointer to the destination matrix.
+ */
+template <typename T, typename U>
+U* winner_takes_all(U* dst, const CostVolume<T>& volume, SizeType kernel_size)
+{
+    const auto width = static_cast<std::int64_t>(volume.width());
+    const auto pos = static_cast<std::int64_t>(kernel_size / 2);
+    const auto d_stride = volume.disparity_stride();
+    for (SizeType row = 0; row < volume.height(); ++row)
+    {
+        for (SizeType col = 0; col < volume.width(); ++col)
+        {
+            const auto x = static_cast<std::int64_t>(col);
+            // Valid candidates: 0 <= x - d < width.
+            const auto n_begin = std::max(x - width + 1 - volume.min_disparity(),
+                                          std::int64_t{0});
+            const auto n_end = std::min(x - volume.min_disparity() + 1,
+                static_cast<std::int64_t>(volume.disparities()));
+            const T* costs = volume.data() + volume.index(row, col, 0);
+            T max{0};
+            std::int64_t max_idx{0};
+            for (auto n = n_end - 1; n >= n_begin; --n)
+            {
+                const T cost = costs[static_cast<SizeType>(n) * d_stride];
+                if (cost >= max)
+                {
+                    max = cost;
+                    max_idx = x - volume.disparity(static_cast<SizeType>(n))
+                        + pos - 1;
+                }
+            }
+            dst[row * volume.width() + col] = static_cast<U>(max_idx);
+        }
+    }
+    return dst;
+}
+
+/**
+ * \brief Winner-takes-all selection of the minimum cost of each pixel.
+ *
+ * Counterpart of winner_takes_all for dissimilarity costs (census, SAD,
+ * aggregated SGM costs): candidates are visited in the same order and ties
+ * keep the last one, so the destination follows the argMaxCorr index
+ * convention. Pixels without candidates get index 0.
+ * \tparam T           Type of the costs.
+ * \tparam U           Type of the destination elements.
+ * \param dst          Destination matrix of shape height x width of the
+ *                     volume, receiving the argMaxCorr column index.
+ * \param volume       The cost volume, width equal to the number of windows
+ *                     of a source row.
+ * \param kernel_size  Size of the matching window.
+ * \return The pointer to the destination matrix.
+ */
+template <typename T, typename U>
+U* winner_takes_min(U* dst, const CostVolume<T>& volume, SizeType kernel_size)
+{
+    const auto width = static_cast<std::int64_t>(volume.width());
+    const auto pos = static_cast<std::int64_t>(kernel_size / 2);
+    const auto d_stride = volume.disparity_stride();
+    for (SizeType row = 0; row < volume.height(); ++row)
+    {
+        for (SizeType col = 0; col < volume.width(); ++col)
+        {
+            const auto x = static_cast<std::int64_t>(col);
+            const auto n_begin = std::max(x - width + 1 - volume.min_disparity(),
+                                          std::int64_t{0});
+            const auto n_end = std::min(x - volume.min_disparity() + 1,
+                static_cast<std::int64_t>(volume.disparities()));
+            const T* costs = volume.data() + volume.index(row, col, 0);
+            T min = std::numeric_limits<T>::max();
+            std::int64_t min_idx{0};
+            for (auto n = n_end - 1; n >= n_begin; --n)
+            {
+                const T cost = costs[static_cast<SizeType>(n) * d_stride];
+                if (cost <= min)
+                {
+                    min = cost;
+                    min_idx = x - volume.disparity(static_cast<SizeType>(n))
+                        + pos - 1;
+                }
+            }
+            dst[row * volume.width() + col] = static_cast<U>(min_idx);
+        }
+    }
+    return dst;
+}
+
+} // namespace stereodepth
+
+#endif // STEREODEPTH_COST_VOLUME_HPP
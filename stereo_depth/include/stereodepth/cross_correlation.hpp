@@ -33,11 +33,200 @@
 #pragma once
 
 #include <cstddef>
+#include <cstdint>
 #include <iostream>
 #include <cstdlib>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+
+#include "stereodepth/workspace.hpp"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 /// Minima dimensione del kernel
 #define KERNEL_LIMIT 3
+/// Disparità minima di default: nessun limite, la ricerca copre l'intera riga
+#define DISPARITY_MIN_UNBOUNDED std::numeric_limits<std::int64_t>::min()
+/// Disparità massima di default: nessun limite, la ricerca copre l'intera riga
+#define DISPARITY_MAX_UNBOUNDED std::numeric_limits<std::int64_t>::max()
+
+
+/**
+ * @brief Tipi usati dalle funzioni di matching.
+ * @note  → Di default l'accumulatore e la destinazione hanno il tipo delle matrici sorgenti, come nella versione
+ *          originale: con \p uint8_t la somma dei prodotti è calcolata modulo 256 e gli indici oltre 255 non
+ *          sono rappresentabili. \n
+ *        → Un accumulatore più largo (es. \p uint32_t ) rende esatta la somma, una destinazione più larga
+ *          (es. \p uint16_t ) permette disparità oltre 255 su immagini larghe. \n
+ *
+ * @tparam      In          Tipo delle matrici sorgenti
+ * @tparam      Acc         Tipo dell'accumulatore della cross-correlazione
+ * @tparam      Out         Tipo della matrice destinazione
+*/
+template <typename In, typename Acc = In, typename Out = In>
+struct MatchingTraits {
+    using input_type = In;
+    using accumulator_type = Acc;
+    using output_type = Out;
+};
+
+
+/**
+ * @brief Tipo intero più largo di \p T usato come accumulatore esatto; per i tipi floating point \p double.
+ *
+ * @tparam      T           Tipo delle matrici sorgenti
+*/
+template <typename T>
+struct WideAccumulator {
+    using type = typename std::conditional<std::is_floating_point<T>::value, double,
+                 typename std::conditional<(sizeof(T) < 4),
+                    typename std::conditional<std::is_signed<T>::value, std::int32_t, std::uint32_t>::type,
+                    typename std::conditional<std::is_signed<T>::value, std::int64_t, std::uint64_t>::type
+                 >::type>::type;
+};
+
+
+/// Traits con accumulatore esatto e disparità a 16 bit, per immagini fino a 65535 colonne
+template <typename In>
+using WideMatchingTraits = MatchingTraits<In, typename WideAccumulator<In>::type, std::uint16_t>;
+
+
+/**
+ * @brief Calcola il numero di bit necessari per sommare senza overflow \p kernel_size X \p kernel_size termini,
+ *        ognuno al più \p max_term.
+ * @note  I kernel vettoriali usano questo valore per scegliere la corsia più stretta (16 o 32 bit) che non
+ *        può andare in overflow per la dimensione del kernel richiesta.
+ *
+ * @param[in]   max_term        Valore massimo di un termine
+ * @param[in]   kernel_size     Dimensione del kernel
+ *
+ * @return Numero di bit dell'accumulatore
+ * @retval std::size_t
+*/
+constexpr std::size_t accumulatorBits(const std::uint64_t max_term, const std::size_t kernel_size)
+{
+    return max_term * kernel_size * kernel_size <= 0xFFFFull ? 16 :
+           max_term * kernel_size * kernel_size <= 0xFFFFFFFFull ? 32 : 64;
+}
+
+
+/// Confidenza massima: picco senza secondo candidato o secondo candidato a costo nullo
+#define CONFIDENCE_MAX 255
+
+
+/**
+ * @brief Tiene traccia, in un solo passaggio, del costo migliore e del secondo migliore costo fuori dall'intorno
+ *        ±1 del migliore.
+ * @note  → I candidati devono essere passati a \p update in posizioni consecutive (0, 1, 2, ...), in un verso
+ *          qualunque. \n
+ *        → Il migliore è scelto come nel ciclo di \p argMaxCorr: a parità vince l'ultimo candidato. \n
+ *        → Il secondo migliore è il massimo tra i candidati in posizione <= migliore - 2, memorizzato quando il
+ *          migliore cambia, e quelli in posizione >= migliore + 2 visti dopo: il costo per candidato è un
+ *          confronto in più. \n
+ *
+ * @tparam      Acc         Tipo dei costi
+*/
+template <typename Acc>
+struct PeakTracker {
+    /**
+     * @param[in]   initial     Valore iniziale del migliore (es. 0 in \p argMaxCorr ), non è un candidato
+     * @param[in]   maximize_cost   Se il migliore è il costo massimo (cross-correlazione) o il minimo (SAD, census)
+    */
+    explicit PeakTracker(const Acc initial, const bool maximize_cost = true)
+        : best(initial), maximize(maximize_cost) {}
+
+    /**
+     * @brief Aggiunge il candidato nella posizione successiva.
+     *
+     * @param[in]   cost        Costo del candidato
+     *
+     * @return void
+    */
+    void update(const Acc cost)
+    {
+        // Il candidato in posizione count - 2 non è più adiacente ai migliori futuri
+        if (count >= 2) {
+            merge(before, has_before, last2);
+        }
+        if (maximize ? cost >= best : cost <= best) {
+            best = cost;
+            best_pos = count;
+            has_best = true;
+            best_before = before;
+            has_best_before = has_before;
+            has_after = false;
+        } else if (has_best && count >= best_pos + 2) {
+            merge(after, has_after, cost);
+        }
+        last2 = last1;
+        last1 = cost;
+        count++;
+    }
+
+    /// Se esiste un secondo candidato fuori dall'intorno ±1 del migliore
+    bool hasSecond() const { return has_best && (has_best_before || has_after); }
+
+    /// Secondo migliore costo fuori dall'intorno ±1 del migliore (valido se \p hasSecond )
+    Acc second() const
+    {
+        if (!has_best_before) return after;
+        if (!has_after) return best_before;
+        return isBetter(after, best_before) ? after : best_before;
+    }
+
+    /**
+     * @brief Confidenza del picco in [0, \p CONFIDENCE_MAX ]: 255 * (1 - secondo / migliore) per i costi da
+     *        massimizzare, 255 * (1 - migliore / secondo) per quelli da minimizzare.
+     * @note  → Con \p uniqueness_ratio > 0 i pixel che non superano il test di unicità di cv::StereoBM
+     *          (il migliore deve staccare il secondo di almeno \p uniqueness_ratio percento) hanno confidenza 0. \n
+     *        → Senza candidati accettati la confidenza è 0, senza secondo candidato è \p CONFIDENCE_MAX. \n
+     *
+     * @param[in]   uniqueness_ratio    Margine percentuale del test di unicità, 0 lo disabilita
+     *
+     * @return Confidenza del migliore
+     * @retval std::uint8_t
+    */
+    std::uint8_t confidence(const int uniqueness_ratio = 0) const
+    {
+        if (!has_best) return 0;
+        if (!hasSecond()) return CONFIDENCE_MAX;
+
+        const double b = static_cast<double>(best);
+        const double s = static_cast<double>(second());
+        if (uniqueness_ratio > 0) {
+            const double margin = (100.0 + uniqueness_ratio) / 100.0;
+            if (maximize ? b <= s * margin : s <= b * margin) return 0;
+        }
+        const double num = maximize ? b - s : s - b;
+        const double den = maximize ? b : s;
+        if (den <= 0.0) return num > 0.0 ? CONFIDENCE_MAX : 0;
+        return static_cast<std::uint8_t>(std::min(num / den, 1.0) * CONFIDENCE_MAX);
+    }
+
+    Acc best;                       ///< Costo del migliore
+    std::size_t best_pos{0};        ///< Posizione del migliore
+    bool has_best{false};           ///< Se almeno un candidato ha superato il valore iniziale
+
+private:
+    bool isBetter(const Acc a, const Acc b) const { return maximize ? a > b : a < b; }
+
+    void merge(Acc &value, bool &valid, const Acc cost) const
+    {
+        if (!valid || isBetter(cost, value)) {
+            value = cost;
+            valid = true;
+        }
+    }
+
+    bool maximize;
+    std::size_t count{0};
+    Acc last1{}, last2{};
+    Acc before{}, best_before{}, after{};
+    bool has_before{false}, has_best_before{false}, has_after{false};
+};
 
 
 /**
@@ -173,6 +362,107 @@ void inputParsing(const T           *src,
 }
 
 
+/**
+ * @brief Controlla che l'intervallo di disparità [ \p min_disparity, \p max_disparity ] sia valido
+ *
+ * @param[in]   min_disparity   Disparità minima
+ * @param[in]   max_disparity   Disparità massima
+ * 
+ * @return      void
+*/
+inline void disparityParsing(const std::int64_t min_disparity, 
+                             const std::int64_t max_disparity)
+{
+    if (min_disparity > max_disparity) {
+        std::cerr << "Minimum disparity must be less than or equal to maximum disparity" <<
+        "\n→ Line: " << __LINE__ << 
+        "\n→ Function: " << __func__  << 
+        "\n→ File: " << __FILE__ << std::endl;
+        exit(EXIT_FAILURE);
+    }
+}
+
+
+/**
+ * @brief Calcola l'intervallo di colonne candidate [ \p begin, \p end ) della prima matrice per il kernel in posizione \p offset.
+ * @note  → La disparità di un candidato è definita come \p offset - j, dove j è la colonna di partenza della finestra
+ *          candidata nella prima matrice: disparità positive cercano a sinistra di \p offset, negative a destra. \n
+ *        → Gli indici restituiti sono le colonne centrali delle finestre candidate, come nel ciclo di \p argMaxCorr. \n
+ *        → Se l'intervallo è vuoto \p begin è uguale a \p end. \n
+ *
+ * @param[in]   offset          Colonna di partenza del kernel nella seconda matrice
+ * @param[in]   kernel_size     Dimensione della matrice kernel
+ * @param[in]   matrix_width    Lunghezza della matrice sorgente
+ * @param[in]   min_disparity   Disparità minima
+ * @param[in]   max_disparity   Disparità massima
+ * @param[out]  begin           Prima colonna centrale candidata
+ * @param[out]  end             Colonna centrale successiva all'ultima candidata
+ * 
+ * @return      void
+*/
+inline void disparitySearchRange(const std::size_t  offset,
+                                 const std::size_t  kernel_size,
+                                 const std::size_t  matrix_width,
+                                 std::int64_t       min_disparity,
+                                 std::int64_t       max_disparity,
+                                 std::size_t        &begin,
+                                 std::size_t        &end)
+{
+    const std::int64_t pos = static_cast<std::int64_t>(kernel_size / 2);
+    const std::int64_t width = static_cast<std::int64_t>(matrix_width);
+    const std::int64_t off = static_cast<std::int64_t>(offset);
+    const std::int64_t last = width - static_cast<std::int64_t>(kernel_size);
+
+    min_disparity = std::max(std::min(min_disparity, width), -width);
+    max_disparity = std::max(std::min(max_disparity, width), -width);
+
+    const std::int64_t first_col = std::max(off - max_disparity, std::int64_t{0});
+    const std::int64_t last_col = std::min(off - min_disparity, last);
+
+    if (first_col > last_col) {
+        begin = end = 0;
+        return;
+    }
+
+    begin = static_cast<std::size_t>(first_col + pos);
+    end = static_cast<std::size_t>(last_col + pos + 1);
+}
+
+
+/**
+ * @brief Riduce l'intervallo di disparità [ \p min_disparity, \p max_disparity ] alle disparità realizzabili
+ *        da una finestra \p kernel_size X \p kernel_size in una matrice di lunghezza \p width.
+ * @note  → Se nessuna disparità dell'intervallo è realizzabile l'intervallo viene ridotto all'estremo più vicino,
+ *          che resta non realizzabile: nessun candidato viene considerato. \n
+ *
+ * @param[in]       width           Lunghezza delle due matrici
+ * @param[in]       kernel_size     Dimensione del kernel
+ * @param[in,out]   min_disparity   Disparità minima
+ * @param[in,out]   max_disparity   Disparità massima
+ *
+ * @return void
+*/
+inline void clampDisparityRange(const std::size_t   width,
+                                const std::size_t   kernel_size,
+                                std::int64_t        &min_disparity,
+                                std::int64_t        &max_disparity)
+{
+    const std::int64_t limit = static_cast<std::int64_t>(width - kernel_size);
+
+    if (min_disparity > limit) {
+        max_disparity = min_disparity;
+        return;
+    }
+    if (max_disparity < -limit) {
+        min_disparity = max_disparity;
+        return;
+    }
+
+    min_disparity = std::max(std::min(min_disparity, limit), -limit);
+    max_disparity = std::max(std::min(max_disparity, limit), -limit);
+}
+
+
 /**
  * @brief Copia nella matrice \p kernel una porzione della matrice \p src della stessa grandezza di \p kernel.
  * @note  → La matrice \p src e la matrice \p kernel devono avere la stessa altezza. \n
@@ -272,41 +562,64 @@ void concatDst(const T              *src_vect,
  *        → il kernel deve avere una dimensione dispari e deve essere una matrice quadrata. \n
  *
  * @tparam      T               Tipo della matrice sorgente e della matrice kernel
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
  * 
  * @param[in]   src1            Prima matrice di input
  * @param[in]   src2            Seconda matrice di input
  * @param[in]   offset          Offset nella seconda matrice
  * @param[in]   kernel_size     Dimensione della matrice kernel
  * @param[in]   matrix_width    Lunghezza della matrice sorgente
+ * @param[in]   min_disparity   Disparità minima cercata (vedi \p disparitySearchRange)
+ * @param[in]   max_disparity   Disparità massima cercata (vedi \p disparitySearchRange)
+ * @param[out]  confidence      Se non nullo, riceve la confidenza del massimo in [0, \p CONFIDENCE_MAX ]
+ *                              (vedi \p PeakTracker ); ha senso solo se i costi non vanno in overflow, con
+ *                              sorgenti \p uint8_t usare \p WideMatchingTraits
+ * @param[in]   uniqueness_ratio Margine percentuale del test di unicità, 0 lo disabilita
  * 
  * @return Ritorna la posizione in cui la cross-correlazione assume il massimo valore.
  * @retval std::size_t
 */
-template <typename T>
+template <typename T, typename Traits = MatchingTraits<T>>
 std::size_t argMaxCorr(const T              *src1, 
                        const T              *src2, 
                        const std::size_t    offset,
                        const std::size_t    kernel_size, 
-                       const std::size_t    matrix_width)
+                       const std::size_t    matrix_width,
+                       const std::int64_t   min_disparity = DISPARITY_MIN_UNBOUNDED,
+                       const std::int64_t   max_disparity = DISPARITY_MAX_UNBOUNDED,
+                       std::uint8_t         *confidence = nullptr,
+                       const int            uniqueness_ratio = 0)
 {
-    T max{0};
-    T tmp;
+    using Acc = typename Traits::accumulator_type;
+
+    Acc max{0};
+    Acc tmp;
     std::size_t max_idx{0};
     const std::size_t pos = kernel_size / 2;
+    std::size_t begin, end;
+    PeakTracker<Acc> peak(Acc{0});
 
-    for (std::size_t i = pos; i < matrix_width - pos; i++) {
+    disparitySearchRange(offset, kernel_size, matrix_width, min_disparity, max_disparity, begin, end);
+
+    for (std::size_t i = begin; i < end; i++) {
         tmp = 0;
         for (std::size_t j = 0; j < kernel_size; j++) {
             for (std::size_t k = 0; k < kernel_size; k++) {
-                tmp += *(src1 + (j * matrix_width) + i - pos + k) * *(src2 + (j * matrix_width) + k + offset);
+                tmp += static_cast<Acc>(*(src1 + (j * matrix_width) + i - pos + k)) * static_cast<Acc>(*(src2 + (j * matrix_width) + k + offset));
             }
         }
         if (tmp >= max) {
             max = tmp;
             max_idx = i - 1;
         } 
+        if (confidence) {
+            peak.update(tmp);
+        }
     }
 
+    if (confidence) {
+        *confidence = peak.confidence(uniqueness_ratio);
+    }
     return max_idx;
 }
 
@@ -317,24 +630,34 @@ std::size_t argMaxCorr(const T              *src1,
  *        → Le due matrici \p src1 e \p src2 devono avere la stessa atezza del kernel. \n
  *        → Il vettore destinazione \p dst deve avere dimensione \p width - ( \p height - 1). \n
  * 
- * @tparam      T         Tipo delle matrici sorgenti e destinazione 
+ * @tparam      T               Tipo delle matrici sorgenti e destinazione 
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
  * 
- * @param[in]   src1      Prima matrice di input
- * @param[in]   src2      Seconda matrice di input
- * @param[out]  dst       Vettore destinazione
- * @param[in]   height    Dimensione del kernel, altezza delle due matrici \p src1, \p src2
- * @param[in]   width     Lunghezza delle due matrici
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Vettore destinazione
+ * @param[in]   height          Dimensione del kernel, altezza delle due matrici \p src1, \p src2
+ * @param[in]   width           Lunghezza delle due matrici
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ * @param[out]  confidence      Se non nullo, vettore della confidenza di ogni elemento di \p dst (vedi \p argMaxCorr )
+ * @param[in]   uniqueness_ratio Margine percentuale del test di unicità, 0 lo disabilita
  * 
  * @return void
 */
-template <typename T>
-void argMaxCorrVector(const T           *src1, 
-                      const T           *src2, 
-                      T                 *dst, 
-                      const std::size_t height, 
-                      const std::size_t width)
+template <typename T, typename Traits = MatchingTraits<T>>
+void argMaxCorrVector(const T               *src1, 
+                      const T               *src2, 
+                      typename Traits::output_type *dst, 
+                      const std::size_t     height, 
+                      const std::size_t     width,
+                      const std::int64_t    min_disparity = DISPARITY_MIN_UNBOUNDED,
+                      const std::int64_t    max_disparity = DISPARITY_MAX_UNBOUNDED,
+                      std::uint8_t          *confidence = nullptr,
+                      const int             uniqueness_ratio = 0)
 {
     inputParsing(src1, src2, height, width);
+    disparityParsing(min_disparity, max_disparity);
 
     if (!dst) {
         std::cerr << "Invalid destination matrix" <<
@@ -345,7 +668,8 @@ void argMaxCorrVector(const T           *src1,
     }
 
     for (std::size_t i = 0; i < width - (height - 1); i++) {
-        *(dst + i) = argMaxCorr<T>(src1, src2, i, height, width);
+        *(dst + i) = static_cast<typename Traits::output_type>(argMaxCorr<T, Traits>(src1, src2, i, height, width, min_disparity, max_disparity,
+                                                                                     confidence ? confidence + i : nullptr, uniqueness_ratio));
     }
 }
 
@@ -357,34 +681,357 @@ void argMaxCorrVector(const T           *src1,
  *        → Il kernel deve avere una dimensione dispari e deve essere una matrice quadrata. \n
  *        → La matrice destinazione deve avere dimensione (src_width - (kernel_size - 1)) * (src_height - (kernel_size - 1)). \n
  * 
- * @tparam      T           Tipo delle matrici sorgenti e destinazione 
+ * @tparam      T               Tipo delle matrici sorgenti e destinazione 
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
  * 
- * @param[in]   src1        Prima matrice di input
- * @param[in]   src2        Seconda matrice di input
- * @param[out]  dst         Matrice destinazione
- * @param[in]   width       Lunghezza delle due matrici \p src1, \p src2
- * @param[in]   height      Altezza delle due matrici \p src1, \p src2
- * @param[in]   kernel_size Dimensione del kernel
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ * @param[out]  confidence      Se non nulla, matrice della confidenza di ogni elemento di \p dst (vedi \p argMaxCorr ),
+ *                              della stessa dimensione della matrice destinazione
+ * @param[in]   uniqueness_ratio Margine percentuale del test di unicità, 0 lo disabilita
  * 
  * @return void
 */
-template <typename T>
+template <typename T, typename Traits = MatchingTraits<T>>
 void argMaxCorrMat(const T              *src1, 
                    const T              *src2, 
-                   T                    *dst, 
+                   typename Traits::output_type *dst, 
                    const std::size_t    width, 
                    const std::size_t    height, 
-                   const std::size_t    kernel_size)
+                   const std::size_t    kernel_size,
+                   const std::int64_t   min_disparity = DISPARITY_MIN_UNBOUNDED,
+                   const std::int64_t   max_disparity = DISPARITY_MAX_UNBOUNDED,
+                   std::uint8_t         *confidence = nullptr,
+                   const int            uniqueness_ratio = 0)
+{
+    const std::size_t dst_vect_size = width - (kernel_size - 1);
+
+    for (std::size_t i = 0; i < (height - kernel_size) + 1; i++) {
+        argMaxCorrVector<T, Traits>(
+            src1 + (i * width), 
+            src2 + (i * width), 
+            dst + (i * dst_vect_size), 
+            kernel_size, width,
+            min_disparity, max_disparity,
+            confidence ? confidence + (i * dst_vect_size) : nullptr, uniqueness_ratio);
+    }
+}
+
+
+/**
+ * @brief Versione di \p argMaxCorr con dimensione del kernel \p K nota a tempo di compilazione.
+ * @note  → I due cicli interni K X K hanno limiti costanti e possono essere srotolati dal compilatore. \n
+ *        → L'ordine delle somme è lo stesso di \p argMaxCorr, quindi il risultato è identico anche per
+ *          tipi in virgola mobile. \n
+ *
+ * @tparam      K               Dimensione del kernel, dispari e almeno \p KERNEL_LIMIT
+ * @tparam      T               Tipo della matrice sorgente e della matrice kernel
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ * 
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[in]   offset          Offset nella seconda matrice
+ * @param[in]   matrix_width    Lunghezza della matrice sorgente
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ * @param[out]  confidence      Se non nullo, riceve la confidenza del massimo (vedi \p argMaxCorr )
+ * @param[in]   uniqueness_ratio Margine percentuale del test di unicità, 0 lo disabilita
+ * 
+ * @return Ritorna la posizione in cui la cross-correlazione assume il massimo valore.
+ * @retval std::size_t
+*/
+template <std::size_t K, typename T, typename Traits = MatchingTraits<T>>
+std::size_t argMaxCorrFixed(const T             *src1, 
+                            const T             *src2, 
+                            const std::size_t   offset,
+                            const std::size_t   matrix_width,
+                            const std::int64_t  min_disparity = DISPARITY_MIN_UNBOUNDED,
+                            const std::int64_t  max_disparity = DISPARITY_MAX_UNBOUNDED,
+                            std::uint8_t        *confidence = nullptr,
+                            const int           uniqueness_ratio = 0)
+{
+    static_assert(K % 2 == 1 && K >= KERNEL_LIMIT, "Kernel size must be odd and at least KERNEL_LIMIT");
+
+    using Acc = typename Traits::accumulator_type;
+
+    Acc max{0};
+    Acc tmp;
+    std::size_t max_idx{0};
+    constexpr std::size_t pos = K / 2;
+    std::size_t begin, end;
+    PeakTracker<Acc> peak(Acc{0});
+
+    disparitySearchRange(offset, K, matrix_width, min_disparity, max_disparity, begin, end);
+
+    for (std::size_t i = begin; i < end; i++) {
+        tmp = 0;
+        for (std::size_t j = 0; j < K; j++) {
+            const T *row1 = src1 + (j * matrix_width) + i - pos;
+            const T *row2 = src2 + (j * matrix_width) + offset;
+            for (std::size_t k = 0; k < K; k++) {
+                tmp += static_cast<Acc>(row1[k]) * static_cast<Acc>(row2[k]);
+            }
+        }
+        if (tmp >= max) {
+            max = tmp;
+            max_idx = i - 1;
+        } 
+        if (confidence) {
+            peak.update(tmp);
+        }
+    }
+
+    if (confidence) {
+        *confidence = peak.confidence(uniqueness_ratio);
+    }
+    return max_idx;
+}
+
+
+/**
+ * @brief Versione di \p argMaxCorrVector con dimensione del kernel \p K nota a tempo di compilazione.
+ * @note  → Le matrici \p src1 e \p src2 devono avere dimensione \p K X \p width. \n
+ *        → Il vettore destinazione \p dst deve avere dimensione \p width - ( \p K - 1). \n
+ * 
+ * @tparam      K               Dimensione del kernel
+ * @tparam      T               Tipo delle matrici sorgenti
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ * 
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Vettore destinazione
+ * @param[in]   width           Lunghezza delle due matrici
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ * @param[out]  confidence      Se non nullo, vettore della confidenza di ogni elemento di \p dst (vedi \p argMaxCorr )
+ * @param[in]   uniqueness_ratio Margine percentuale del test di unicità, 0 lo disabilita
+ * 
+ * @return void
+*/
+template <std::size_t K, typename T, typename Traits = MatchingTraits<T>>
+void argMaxCorrVectorFixed(const T              *src1, 
+                           const T              *src2, 
+                           typename Traits::output_type *dst, 
+                           const std::size_t    width,
+                           const std::int64_t   min_disparity = DISPARITY_MIN_UNBOUNDED,
+                           const std::int64_t   max_disparity = DISPARITY_MAX_UNBOUNDED,
+                           std::uint8_t         *confidence = nullptr,
+                           const int            uniqueness_ratio = 0)
+{
+    inputParsing(src1, src2, K, width);
+    disparityParsing(min_disparity, max_disparity);
+
+    if (!dst) {
+        std::cerr << "Invalid destination matrix" <<
+        "\n→ Line: " << __LINE__ << 
+        "\n→ Function: " << __func__  << 
+        "\n→ File: " << __FILE__ << std::endl;;
+        exit(EXIT_FAILURE); 
+    }
+
+    for (std::size_t i = 0; i < width - (K - 1); i++) {
+        *(dst + i) = static_cast<typename Traits::output_type>(argMaxCorrFixed<K, T, Traits>(src1, src2, i, width, min_disparity, max_disparity,
+                                                                                             confidence ? confidence + i : nullptr, uniqueness_ratio));
+    }
+}
+
+
+/**
+ * @brief Sceglie a runtime la specializzazione di \p argMaxCorrVectorFixed per \p height (3, 5, 7, 9, 11);
+ *        per le altre dimensioni esegue \p argMaxCorrVector.
+ * 
+ * @tparam      T               Tipo delle matrici sorgenti
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ * 
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Vettore destinazione
+ * @param[in]   height          Dimensione del kernel, altezza delle due matrici \p src1, \p src2
+ * @param[in]   width           Lunghezza delle due matrici
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ * @param[out]  confidence      Se non nullo, vettore della confidenza di ogni elemento di \p dst (vedi \p argMaxCorr )
+ * @param[in]   uniqueness_ratio Margine percentuale del test di unicità, 0 lo disabilita
+ * 
+ * @return void
+*/
+template <typename T, typename Traits = MatchingTraits<T>>
+void argMaxCorrVectorDispatch(const T               *src1, 
+                              const T               *src2, 
+                              typename Traits::output_type *dst, 
+                              const std::size_t     height, 
+                              const std::size_t     width,
+                              const std::int64_t    min_disparity = DISPARITY_MIN_UNBOUNDED,
+                              const std::int64_t    max_disparity = DISPARITY_MAX_UNBOUNDED,
+                              std::uint8_t          *confidence = nullptr,
+                              const int             uniqueness_ratio = 0)
+{
+    switch (height) {
+        case 3:
+            argMaxCorrVectorFixed<3, T, Traits>(src1, src2, dst, width, min_disparity, max_disparity, confidence, uniqueness_ratio);
+            break;
+        case 5:
+            argMaxCorrVectorFixed<5, T, Traits>(src1, src2, dst, width, min_disparity, max_disparity, confidence, uniqueness_ratio);
+            break;
+        case 7:
+            argMaxCorrVectorFixed<7, T, Traits>(src1, src2, dst, width, min_disparity, max_disparity, confidence, uniqueness_ratio);
+            break;
+        case 9:
+            argMaxCorrVectorFixed<9, T, Traits>(src1, src2, dst, width, min_disparity, max_disparity, confidence, uniqueness_ratio);
+            break;
+        case 11:
+            argMaxCorrVectorFixed<11, T, Traits>(src1, src2, dst, width, min_disparity, max_disparity, confidence, uniqueness_ratio);
+            break;
+        default:
+            argMaxCorrVector<T, Traits>(src1, src2, dst, height, width, min_disparity, max_disparity, confidence, uniqueness_ratio);
+            break;
+    }
+}
+
+
+/**
+ * @brief Versione di \p argMaxCorrMat che usa le specializzazioni sulla dimensione del kernel
+ *        (vedi \p argMaxCorrVectorDispatch ). Il risultato è identico a \p argMaxCorrMat.
+ * 
+ * @tparam      T               Tipo delle matrici sorgenti
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ * 
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ * @param[out]  confidence      Se non nulla, matrice della confidenza di ogni elemento di \p dst (vedi \p argMaxCorr ),
+ *                              della stessa dimensione della matrice destinazione
+ * @param[in]   uniqueness_ratio Margine percentuale del test di unicità, 0 lo disabilita
+ * 
+ * @return void
+*/
+template <typename T, typename Traits = MatchingTraits<T>>
+void argMaxCorrMatDispatch(const T              *src1, 
+                           const T              *src2, 
+                           typename Traits::output_type *dst, 
+                           const std::size_t    width, 
+                           const std::size_t    height, 
+                           const std::size_t    kernel_size,
+                           const std::int64_t   min_disparity = DISPARITY_MIN_UNBOUNDED,
+                           const std::int64_t   max_disparity = DISPARITY_MAX_UNBOUNDED,
+                           std::uint8_t         *confidence = nullptr,
+                           const int            uniqueness_ratio = 0)
 {
     const std::size_t dst_vect_size = width - (kernel_size - 1);
 
     for (std::size_t i = 0; i < (height - kernel_size) + 1; i++) {
-        argMaxCorrVector<T>(
+        argMaxCorrVectorDispatch<T, Traits>(
             src1 + (i * width), 
             src2 + (i * width), 
             dst + (i * dst_vect_size), 
-            kernel_size, width);
+            kernel_size, width,
+            min_disparity, max_disparity,
+            confidence ? confidence + (i * dst_vect_size) : nullptr, uniqueness_ratio);
+    }
+}
+
+
+/**
+ * @brief Calcola l'intervallo di righe [ \p begin, \p end ) assegnato alla banda \p band di \p bands.
+ * @note  Le bande sono contigue e differiscono al più di una riga.
+ *
+ * @param[in]   rows    Numero di righe da partizionare
+ * @param[in]   bands   Numero di bande
+ * @param[in]   band    Indice della banda
+ * @param[out]  begin   Prima riga della banda
+ * @param[out]  end     Riga successiva all'ultima della banda
+ * 
+ * @return void
+*/
+inline void rowBand(const std::size_t   rows,
+                    const std::size_t   bands,
+                    const std::size_t   band,
+                    std::size_t         &begin,
+                    std::size_t         &end)
+{
+    begin = (rows * band) / bands;
+    end = (rows * (band + 1)) / bands;
+}
+
+
+/**
+ * @brief Versione parallela di \p argMaxCorrMat: le righe della matrice destinazione sono partizionate
+ *        in bande contigue, una per thread OpenMP.
+ * @note  → Ogni riga destinazione è calcolata da un solo thread con \p argMaxCorrVectorDispatch, quindi il
+ *          risultato è identico bit a bit a \p argMaxCorrMat per qualunque numero di thread. \n
+ *        → Se \p num_threads vale 0 viene usato il numero di thread di default di OpenMP. \n
+ *        → Senza supporto OpenMP la funzione esegue la versione sequenziale. \n
+ * 
+ * @tparam      T               Tipo delle matrici sorgenti e destinazione 
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ * 
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   num_threads     Numero di thread
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ * @param[out]  confidence      Se non nulla, matrice della confidenza di ogni elemento di \p dst (vedi \p argMaxCorr ),
+ *                              della stessa dimensione della matrice destinazione
+ * @param[in]   uniqueness_ratio Margine percentuale del test di unicità, 0 lo disabilita
+ * 
+ * @return void
+*/
+template <typename T, typename Traits = MatchingTraits<T>>
+void argMaxCorrMatParallel(const T              *src1, 
+                           const T              *src2, 
+                           typename Traits::output_type *dst, 
+                           const std::size_t    width, 
+                           const std::size_t    height, 
+                           const std::size_t    kernel_size,
+                           const std::size_t    num_threads = 0,
+                           const std::int64_t   min_disparity = DISPARITY_MIN_UNBOUNDED,
+                           const std::int64_t   max_disparity = DISPARITY_MAX_UNBOUNDED,
+                           std::uint8_t         *confidence = nullptr,
+                           const int            uniqueness_ratio = 0)
+{
+    const std::size_t dst_vect_size = width - (kernel_size - 1);
+    const std::size_t dst_rows = (height - kernel_size) + 1;
+
+#ifdef _OPENMP
+    const int threads = num_threads ? static_cast<int>(num_threads) : omp_get_max_threads();
+
+    #pragma omp parallel num_threads(threads)
+    {
+        std::size_t begin, end;
+        rowBand(dst_rows, static_cast<std::size_t>(omp_get_num_threads()),
+                static_cast<std::size_t>(omp_get_thread_num()), begin, end);
+
+        for (std::size_t i = begin; i < end; i++) {
+            argMaxCorrVectorDispatch<T, Traits>(
+                src1 + (i * width), 
+                src2 + (i * width), 
+                dst + (i * dst_vect_size), 
+                kernel_size, width,
+                min_disparity, max_disparity,
+                confidence ? confidence + (i * dst_vect_size) : nullptr, uniqueness_ratio);
+        }
     }
+#else
+    (void) num_threads;
+    (void) dst_rows;
+    argMaxCorrMatDispatch<T, Traits>(src1, src2, dst, width, height, kernel_size, min_disparity, max_disparity,
+                                     confidence, uniqueness_ratio);
+#endif
 }
 
 
@@ -396,33 +1043,45 @@ void argMaxCorrMat(const T              *src1,
  *        → il kernel deve avere una dimensione dispari e deve essere una matrice quadrata. \n
  *
  * @tparam      T               Tipo della matrice sorgente e della matrice kernel
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
  * 
  * @param[in]   src             Matrice di input
  * @param[in]   kernel          Matrice kernel
  * @param[in]   kernel_size     Dimensione della matrice kernel
  * @param[in]   matrix_width    Lunghezza della matrice sorgente
+ * @param[in]   offset          Colonna da cui è stato prelevato il kernel, usata solo per limitare la disparità
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
  * 
  * @return Ritorna la posizione in cui la cross-correlazione assume il massimo valore.
  * @retval std::size_t
 */
-template <typename T>
+template <typename T, typename Traits = MatchingTraits<T>>
 std::size_t argMaxCorrWithCopy(const T              *src, 
                                const T              *kernel, 
                                const std::size_t    kernel_size, 
-                               const std::size_t    matrix_width)
+                               const std::size_t    matrix_width,
+                               const std::size_t    offset = 0,
+                               const std::int64_t   min_disparity = DISPARITY_MIN_UNBOUNDED,
+                               const std::int64_t   max_disparity = DISPARITY_MAX_UNBOUNDED)
 {
     inputParsing(src, kernel, kernel_size, matrix_width);
 
-    T max{0};
-    T tmp;
+    using Acc = typename Traits::accumulator_type;
+
+    Acc max{0};
+    Acc tmp;
     std::size_t max_idx{0};
     const std::size_t pos = kernel_size / 2;
+    std::size_t begin, end;
 
-    for (std::size_t i = pos; i < matrix_width - pos; i++) {
+    disparitySearchRange(offset, kernel_size, matrix_width, min_disparity, max_disparity, begin, end);
+
+    for (std::size_t i = begin; i < end; i++) {
         tmp = 0;
         for (std::size_t j = 0; j < kernel_size; j++) {
             for (std::size_t k = 0; k < kernel_size; k++) {
-                tmp += *(src + (j * matrix_width) + i - pos + k) * *(kernel + (j * kernel_size) + k);
+                tmp += static_cast<Acc>(*(src + (j * matrix_width) + i - pos + k)) * static_cast<Acc>(*(kernel + (j * kernel_size) + k));
             }
         }
         if (tmp >= max) {
@@ -435,30 +1094,67 @@ std::size_t argMaxCorrWithCopy(const T              *src,
 }
 
 
+/**
+ * @brief Calcola la dimensione in byte del \p MatcherWorkspace usato da \p argMaxCorrMatWithCopy.
+ * @note  La dimensione comprende le K righe delle due matrici, il vettore destinazione e il kernel di
+ *        \p argMaxCorrVectorWithCopy; con la stessa risoluzione e lo stesso kernel non cambia tra i frame.
+ *
+ * @tparam      T               Tipo delle matrici sorgenti
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ *
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ *
+ * @return Dimensione in byte del workspace
+ * @retval std::size_t
+*/
+template <typename T, typename Traits = MatchingTraits<T>>
+std::size_t withCopyWorkspaceSize(const std::size_t width, const std::size_t kernel_size)
+{
+    using stereodepth::MatcherWorkspace;
+
+    return 2 * MatcherWorkspace::bytes<T>(width * kernel_size) +
+           MatcherWorkspace::bytes<typename Traits::output_type>(width - (kernel_size - 1)) +
+           MatcherWorkspace::bytes<T>(kernel_size * kernel_size);
+}
+
+
 /**
  * @brief Calcola la cross-correlazione tra \p src1 e \p src2 con un kernel di dimensione \p height X \p height.
  * @note  → Le matrici \p src1 e \p src2 devono avere dimensione \p height X \p width. \n
  *        → Le due matrici \p src1 e \p src2 devono avere la stessa atezza del kernel. \n
  *        → Il vettore destinazione \p dst deve avere dimensione \p width - ( \p height - 1). \n
+ *        → Il kernel è preso da \p workspace e restituito al termine: se il workspace è già abbastanza
+ *          grande la funzione non alloca memoria. \n
  * 
- * @tparam      T         Tipo delle matrici sorgenti e destinazione 
+ * @tparam      T               Tipo delle matrici sorgenti e destinazione 
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
  * 
- * @param[in]   src1      Prima matrice di input
- * @param[in]   src2      Seconda matrice di input
- * @param[out]  dst       Vettore destinazione
- * @param[in]   height    Dimensione del kernel, altezza delle due matrici \p src1, \p src2
- * @param[in]   width     Lunghezza delle due matrici
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Vettore destinazione
+ * @param[in]   height          Dimensione del kernel, altezza delle due matrici \p src1, \p src2
+ * @param[in]   width           Lunghezza delle due matrici
+ * @param[in]   workspace       Memoria di lavoro
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
  * 
  * @return void
 */
-template <typename T>
-void argMaxCorrVectorWithCopy(const T           *src1, 
-                              const T           *src2, 
-                              T                 *dst, 
-                              const std::size_t height, 
-                              const std::size_t width)
+template <typename T, typename Traits = MatchingTraits<T>>
+void argMaxCorrVectorWithCopy(const T                       *src1, 
+                              const T                       *src2, 
+                              typename Traits::output_type  *dst, 
+                              const std::size_t             height, 
+                              const std::size_t             width,
+                              stereodepth::MatcherWorkspace &workspace,
+                              const std::int64_t            min_disparity = DISPARITY_MIN_UNBOUNDED,
+                              const std::int64_t            max_disparity = DISPARITY_MAX_UNBOUNDED)
 {
+    using stereodepth::MatcherWorkspace;
+
     inputParsing(src1, src2, height, width);
+    disparityParsing(min_disparity, max_disparity);
 
     if (!dst) {
         std::cerr << "Invalid destination matrix" <<
@@ -468,22 +1164,46 @@ void argMaxCorrVectorWithCopy(const T           *src1,
         exit(EXIT_FAILURE); 
     }
 
-    T *k = new(std::nothrow) T[height * height];
-
-    if (!k) {
-        std::cerr << "Memory allocation failed" <<
-        "\n→ Line: " << __LINE__ << 
-        "\n→ Function: " << __func__  << 
-        "\n→ File: " << __FILE__ << std::endl;;
-        exit(EXIT_FAILURE); 
-    }
+    const std::size_t mark = workspace.mark();
+    workspace.reserve(mark + MatcherWorkspace::bytes<T>(height * height));
+    T *k = workspace.allocate<T>(height * height);
 
     for (std::size_t i = 0; i < width - (height - 1); i++) {       
         copySrcToKernel<T>(src2, k, i, height, width);
-        *(dst + i) = argMaxCorrWithCopy<T>(src1, k, height, width);
+        *(dst + i) = static_cast<typename Traits::output_type>(argMaxCorrWithCopy<T, Traits>(src1, k, height, width, i, min_disparity, max_disparity));
     }
 
-    delete[] k;
+    workspace.rewind(mark);
+}
+
+
+/**
+ * @brief Versione di \p argMaxCorrVectorWithCopy con un workspace temporaneo allocato ad ogni chiamata.
+ * 
+ * @tparam      T               Tipo delle matrici sorgenti e destinazione 
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ * 
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Vettore destinazione
+ * @param[in]   height          Dimensione del kernel, altezza delle due matrici \p src1, \p src2
+ * @param[in]   width           Lunghezza delle due matrici
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ * 
+ * @return void
+*/
+template <typename T, typename Traits = MatchingTraits<T>>
+void argMaxCorrVectorWithCopy(const T               *src1, 
+                              const T               *src2, 
+                              typename Traits::output_type *dst, 
+                              const std::size_t     height, 
+                              const std::size_t     width,
+                              const std::int64_t    min_disparity = DISPARITY_MIN_UNBOUNDED,
+                              const std::int64_t    max_disparity = DISPARITY_MAX_UNBOUNDED)
+{
+    stereodepth::MatcherWorkspace workspace;
+    argMaxCorrVectorWithCopy<T, Traits>(src1, src2, dst, height, width, workspace, min_disparity, max_disparity);
 }
 
 
@@ -493,63 +1213,82 @@ void argMaxCorrVectorWithCopy(const T           *src1,
  *        → Le matrici \p src1 e \p src2 possono avere altezza maggiore o uguale a \p kernel_size. \n
  *        → Il kernel deve avere una dimensione dispari e deve essere una matrice quadrata. \n
  *        → La matrice destinazione deve avere dimensione (src_width - (kernel_size - 1)) * (src_height - (kernel_size - 1)). \n
+ *        → I buffer di lavoro sono presi da \p workspace (vedi \p withCopyWorkspaceSize ): dal secondo frame
+ *          con la stessa risoluzione la funzione non alloca memoria. \n
  * 
- * @tparam      T           Tipo delle matrici sorgenti e destinazione 
+ * @tparam      T               Tipo delle matrici sorgenti e destinazione 
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
  * 
- * @param[in]   src1        Prima matrice di input
- * @param[in]   src2        Seconda matrice di input
- * @param[out]  dst         Matrice destinazione
- * @param[in]   width       Lunghezza delle due matrici \p src1, \p src2
- * @param[in]   height      Altezza delle due matrici \p src1, \p src2
- * @param[in]   kernel_size Dimensione del kernel
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   workspace       Memoria di lavoro
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
  * 
  * @return void
 */
-template <typename T>
-void argMaxCorrMatWithCopy(const T              *src1, 
-                           const T              *src2, 
-                           T                    *dst, 
-                           const std::size_t    width, 
-                           const std::size_t    height, 
-                           const std::size_t    kernel_size)
+template <typename T, typename Traits = MatchingTraits<T>>
+void argMaxCorrMatWithCopy(const T                          *src1, 
+                           const T                          *src2, 
+                           typename Traits::output_type     *dst, 
+                           const std::size_t                width, 
+                           const std::size_t                height, 
+                           const std::size_t                kernel_size,
+                           stereodepth::MatcherWorkspace    &workspace,
+                           const std::int64_t               min_disparity = DISPARITY_MIN_UNBOUNDED,
+                           const std::int64_t               max_disparity = DISPARITY_MAX_UNBOUNDED)
 {
-    T *src1_k_rows = new(std::nothrow) T[width * kernel_size];
-
-    if (!src1_k_rows) {
-        std::cerr << "Memory allocation failed" <<
-        "\n→ Line: " << __LINE__ << 
-        "\n→ Function: " << __func__  << 
-        "\n→ File: " << __FILE__ << std::endl;;
-        exit(EXIT_FAILURE);
-    }
-
-    T *src2_k_rows = new(std::nothrow) T[width * kernel_size];
-
-    if (!src2_k_rows) {
-        std::cerr << "Memory allocation failed" <<
-        "\n→ Line: " << __LINE__ << 
-        "\n→ Function: " << __func__  << 
-        "\n→ File: " << __FILE__ << std::endl;;
-        exit(EXIT_FAILURE);
-    }
+    const std::size_t mark = workspace.mark();
+    workspace.reserve(mark + withCopyWorkspaceSize<T, Traits>(width, kernel_size));
 
     const std::size_t dst_vect_size = width - (kernel_size - 1);
-    T *dst_vect = new(std::nothrow) T[dst_vect_size];
-
-    if (!dst_vect) {
-        std::cerr << "Memory allocation failed" <<
-        "\n→ Line: " << __LINE__ << 
-        "\n→ Function: " << __func__  << 
-        "\n→ File: " << __FILE__ << std::endl;;
-        exit(EXIT_FAILURE);
-    }
+    T *src1_k_rows = workspace.allocate<T>(width * kernel_size);
+    T *src2_k_rows = workspace.allocate<T>(width * kernel_size);
+    typename Traits::output_type *dst_vect = workspace.allocate<typename Traits::output_type>(dst_vect_size);
 
     for (std::size_t i = 0; i < (height - kernel_size) + 1; i++) {
         copySrcToSrcKernelRows<T>(src1, src1_k_rows, i, kernel_size, width);
         copySrcToSrcKernelRows<T>(src2, src2_k_rows, i, kernel_size, width);
-        argMaxCorrVectorWithCopy<T>(src1_k_rows, src2_k_rows, dst_vect, kernel_size, width);
-        concatDst<T>(dst_vect, dst, dst_vect_size, i);
+        argMaxCorrVectorWithCopy<T, Traits>(src1_k_rows, src2_k_rows, dst_vect, kernel_size, width, workspace, min_disparity, max_disparity);
+        concatDst<typename Traits::output_type>(dst_vect, dst, dst_vect_size, i);
     }
 
-    delete src1_k_rows; delete src2_k_rows; delete dst_vect;
-}
\ No newline at end of file
+    workspace.rewind(mark);
+}
+
+
+/**
+ * @brief Versione di \p argMaxCorrMatWithCopy con un workspace temporaneo allocato ad ogni chiamata.
+ * @note  Per elaborare più frame senza allocazioni usare la versione con \p MatcherWorkspace.
+ * 
+ * @tparam      T               Tipo delle matrici sorgenti e destinazione 
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ * 
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ * 
+ * @return void
+*/
+template <typename T, typename Traits = MatchingTraits<T>>
+void argMaxCorrMatWithCopy(const T              *src1, 
+                           const T              *src2, 
+                           typename Traits::output_type *dst, 
+                           const std::size_t    width, 
+                           const std::size_t    height, 
+                           const std::size_t    kernel_size,
+                           const std::int64_t   min_disparity = DISPARITY_MIN_UNBOUNDED,
+                           const std::int64_t   max_disparity = DISPARITY_MAX_UNBOUNDED)
+{
+    stereodepth::MatcherWorkspace workspace(withCopyWorkspaceSize<T, Traits>(width, kernel_size));
+    argMaxCorrMatWithCopy<T, Traits>(src1, src2, dst, width, height, kernel_size, workspace, min_disparity, max_disparity);
+}
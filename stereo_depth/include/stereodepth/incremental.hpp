@@ -0,0 +1,264 @@
+/***************************************************************************
+ *            incremental.hpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+
+/*! \file  incremental.hpp
+ *  \brief Tiled matcher that recomputes only the tiles whose sources changed.
+ */
+
+#include "type.hpp"
+#include "simd.hpp"
+#include "tiled.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+#ifndef STEREODEPTH_INCREMENTAL_HPP
+#define STEREODEPTH_INCREMENTAL_HPP
+
+namespace stereodepth {
+
+/**
+ * \brief Sum of absolute differences between two rows x cols blocks of
+ * images with rows of stride elements.
+ */
+template <typename T>
+double block_sad(const T* a, const T* b, SizeType stride,
+                 SizeType rows, SizeType cols)
+{
+    double sum = 0.0;
+    for (SizeType r = 0; r < rows; ++r)
+    {
+        for (SizeType c = 0; c < cols; ++c)
+        {
+            const double x = static_cast<double>(a[r * stride + c]);
+            const double y = static_cast<double>(b[r * stride + c]);
+            sum += x > y ? x - y : y - x;
+        }
+    }
+    return sum;
+}
+
+/// 8 bit images use the vector kernel of blockSadU8.
+inline double block_sad(const std::uint8_t* a, const std::uint8_t* b,
+                        SizeType stride, SizeType rows, SizeType cols)
+{
+    return static_cast<double>(blockSadU8(a, b, stride, rows, cols));
+}
+
+/**
+ * \brief TiledMatcher for fixed cameras, which keeps the disparity of the
+ * previous frame and recomputes only the tiles whose sources changed.
+ *
+ * A tile is dirty when the mean absolute difference between the current
+ * and the previous frame, over the region of both sources it reads (the
+ * tile with its kernel and disparity halo), exceeds max_change. A pixel
+ * that changes therefore dirties every tile whose output depends on it.
+ * With max_change = 0 the output is identical to argMaxCorrMat; a small
+ * positive threshold absorbs sensor noise. Clean tiles keep the cached
+ * disparity. The first frame, and the first after reset(), recomputes
+ * every tile.
+ *
+ * Post-processing can be limited to the same tiles with the callback of
+ * execute(), called once for each recomputed tile after its disparity is
+ * in the destination.
+ * \tparam T      Type of the source matrices.
+ * \tparam Traits Accumulator and destination types (see MatchingTraits).
+ */
+template <typename T, typename Traits = MatchingTraits<T>>
+class IncrementalMatcher
+{
+public:
+    using output_type = typename Traits::output_type;
+    using TileCallback = std::function<void(const Tile&)>;
+
+    /**
+     * \param width         Width of the source matrices.
+     * \param height        Height of the source matrices.
+     * \param kernel_size   Size of the matching window.
+     * \param min_disparity Minimum disparity searched.
+     * \param max_disparity Maximum disparity searched.
+     * \param config        Tile shape and cache budget.
+     * \param max_change    Mean absolute difference above which a tile is
+     *                      recomputed.
+     */
+    IncrementalMatcher(SizeType width, SizeType height, SizeType kernel_size,
+                       std::int64_t min_disparity = DISPARITY_MIN_UNBOUNDED,
+                       std::int64_t max_disparity = DISPARITY_MAX_UNBOUNDED,
+                       TileConfig config = TileConfig(),
+                       double max_change = 0.0)
+        : _tiled{width, height, kernel_size, min_disparity, max_disparity, config}
+        , _max_change{max_change}
+        , _has_history{false}
+        , _recomputed{0}
+    {
+        if (!_tiled.valid()) return;
+
+        const auto& plan = _tiled.plan();
+        std::int64_t min_d = min_disparity;
+        std::int64_t max_d = max_disparity;
+        clampDisparityRange(width, kernel_size, min_d, max_d);
+        const std::int64_t last = static_cast<std::int64_t>(width - kernel_size);
+
+        // Columns of the first source read by the candidate windows of each
+        // tile, as in disparitySearchRange.
+        for (const Tile& tile : _tiled.tiles())
+        {
+            const std::int64_t first = std::max(
+                static_cast<std::int64_t>(tile.col_begin) - max_d, std::int64_t{0});
+            const std::int64_t end = std::min(
+                static_cast<std::int64_t>(tile.col_end) - 1 - min_d, last);
+            Region region;
+            region.col1_begin = static_cast<SizeType>(std::min(first, last));
+            region.col1_end = first > end ? region.col1_begin
+                                          : static_cast<SizeType>(end) + kernel_size;
+            _regions.push_back(region);
+        }
+
+        _previous1.resize(width * height);
+        _previous2.resize(width * height);
+        _cache.resize(plan.output_width() * plan.output_height());
+        _dirty.resize(_tiled.tiles().size(), 0);
+    }
+
+    PlanStatus status() const { return _tiled.status(); }
+    bool valid() const { return _tiled.valid(); }
+    const TiledMatcher<T, Traits>& tiled() const { return _tiled; }
+    double max_change() const { return _max_change; }
+
+    /// True once a frame has been matched since construction or reset().
+    bool has_history() const { return _has_history; }
+
+    /// One flag per tile of tiled().tiles(): recomputed in the last frame.
+    const std::vector<std::uint8_t>& dirty() const { return _dirty; }
+
+    /// Tiles recomputed in the last frame.
+    SizeType recomputed_tiles() const { return _recomputed; }
+
+    /// Fraction of the tiles recomputed in the last frame.
+    double recomputed_fraction() const
+    {
+        return _dirty.empty() ? 0.0
+                              : static_cast<double>(_recomputed) / _dirty.size();
+    }
+
+    /// Forget the previous frame: the next one recomputes every tile.
+    void reset()
+    {
+        _has_history = false;
+    }
+
+    /**
+     * \brief Match the next frame.
+     * \param src1    First source matrix, height x width.
+     * \param src2    Second source matrix, height x width.
+     * \param dst     Destination matrix, as StereoMatcherPlan::execute; it
+     *                receives the whole map, cached tiles included.
+     * \param on_tile Optional callback for each recomputed tile.
+     * \return OK, INVALID_PLAN or NULL_POINTER; nothing is touched on error.
+     */
+    PlanStatus execute(const T* src1, const T* src2, output_type* dst,
+                       const TileCallback& on_tile = TileCallback())
+    {
+        if (!valid()) return PlanStatus::INVALID_PLAN;
+        if (!src1 || !src2 || !dst) return PlanStatus::NULL_POINTER;
+        update_tiles(src1, src2, dst, on_tile, 0, _dirty.size());
+        finish(src1, src2);
+        return PlanStatus::OK;
+    }
+
+    /**
+     * \brief As execute, with the tiles checked and recomputed in parallel
+     * on pool; on_tile may be called from any thread of the pool.
+     */
+    PlanStatus execute(const T* src1, const T* src2, output_type* dst,
+                       ThreadPool& pool,
+                       const TileCallback& on_tile = TileCallback())
+    {
+        if (!valid()) return PlanStatus::INVALID_PLAN;
+        if (!src1 || !src2 || !dst) return PlanStatus::NULL_POINTER;
+        pool.parallel_for(0, _dirty.size(), 1, [&](SizeType begin, SizeType end) {
+            update_tiles(src1, src2, dst, on_tile, begin, end);
+        });
+        finish(src1, src2);
+        return PlanStatus::OK;
+    }
+
+private:
+    /// Columns of the first source read by a tile.
+    struct Region
+    {
+        SizeType col1_begin;
+        SizeType col1_end;
+    };
+
+    bool changed(const T* src1, const T* src2, SizeType index) const
+    {
+        const Tile& tile = _tiled.tiles()[index];
+        const Region& region = _regions[index];
+        const SizeType width = _tiled.plan().width();
+        const SizeType halo = _tiled.plan().kernel_size() - 1;
+        const SizeType rows = tile.row_end - tile.row_begin + halo;
+        const SizeType cols1 = region.col1_end - region.col1_begin;
+        const SizeType cols2 = tile.col_end - tile.col_begin + halo;
+        const SizeType offset1 = tile.row_begin * width + region.col1_begin;
+        const SizeType offset2 = tile.row_begin * width + tile.col_begin;
+
+        const double sad = block_sad(src1 + offset1, _previous1.data() + offset1, width, rows, cols1)
+                         + block_sad(src2 + offset2, _previous2.data() + offset2, width, rows, cols2);
+        return sad > _max_change * static_cast<double>(rows * (cols1 + cols2));
+    }
+
+    void update_tiles(const T* src1, const T* src2, output_type* dst,
+                      const TileCallback& on_tile, SizeType begin, SizeType end)
+    {
+        const SizeType dst_width = _tiled.plan().output_width();
+        for (SizeType i = begin; i < end; ++i)
+        {
+            const Tile& tile = _tiled.tiles()[i];
+            _dirty[i] = !_has_history || changed(src1, src2, i);
+            if (_dirty[i])
+            {
+                _tiled.execute_tile(src1, src2, _cache.data(), i);
+            }
+            for (SizeType row = tile.row_begin; row < tile.row_end; ++row)
+            {
+                const SizeType offset = row * dst_width;
+                std::copy(_cache.begin() + offset + tile.col_begin,
+                          _cache.begin() + offset + tile.col_end,
+                          dst + offset + tile.col_begin);
+            }
+            if (_dirty[i] && on_tile) on_tile(tile);
+        }
+    }
+
+    void finish(const T* src1, const T* src2)
+    {
+        std::copy(src1, src1 + _previous1.size(), _previous1.begin());
+        std::copy(src2, src2 + _previous2.size(), _previous2.begin());
+        _recomputed = static_cast<SizeType>(
+            std::count(_dirty.begin(), _dirty.end(), std::uint8_t{1}));
+        _has_history = true;
+    }
+
+    TiledMatcher<T, Traits> _tiled;
+    double _max_change;
+    bool _has_history;
+    SizeType _recomputed;
+    std::vector<Region> _regions;
+    std::vector<T> _previous1;
+    std::vector<T> _previous2;
+    std::vector<output_type> _cache;
+    std::vector<std::uint8_t> _dirty;
+};
+
+} // namespace stereodepth
+
+#endif // STEREODEPTH_INCREMENTAL_HPP
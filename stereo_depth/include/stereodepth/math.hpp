@@ -11,13 +11,17 @@
  */
 
 #include "type.hpp"
+#include "thread_pool.hpp"
 
 #include <cmath>
 #include <functional>
 #include <cassert>
 #include <stdexcept>
 #include <tuple>
+#include <type_traits>
+#include <utility>
 #include <algorithm>
+#include <array>
 #include <iterator>
 #include <limits>
 #include <vector>
@@ -26,6 +30,10 @@
 
 #include <iostream>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #ifndef STEREODEPTH_MATH_HPP
 #define STEREODEPTH_MATH_HPP
 
@@ -57,82 +65,91 @@ public:
         SizeType channel;
     };
 
+    /**
+     * \brief Fixed size shape of N dimensions, stored inline so that it can
+     * be built and copied without allocations, also in constant expressions.
+     * \tparam N Number of dimensions.
+     */
+    template <SizeType N>
     struct Shape {
     public:
-        Shape(std::vector<SizeType> values)
+        constexpr Shape(std::array<SizeType, N> values)
             : _shape{values}
         {}
 
-        [[nodiscard]] SizeType size() const
+        [[nodiscard]] constexpr SizeType size() const
         {
-            return std::accumulate(_shape.begin(), _shape.end(),
-                                   SizeType(1),
-                                   std::multiplies<SizeType>());
+            SizeType ret = 1;
+            for (SizeType i = 0; i < N; ++i) ret *= _shape[i];
+            return ret;
         }
 
-        operator std::vector<SizeType>() const { return _shape; }
+        operator std::vector<SizeType>() const
+        { return std::vector<SizeType>(_shape.begin(), _shape.end()); }
 
         SizeType& operator[](SizeType idx) { return _shape[idx]; }
-        [[nodiscard]] const SizeType& at(SizeType idx) const
+        constexpr const SizeType& operator[](SizeType idx) const
+        { return _shape[idx]; }
+        [[nodiscard]] constexpr const SizeType& at(SizeType idx) const
         { return _shape.at(idx); }
 
     protected:
-        std::vector<SizeType> _shape;
+        std::array<SizeType, N> _shape;
     };
 
-    struct Shape2d : public Shape {
+    struct Shape2d : public Shape<2> {
     public:
-        static inline SizeType SIZE = 2;
-        static inline SizeType HEIGHT_IDX = 0;
-        static inline SizeType WIDTH_IDX = 1;
+        static constexpr SizeType SIZE = 2;
+        static constexpr SizeType HEIGHT_IDX = 0;
+        static constexpr SizeType WIDTH_IDX = 1;
 
-        Shape2d(SizeType h, SizeType w)
-            : Shape{{h,w}}
+        constexpr Shape2d(SizeType h, SizeType w)
+            : Shape<2>(std::array<SizeType, 2>{{h, w}})
         {}
 
-        Shape2d(SizeType s)
-            : Shape{{s,s}}
+        constexpr Shape2d(SizeType s)
+            : Shape<2>(std::array<SizeType, 2>{{s, s}})
         {}
 
-        [[nodiscard]] const SizeType& height() const
+        [[nodiscard]] constexpr const SizeType& height() const
         { return _shape[HEIGHT_IDX]; }
-        [[nodiscard]]       SizeType& height()
+        [[nodiscard]]           SizeType& height()
         { return _shape[HEIGHT_IDX]; }
 
-        [[nodiscard]] const SizeType& width() const
+        [[nodiscard]] constexpr const SizeType& width() const
         { return _shape[WIDTH_IDX]; }
-        [[nodiscard]]       SizeType& width()
+        [[nodiscard]]           SizeType& width()
         { return _shape[WIDTH_IDX]; }
     };
 
-    struct Shape3d : public Shape {
+    struct Shape3d : public Shape<3> {
     public:
-        static inline SizeType SIZE = 3;
-        static inline SizeType HEIGHT_IDX = 0;
-        static inline SizeType WIDTH_IDX = 1;
-        static inline SizeType CHANNEL_IDX = 2;
+        static constexpr SizeType SIZE = 3;
+        static constexpr SizeType HEIGHT_IDX = 0;
+        static constexpr SizeType WIDTH_IDX = 1;
+        static constexpr SizeType CHANNEL_IDX = 2;
 
-        Shape3d(Shape2d s2d)
-            : Shape({s2d.height(),s2d.width(),1})
+        constexpr Shape3d(const Shape2d& s2d)
+            : Shape<3>(std::array<SizeType, 3>{{s2d.height(), s2d.width(), 1}})
         {}
 
-        Shape3d(SizeType h, SizeType w=1, SizeType c=1)
-            : Shape({h,w,c})
+        constexpr Shape3d(SizeType h, SizeType w=1, SizeType c=1)
+            : Shape<3>(std::array<SizeType, 3>{{h, w, c}})
         {}
 
-        [[nodiscard]] const SizeType& height() const
+        [[nodiscard]] constexpr const SizeType& height() const
         { return _shape[HEIGHT_IDX]; }
-        [[nodiscard]]       SizeType& height()
+        [[nodiscard]]           SizeType& height()
         { return _shape[HEIGHT_IDX]; }
 
-        [[nodiscard]] const SizeType& width() const
+        [[nodiscard]] constexpr const SizeType& width() const
         { return _shape[WIDTH_IDX]; }
-        [[nodiscard]]       SizeType& width()
+        [[nodiscard]]           SizeType& width()
         { return _shape[WIDTH_IDX]; }
 
-        [[nodiscard]] const SizeType& channels() const
+        [[nodiscard]] constexpr const SizeType& channels() const
         { return _shape[CHANNEL_IDX]; }
-        [[nodiscard]]       SizeType& channels()
+        [[nodiscard]]           SizeType& channels()
         { return _shape[CHANNEL_IDX]; }
     };
 
@@ -166,6 +183,8 @@ public:
      * \param p         The padding of the source matrix to include defined in
      *                  2d: the width is the amount padding introduced in right
      *                  and left side, the height in up and down side.
+     * \param num_threads The number of OpenMP threads: rows of the destination
+     *                  are split in bands, 0 means the OpenMP default.
      * \return The pointer to the destination matrix.
      *
      * The destination matrix will be of shape:
@@ -175,10 +194,10 @@ public:
     template <typename T>
     static T* cross_correlation(
         T* dst, const T* src, Shape2d src_shape, const T* k, Shape2d k_shape,
-        Shape2d s = {1, 1}, Shape2d p = {0, 0})
+        Shape2d s = {1, 1}, Shape2d p = {0, 0}, SizeType num_threads = 1)
     {
         return cross_correlation<T>(
-            dst, src, Shape3d(src_shape), k, k_shape, s, p);
+            dst, src, Shape3d(src_shape), k, k_shape, s, p, num_threads);
     }
 
     /**
@@ -198,6 +217,8 @@ public:
      * \param p         The padding of the source matrix to include defined in
      *                  2d: the width is the amount padding introduced in right
      *                  and left side, the height in up and down side.
+     * \param num_threads The number of OpenMP threads: rows of the destination
+     *                  are split in bands, 0 means the OpenMP default.
      * \return The pointer to the destination matrix.
      *
      * The destination matrix will be of shape:
@@ -207,10 +228,10 @@ public:
     template <typename T>
     static T* squared_diff(
         T* dst, const T* src, Shape2d src_shape, const T* k, Shape2d k_shape,
-        Shape2d s = {1, 1}, Shape2d p = {0, 0})
+        Shape2d s = {1, 1}, Shape2d p = {0, 0}, SizeType num_threads = 1)
     {
         return squared_diff<T>(
-            dst, src, Shape3d(src_shape), k, k_shape, s, p);
+            dst, src, Shape3d(src_shape), k, k_shape, s, p, num_threads);
     }
 
     /**
@@ -230,6 +251,8 @@ public:
      * \param p         The padding of the source matrix to include defined in
      *                  2d: the width is the amount padding introduced in right
      *                  and left side, the height in up and down side.
+     * \param num_threads The number of OpenMP threads: rows of the destination
+     *                  are split in bands, 0 means the OpenMP default.
      * \return The pointer to the destination matrix.
      *
      * The destination matrix will be of shape:
@@ -239,10 +262,10 @@ public:
     template <typename T>
     static T* absolute_diff(
         T* dst, const T* src, Shape2d src_shape, const T* k, Shape2d k_shape,
-        Shape2d s = {1, 1}, Shape2d p = {0, 0})
+        Shape2d s = {1, 1}, Shape2d p = {0, 0}, SizeType num_threads = 1)
     {
         return absolute_diff<T>(
-            dst, src, Shape3d(src_shape), k, k_shape, s, p);
+            dst, src, Shape3d(src_shape), k, k_shape, s, p, num_threads);
     }
 
     /**
@@ -262,6 +285,8 @@ public:
      * \param p         The padding of the source matrix to include defined in
      *                  2d: the width is the amount padding introduced in right
      *                  and left side, the height in up and down side.
+     * \param num_threads The number of OpenMP threads: rows of the destination
+     *                  are split in bands, 0 means the OpenMP default.
      * \return The pointer to the destination matrix.
      *
      * The destination matrix will be of shape:
@@ -271,10 +296,10 @@ public:
     template <typename T>
     static T* cross_correlation(
         T* dst, const T* src, Shape3d src_shape, const T* k, Shape2d k_shape,
-        Shape2d s = {1, 1}, Shape2d p = {0, 0})
+        Shape2d s = {1, 1}, Shape2d p = {0, 0}, SizeType num_threads = 1)
     {
-        return kernel_slide<T>(
-            _cross_correlation_op<T>, dst, src, src_shape, 
+        return kernel_slide_parallel<T>(
+            num_threads, CrossCorrelationOp(), dst, src, src_shape, 
             k, k_shape, k_shape, {0, 0}, s, p);
     }
 
@@ -296,6 +321,8 @@ public:
      * \param p         The padding of the source matrix to include defined in
      *                  2d: the width is the amount padding introduced in right
      *                  and left side, the height in up and down side.
+     * \param num_threads The number of OpenMP threads: rows of the destination
+     *                  are split in bands, 0 means the OpenMP default.
      * \return The pointer to the destination matrix.
      *
      * The destination matrix will be of shape:
@@ -305,10 +332,10 @@ public:
     template <typename T>
     static T* squared_diff(
         T* dst, const T* src, Shape3d src_shape, const T* k, Shape2d k_shape,
-        Shape2d s = {1, 1}, Shape2d p = {0, 0})
+        Shape2d s = {1, 1}, Shape2d p = {0, 0}, SizeType num_threads = 1)
     {
-        return kernel_slide<T>(
-            _squared_diff_op<T>, dst, src, src_shape, 
+        return kernel_slide_parallel<T>(
+            num_threads, SquaredDiffOp(), dst, src, src_shape, 
             k, k_shape, k_shape, {0, 0}, 
             s, p);
     }
@@ -331,6 +358,8 @@ public:
      * \param p         The padding of the source matrix to include defined in
      *                  2d: the width is the amount padding introduced in right
      *                  and left side, the height in up and down side.
+     * \param num_threads The number of OpenMP threads: rows of the destination
+     *                  are split in bands, 0 means the OpenMP default.
      * \return The pointer to the destination matrix.
      *
      * The destination matrix will be of shape:
@@ -340,10 +369,10 @@ public:
     template <typename T>
     static T* absolute_diff(
         T* dst, const T* src, Shape3d src_shape, const T* k, Shape2d k_shape,
-        Shape2d s = {1, 1}, Shape2d p = {0, 0})
+        Shape2d s = {1, 1}, Shape2d p = {0, 0}, SizeType num_threads = 1)
     {
-        return kernel_slide<T>(
-            _absolute_diff_op<T>, dst, src, src_shape, 
+        return kernel_slide_parallel<T>(
+            num_threads, AbsoluteDiffOp(), dst, src, src_shape, 
             k, k_shape, k_shape, {0, 0}, 
             s, p);
     }
@@ -371,6 +400,8 @@ public:
      * \param p          The padding of the source matrix to include defined in
      *                   2d: the width is the amount padding introduced in right
      *                   and left side, the height in up and down side.
+     * \param num_threads The number of OpenMP threads: rows of the destination
+     *                  are split in bands, 0 means the OpenMP default.
      * \return The pointer to the destination matrix.
      *
      * The destination matrix will be of shape:
@@ -383,11 +414,11 @@ public:
         const T* src1, Shape2d src1_shape, 
         const T* src2, Shape2d src2_shape, 
         Shape2d k_shape, Shape2d k_offset,
-        Shape2d s = {1, 1}, Shape2d p = {0, 0})
+        Shape2d s = {1, 1}, Shape2d p = {0, 0}, SizeType num_threads = 1)
     {
         return cross_correlation_offset<T>(
             dst, src1, Shape3d(src1_shape), src2, src2_shape, 
-            k_shape, k_offset, s, p);
+            k_shape, k_offset, s, p, num_threads);
     }
 
     /**
@@ -414,6 +445,8 @@ public:
      * \param p          The padding of the source matrix to include defined in
      *                   2d: the width is the amount padding introduced in right
      *                   and left side, the height in up and down side.
+     * \param num_threads The number of OpenMP threads: rows of the destination
+     *                  are split in bands, 0 means the OpenMP default.
      * \return The pointer to the destination matrix.
      *
      * The destination matrix will be of shape:
@@ -426,11 +459,11 @@ public:
         const T* src1, Shape2d src1_shape, 
         const T* src2, Shape2d src2_shape, 
         Shape2d k_shape, Shape2d k_offset,
-        Shape2d s = {1, 1}, Shape2d p = {0, 0})
+        Shape2d s = {1, 1}, Shape2d p = {0, 0}, SizeType num_threads = 1)
     {
         return squared_diff_offset<T>(
             dst, src1, Shape3d(src1_shape), src2, src2_shape, 
-            k_shape, k_offset, s, p);
+            k_shape, k_offset, s, p, num_threads);
     }
 
     /**
@@ -457,6 +490,8 @@ public:
      * \param p          The padding of the source matrix to include defined in
      *                   2d: the width is the amount padding introduced in right
      *                   and left side, the height in up and down side.
+     * \param num_threads The number of OpenMP threads: rows of the destination
+     *                  are split in bands, 0 means the OpenMP default.
      * \return The pointer to the destination matrix.
      *
      * The destination matrix will be of shape:
@@ -469,11 +504,11 @@ public:
         const T* src1, Shape2d src1_shape, 
         const T* src2, Shape2d src2_shape, 
         Shape2d k_shape, Shape2d k_offset,
-        Shape2d s = {1, 1}, Shape2d p = {0, 0})
+        Shape2d s = {1, 1}, Shape2d p = {0, 0}, SizeType num_threads = 1)
     {
         return absolute_diff_offset<T>(
             dst, src1, Shape3d(src1_shape), src2, src2_shape, 
-            k_shape, k_offset, s, p);
+            k_shape, k_offset, s, p, num_threads);
     }
     
     /**
@@ -499,6 +534,8 @@ public:
      * \param p          The padding of the source matrix to include defined in
      *                   2d: the width is the amount padding introduced in right
      *                   and left side, the height in up and down side.
+     * \param num_threads The number of OpenMP threads: rows of the destination
+     *                  are split in bands, 0 means the OpenMP default.
      * \return The pointer to the destination matrix.
      *
      * The destination matrix will be of shape:
@@ -511,11 +548,11 @@ public:
         const T* src1, Shape3d src1_shape, 
         const T* src2, Shape2d src2_shape, 
         Shape2d k_shape, Shape2d k_offset,
-        Shape2d s = {1, 1}, Shape2d p = {0, 0})
+        Shape2d s = {1, 1}, Shape2d p = {0, 0}, SizeType num_threads = 1)
     {
-        return kernel_slide<T>(
-            _cross_correlation_op<T>, dst, src1, src1_shape, src2, src2_shape, 
-            k_shape, k_offset, s, p);
+        return kernel_slide_parallel<T>(
+            num_threads, CrossCorrelationOp(), dst, src1, src1_shape, 
+            src2, src2_shape, k_shape, k_offset, s, p);
     }
 
      /**
@@ -542,6 +579,8 @@ public:
      * \param p          The padding of the source matrix to include defined in
      *                   2d: the width is the amount padding introduced in right
      *                   and left side, the height in up and down side.
+     * \param num_threads The number of OpenMP threads: rows of the destination
+     *                  are split in bands, 0 means the OpenMP default.
      * \return The pointer to the destination matrix.
      *
      * The destination matrix will be of shape:
@@ -554,11 +593,11 @@ public:
         const T* src1, Shape3d src1_shape, 
         const T* src2, Shape2d src2_shape, 
         Shape2d k_shape, Shape2d k_offset,
-        Shape2d s = {1, 1}, Shape2d p = {0, 0})
+        Shape2d s = {1, 1}, Shape2d p = {0, 0}, SizeType num_threads = 1)
     {
-        return kernel_slide<T>(
-            _squared_diff_op<T>, dst, src1, src1_shape, src2, src2_shape, 
-            k_shape, k_offset, s, p);
+        return kernel_slide_parallel<T>(
+            num_threads, SquaredDiffOp(), dst, src1, src1_shape, 
+            src2, src2_shape, k_shape, k_offset, s, p);
     }
 
     /**
@@ -585,6 +624,8 @@ public:
      * \param p          The padding of the source matrix to include defined in
      *                   2d: the width is the amount padding introduced in right
      *                   and left side, the height in up and down side.
+     * \param num_threads The number of OpenMP threads: rows of the destination
+     *                  are split in bands, 0 means the OpenMP default.
      * \return The pointer to the destination matrix.
      *
      * The destination matrix will be of shape:
@@ -597,16 +638,118 @@ public:
         const T* src1, Shape3d src1_shape, 
         const T* src2, Shape2d src2_shape, 
         Shape2d k_shape, Shape2d k_offset,
-        Shape2d s = {1, 1}, Shape2d p = {0, 0})
+        Shape2d s = {1, 1}, Shape2d p = {0, 0}, SizeType num_threads = 1)
     {
-        return kernel_slide<T>(
-            _absolute_diff_op<T>, dst, src1, src1_shape, src2, src2_shape, 
-            k_shape, k_offset, s, p);
+        return kernel_slide_parallel<T>(
+            num_threads, AbsoluteDiffOp(), dst, src1, src1_shape, 
+            src2, src2_shape, k_shape, k_offset, s, p);
     }
 
+    /**
+     * \brief Operation of cross_correlation as a stateless functor, so that
+     * kernel_slide can inline it in the slide loop.
+     *
+     * The functors also provide interior(), used by kernel_slide for the run
+     * of destination columns whose kernel lies entirely inside the source:
+     * it computes the same values without padding checks (see _interior_op).
+     */
+    struct CrossCorrelationOp {
+        template <typename T>
+        void operator()(
+            T* dst, const Shape2d& dst_shape, Coord2d dst_coord,
+            const T* src, const Shape3d& src_shape,
+            const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+            const Shape2d& k_offset, int64_t row, int64_t col) const
+        {
+            _cross_correlation_op<T>(dst, dst_shape, dst_coord, src, src_shape,
+                                     k, k_real_shape, k_shape, k_offset,
+                                     row, col);
+        }
+
+        template <typename T>
+        static void interior(
+            T* dst, const Shape2d& dst_shape, SizeType row_dst,
+            SizeType col_begin, SizeType col_end,
+            const T* src, const Shape3d& src_shape,
+            const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+            const Shape2d& k_offset, const Shape2d& s, int64_t row, int64_t col)
+        {
+            _interior_op<T>([](T src_val, T k_val) { return src_val * k_val; },
+                            dst, dst_shape, row_dst, col_begin, col_end,
+                            src, src_shape, k, k_real_shape, k_shape,
+                            k_offset, s, row, col);
+        }
+    };
+
+    /// Operation of squared_diff as a stateless functor.
+    struct SquaredDiffOp {
+        template <typename T>
+        void operator()(
+            T* dst, const Shape2d& dst_shape, Coord2d dst_coord,
+            const T* src, const Shape3d& src_shape,
+            const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+            const Shape2d& k_offset, int64_t row, int64_t col) const
+        {
+            _squared_diff_op<T>(dst, dst_shape, dst_coord, src, src_shape,
+                                k, k_real_shape, k_shape, k_offset, row, col);
+        }
+
+        template <typename T>
+        static void interior(
+            T* dst, const Shape2d& dst_shape, SizeType row_dst,
+            SizeType col_begin, SizeType col_end,
+            const T* src, const Shape3d& src_shape,
+            const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+            const Shape2d& k_offset, const Shape2d& s, int64_t row, int64_t col)
+        {
+            _interior_op<T>([](T src_val, T k_val) {
+                                auto diff = src_val - k_val;
+                                return diff * diff; //< squared.
+                            },
+                            dst, dst_shape, row_dst, col_begin, col_end,
+                            src, src_shape, k, k_real_shape, k_shape,
+                            k_offset, s, row, col);
+        }
+    };
+
+    /// Operation of absolute_diff as a stateless functor.
+    struct AbsoluteDiffOp {
+        template <typename T>
+        void operator()(
+            T* dst, const Shape2d& dst_shape, Coord2d dst_coord,
+            const T* src, const Shape3d& src_shape,
+            const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+            const Shape2d& k_offset, int64_t row, int64_t col) const
+        {
+            _absolute_diff_op<T>(dst, dst_shape, dst_coord, src, src_shape,
+                                 k, k_real_shape, k_shape, k_offset, row, col);
+        }
+
+        template <typename T>
+        static void interior(
+            T* dst, const Shape2d& dst_shape, SizeType row_dst,
+            SizeType col_begin, SizeType col_end,
+            const T* src, const Shape3d& src_shape,
+            const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+            const Shape2d& k_offset, const Shape2d& s, int64_t row, int64_t col)
+        {
+            _interior_op<T>([](T src_val, T k_val) {
+                                auto diff = src_val - k_val;
+                                return diff > 0 ? diff : -diff; //< absolute.
+                            },
+                            dst, dst_shape, row_dst, col_begin, col_end,
+                            src, src_shape, k, k_real_shape, k_shape,
+                            k_offset, s, row, col);
+        }
+    };
+
     /**
      * \brief Kernel slicing on the source matrix.
      * \tparam T        Type of each source and destination elements.
+     * \tparam Op       Type of k_to_src_operation: a functor such as
+     *                  CrossCorrelationOp, called with the arguments of
+     *                  the std::function overload. Being a template
+     *                  parameter it is inlined in the slide loop.
      * \param k_to_src_operation The operation to perform at each overlapping
      * step between the source matrix and the kernel.
      * \param dst       The destination matrix in which put the resulting
@@ -637,6 +780,24 @@ public:
      *  width_dst  = ((width_src  - f + (2 * p)) / s) + 1
      *  height_dst = ((height_src - f + (2 * p)) / s) + 1
      */
+    template <typename T, typename Op>
+    static T* kernel_slide(
+        Op k_to_src_operation,
+        T* dst, const T* src, const Shape3d& src_shape,
+        const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+        const Shape2d& k_offset, Shape2d s = {1, 1}, const Shape2d& p = {0, 0})
+    {
+        const Shape2d dst_shape = _slide_shape(src_shape, k_shape, s, p);
+        _slide_rows<T>(k_to_src_operation, dst, dst_shape,
+                       0, dst_shape.height(), src, src_shape,
+                       k, k_real_shape, k_shape, k_offset, s, p);
+        return dst;
+    }
+
+    /**
+     * \brief Kernel slicing on the source matrix with a type-erased
+     * operation, kept for compatibility: prefer the functor overload.
+     */
     template <typename T>
     static T* kernel_slide(
         std::function<void(T*, Shape2d, Coord2d,
@@ -646,6 +807,171 @@ public:
         T* dst, const T* src, Shape3d src_shape,
         const T* k, Shape2d k_real_shape, Shape2d k_shape, Shape2d k_offset,
         Shape2d s = {1, 1}, Shape2d p = {0, 0})
+    {
+        using Operation = decltype(k_to_src_operation);
+        return kernel_slide<T, const Operation&>(
+            k_to_src_operation, dst, src, src_shape,
+            k, k_real_shape, k_shape, k_offset, s, p);
+    }
+
+    /**
+     * \brief Kernel slicing on the source matrix, with the destination rows
+     * partitioned in contiguous bands, one for each OpenMP thread.
+     *
+     * Each destination element is computed by exactly one thread with the same
+     * operation of kernel_slide, so the result is bit-identical to the
+     * sequential version for any number of threads. Without OpenMP support it
+     * falls back to kernel_slide.
+     * \tparam T        Type of each source and destination elements.
+     * \tparam Op       Type of k_to_src_operation (see kernel_slide).
+     * \param num_threads The number of threads to use: 0 means the OpenMP
+     *                  default.
+     * \param k_to_src_operation The operation to perform at each overlapping
+     * step between the source matrix and the kernel.
+     * \param dst       The destination matrix in which put the resulting
+     *                  matrix.
+     * \param src       The source matrix on which calculate the operation
+     *                  defined in k_to_src_operation.
+     * \param src_shape The shape of the source matrix: height, width, channels.
+     * \param k         The kernel matrix to use for convolution.
+     * \param k_real_shape The shape of the matrix containing the kernel: 
+     *                  height, width.
+     * \param k_shape   The shape of the kernel: height, width.
+     * \param k_offset  The offset in rows and cols to use in k matrix to 
+     *                  take the kernel. 
+     * \param s         The stride amount.
+     * \param p         The padding of the source matrix.
+     * \return The pointer to the destination matrix.
+     */
+    template <typename T, typename Op>
+    static T* kernel_slide_parallel(
+        SizeType num_threads, Op k_to_src_operation,
+        T* dst, const T* src, const Shape3d& src_shape,
+        const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+        const Shape2d& k_offset, Shape2d s = {1, 1}, const Shape2d& p = {0, 0})
+    {
+#ifdef _OPENMP
+        if (num_threads == 1)
+        {
+            return kernel_slide<T>(k_to_src_operation, dst, src, src_shape,
+                                   k, k_real_shape, k_shape, k_offset, s, p);
+        }
+        const Shape2d dst_shape = _slide_shape(src_shape, k_shape, s, p);
+        const SizeType height_dst = dst_shape.height();
+        const int threads = num_threads ? static_cast<int>(num_threads)
+                                        : omp_get_max_threads();
+        #pragma omp parallel num_threads(threads)
+        {
+            const auto bands = static_cast<SizeType>(omp_get_num_threads());
+            const auto band = static_cast<SizeType>(omp_get_thread_num());
+            const SizeType row_begin = (height_dst * band) / bands;
+            const SizeType row_end = (height_dst * (band + 1)) / bands;
+            _slide_rows<T>(k_to_src_operation, dst, dst_shape,
+                           row_begin, row_end, src, src_shape,
+                           k, k_real_shape, k_shape, k_offset, s, p);
+        }
+        return dst;
+#else
+        (void) num_threads;
+        return kernel_slide<T>(k_to_src_operation, dst, src, src_shape,
+                               k, k_real_shape, k_shape, k_offset, s, p);
+#endif
+    }
+
+    /**
+     * \brief kernel_slide_parallel with a type-erased operation, kept for
+     * compatibility: prefer the functor overload.
+     */
+    template <typename T>
+    static T* kernel_slide_parallel(
+        SizeType num_threads,
+        std::function<void(T*, Shape2d, Coord2d,
+                           const T*, Shape3d,
+                           const T*, Shape2d, Shape2d, Shape2d,
+                           int64_t, int64_t)> k_to_src_operation,
+        T* dst, const T* src, Shape3d src_shape,
+        const T* k, Shape2d k_real_shape, Shape2d k_shape, Shape2d k_offset,
+        Shape2d s = {1, 1}, Shape2d p = {0, 0})
+    {
+        using Operation = decltype(k_to_src_operation);
+        return kernel_slide_parallel<T, const Operation&>(
+            num_threads, k_to_src_operation, dst, src, src_shape,
+            k, k_real_shape, k_shape, k_offset, s, p);
+    }
+
+    /**
+     * \brief Kernel slicing on the source matrix, with the destination rows
+     * run as parallel_for chunks of a ThreadPool.
+     *
+     * As kernel_slide_parallel the result is bit-identical to kernel_slide,
+     * but the threads are the persistent ones of pool and rows are balanced
+     * by work stealing rather than fixed bands.
+     * \tparam T        Type of each source and destination elements.
+     * \tparam Op       Type of k_to_src_operation (see kernel_slide).
+     * \param pool      The thread pool running the rows.
+     * \param k_to_src_operation The operation to perform at each overlapping
+     * step between the source matrix and the kernel.
+     * \param dst       The destination matrix in which put the resulting
+     *                  matrix.
+     * \param src       The source matrix on which calculate the operation
+     *                  defined in k_to_src_operation.
+     * \param src_shape The shape of the source matrix: height, width, channels.
+     * \param k         The kernel matrix to use for convolution.
+     * \param k_real_shape The shape of the matrix containing the kernel: 
+     *                  height, width.
+     * \param k_shape   The shape of the kernel: height, width.
+     * \param k_offset  The offset in rows and cols to use in k matrix to 
+     *                  take the kernel. 
+     * \param s         The stride amount.
+     * \param p         The padding of the source matrix.
+     * \return The pointer to the destination matrix.
+     */
+    template <typename T, typename Op>
+    static T* kernel_slide_parallel(
+        ThreadPool& pool, Op k_to_src_operation,
+        T* dst, const T* src, const Shape3d& src_shape,
+        const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+        const Shape2d& k_offset, Shape2d s = {1, 1}, const Shape2d& p = {0, 0})
+    {
+        const Shape2d dst_shape = _slide_shape(src_shape, k_shape, s, p);
+        pool.parallel_for(0, dst_shape.height(), 0,
+                          [&](SizeType row_begin, SizeType row_end)
+        {
+            _slide_rows<T>(k_to_src_operation, dst, dst_shape,
+                           row_begin, row_end, src, src_shape,
+                           k, k_real_shape, k_shape, k_offset, s, p);
+        });
+        return dst;
+    }
+
+    /**
+     * \brief kernel_slide_parallel on a ThreadPool with a type-erased
+     * operation, kept for compatibility: prefer the functor overload.
+     */
+    template <typename T>
+    static T* kernel_slide_parallel(
+        ThreadPool& pool,
+        std::function<void(T*, Shape2d, Coord2d,
+                           const T*, Shape3d,
+                           const T*, Shape2d, Shape2d, Shape2d,
+                           int64_t, int64_t)> k_to_src_operation,
+        T* dst, const T* src, Shape3d src_shape,
+        const T* k, Shape2d k_real_shape, Shape2d k_shape, Shape2d k_offset,
+        Shape2d s = {1, 1}, Shape2d p = {0, 0})
+    {
+        using Operation = decltype(k_to_src_operation);
+        return kernel_slide_parallel<T, const Operation&>(
+            pool, k_to_src_operation, dst, src, src_shape,
+            k, k_real_shape, k_shape, k_offset, s, p);
+    }
+
+private:
+    /**
+     * \brief Shape of the destination matrix of a kernel slide; clamps the
+     * stride s to at least 1.
+     */
+    static Shape2d _slide_shape(const Shape3d& src_shape, const Shape2d& k_shape,
+                                Shape2d& s, const Shape2d& p)
     {
         s.width() = std::max(s.width(), SizeType(1));
         s.height() = std::max(s.height(), SizeType(1));
@@ -653,25 +979,234 @@ public:
             ((src_shape.width() - k_shape.width() + 2 * p.width()) / s.width()) + 1;
         auto height_dst = src_shape.height() == 0 ? 0 :
             ((src_shape.height() - k_shape.height() + 2 * p.height()) / s.height()) + 1;
-        for (SizeType row_dst = 0; row_dst < height_dst; ++row_dst)
+        return {height_dst, width_dst};
+    }
+
+    /**
+     * \brief Range [first, second) of destination indices along one
+     * dimension whose kernel lies entirely inside the source, without
+     * padding.
+     */
+    static std::pair<SizeType, SizeType> _interior_range(
+        SizeType dst_len, SizeType src_len, SizeType k_len,
+        SizeType s, SizeType p)
+    {
+        if (src_len < k_len) return {0, 0};
+        const SizeType begin = std::min((p + s - 1) / s, dst_len);
+        const SizeType end = std::min((src_len - k_len + p) / s + 1, dst_len);
+        return {begin, std::max(begin, end)};
+    }
+
+    /// Whether Op provides the interior() of the Math functors.
+    template <typename Op, typename T, typename = void>
+    struct _has_interior : std::false_type {};
+
+    template <typename Op, typename T>
+    struct _has_interior<Op, T,
+        decltype(void(&Op::template interior<T>))> : std::true_type {};
+
+    /**
+     * \brief Apply k_to_src_operation to the destination rows
+     * [row_begin, row_end), shared by kernel_slide and its parallel versions.
+     */
+    template <typename T, typename Op>
+    static void _slide_rows(
+        Op& k_to_src_operation, T* dst, const Shape2d& dst_shape,
+        SizeType row_begin, SizeType row_end,
+        const T* src, const Shape3d& src_shape,
+        const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+        const Shape2d& k_offset, const Shape2d& s, const Shape2d& p)
+    {
+        _slide_rows<T>(k_to_src_operation, dst, dst_shape, row_begin, row_end,
+                       src, src_shape, k, k_real_shape, k_shape, k_offset,
+                       s, p, _has_interior<typename std::decay<Op>::type, T>());
+    }
+
+    /// _slide_rows for operations without interior(): every element pays
+    /// the padding checks of the operation.
+    template <typename T, typename Op>
+    static void _slide_rows(
+        Op& k_to_src_operation, T* dst, const Shape2d& dst_shape,
+        SizeType row_begin, SizeType row_end,
+        const T* src, const Shape3d& src_shape,
+        const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+        const Shape2d& k_offset, const Shape2d& s, const Shape2d& p,
+        std::false_type)
+    {
+        for (SizeType row_dst = row_begin; row_dst < row_end; ++row_dst)
+        {
+            _slide_cols<T>(k_to_src_operation, dst, dst_shape, row_dst,
+                           0, dst_shape.width(), src, src_shape,
+                           k, k_real_shape, k_shape, k_offset, s, p);
+        }
+    }
+
+    /**
+     * \brief _slide_rows for the Math functors: the destination is split
+     * in an interior region, where the kernel lies inside the source and
+     * interior() runs branch-free row loops, and the border around it,
+     * where the operation handles the zero-padding.
+     */
+    template <typename T, typename Op>
+    static void _slide_rows(
+        Op& k_to_src_operation, T* dst, const Shape2d& dst_shape,
+        SizeType row_begin, SizeType row_end,
+        const T* src, const Shape3d& src_shape,
+        const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+        const Shape2d& k_offset, const Shape2d& s, const Shape2d& p,
+        std::true_type)
+    {
+        using Operation = typename std::decay<Op>::type;
+        const SizeType width_dst = dst_shape.width();
+        const auto rows = _interior_range(dst_shape.height(), src_shape.height(),
+                                          k_shape.height(), s.height(), p.height());
+        const auto cols = _interior_range(width_dst, src_shape.width(),
+                                          k_shape.width(), s.width(), p.width());
+        for (SizeType row_dst = row_begin; row_dst < row_end; ++row_dst)
         {
-            for (SizeType col_dst = 0; col_dst < width_dst; ++col_dst)
+            if (row_dst < rows.first || row_dst >= rows.second)
             {
-                auto col = (static_cast<int64_t>(col_dst * s.width())
-                    - static_cast<int64_t>(p.width()))
-                    * static_cast<int64_t>(src_shape.channels());
-                auto row = static_cast<int64_t>(row_dst * s.height())
-                    - static_cast<int64_t>(p.height());
-                k_to_src_operation(
-                    dst, {height_dst, width_dst}, {row_dst, col_dst},
-                    src, src_shape, k, k_real_shape, k_shape, k_offset, 
-                    row, col);
+                _slide_cols<T>(k_to_src_operation, dst, dst_shape, row_dst,
+                               0, width_dst, src, src_shape,
+                               k, k_real_shape, k_shape, k_offset, s, p);
+                continue;
             }
+            auto row = static_cast<int64_t>(row_dst * s.height())
+                - static_cast<int64_t>(p.height());
+            _slide_cols<T>(k_to_src_operation, dst, dst_shape, row_dst,
+                           0, cols.first, src, src_shape,
+                           k, k_real_shape, k_shape, k_offset, s, p);
+            auto col = (static_cast<int64_t>(cols.first * s.width())
+                - static_cast<int64_t>(p.width()))
+                * static_cast<int64_t>(src_shape.channels());
+            Operation::template interior<T>(
+                dst, dst_shape, row_dst, cols.first, cols.second,
+                src, src_shape, k, k_real_shape, k_shape, k_offset, s,
+                row, col);
+            _slide_cols<T>(k_to_src_operation, dst, dst_shape, row_dst,
+                           cols.second, width_dst, src, src_shape,
+                           k, k_real_shape, k_shape, k_offset, s, p);
+        }
+    }
+
+    /// Apply k_to_src_operation to the columns [col_begin, col_end) of the
+    /// destination row row_dst.
+    template <typename T, typename Op>
+    static void _slide_cols(
+        Op& k_to_src_operation, T* dst, const Shape2d& dst_shape,
+        SizeType row_dst, SizeType col_begin, SizeType col_end,
+        const T* src, const Shape3d& src_shape,
+        const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+        const Shape2d& k_offset, const Shape2d& s, const Shape2d& p)
+    {
+        auto row = static_cast<int64_t>(row_dst * s.height())
+            - static_cast<int64_t>(p.height());
+        for (SizeType col_dst = col_begin; col_dst < col_end; ++col_dst)
+        {
+            auto col = (static_cast<int64_t>(col_dst * s.width())
+                - static_cast<int64_t>(p.width()))
+                * static_cast<int64_t>(src_shape.channels());
+            k_to_src_operation(
+                dst, dst_shape, {row_dst, col_dst},
+                src, src_shape, k, k_real_shape, k_shape, k_offset, 
+                row, col);
+        }
+    }
+
+    /**
+     * \brief Operation of the interior of a kernel slide on the destination
+     * columns [col_begin, col_end) of row row_dst: the kernel lies entirely
+     * inside the source, so each kernel row is a contiguous run of the
+     * source and no tap needs a padding check or an index division.
+     *
+     * Columns are processed in blocks of 32, each tap updating the sums of
+     * the whole block: the innermost loop runs across destination columns,
+     * contiguous in the source for stride 1, so it vectorizes even for
+     * floating point types. Each sum still accumulates its taps in the order
+     * of the bounds-checked operations, so the result is bit-identical to
+     * them.
+     * \tparam T        Type of each source and destination elements.
+     * \tparam Tap      Type of tap, returning the term of a pair of source
+     *                  and kernel elements.
+     * \param row       The first source row, inside the source.
+     * \param col       The first source element of the row for col_begin,
+     *                  inside the row.
+     */
+    template <typename T, typename Tap>
+    static void _interior_op(
+        Tap tap, T* dst, const Shape2d& dst_shape, SizeType row_dst,
+        SizeType col_begin, SizeType col_end,
+        const T* src, const Shape3d& src_shape,
+        const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+        const Shape2d& k_offset, const Shape2d& s, int64_t row, int64_t col)
+    {
+        const SizeType k_step = k_shape.width() * src_shape.channels();
+        const SizeType k_real_step = k_real_shape.width() * src_shape.channels();
+        const SizeType src_step = src_shape.width() * src_shape.channels();
+        const SizeType col_step = s.width() * src_shape.channels();
+        constexpr SizeType block_size = 32;
+        k += k_offset.height() * k_real_step 
+            + k_offset.width() * src_shape.channels();
+        src += static_cast<SizeType>(row) * src_step + static_cast<SizeType>(col);
+        dst += row_dst * dst_shape.width();
+
+        for (SizeType block = col_begin; block < col_end; block += block_size)
+        {
+            const SizeType count = std::min(block_size, col_end - block);
+            T sum[block_size] = {};
+            if (col_step == 1 && count == block_size)
+            {
+                _interior_block<T, block_size, 1>(tap, sum, src + (block - col_begin),
+                                                  k, k_shape.height(), k_step,
+                                                  src_step, k_real_step);
+            }
+            else
+            {
+                for (SizeType c = 0; c < count; ++c)
+                {
+                    _interior_block<T, 1, 1>(tap, sum + c,
+                                             src + (block - col_begin + c) * col_step,
+                                             k, k_shape.height(), k_step,
+                                             src_step, k_real_step);
+                }
+            }
+            std::copy(sum, sum + count, dst + block);
         }
-        return dst;
     }
 
-private:
+    /**
+     * \brief Accumulate in sum[0, N) the taps of N destination columns whose
+     * kernels start Step source elements apart, one tap of all the columns
+     * at a time.
+     */
+    template <typename T, SizeType N, SizeType Step, typename Tap>
+    static void _interior_block(
+        Tap tap, T* sum, const T* src, const T* k,
+        SizeType k_height, SizeType k_step,
+        SizeType src_step, SizeType k_real_step)
+    {
+        T acc[N];
+        std::copy(sum, sum + N, acc);
+        for (SizeType row_k = 0; row_k < k_height; ++row_k)
+        {
+            for (SizeType col_k = 0; col_k < k_step; ++col_k)
+            {
+                const T k_val = k[col_k];
+#ifdef _OPENMP
+                // Vectorize across the columns, not the taps of a sum.
+                #pragma omp simd
+#endif
+                for (SizeType c = 0; c < N; ++c)
+                {
+                    acc[c] += tap(src[c * Step + col_k], k_val);
+                }
+            }
+            src += src_step;
+            k += k_real_step;
+        }
+        std::copy(acc, acc + N, sum);
+    }
+
     /**
      * \brief Sum of multiplication between the kernel and the source matrix
      * for Convolution 3D.
@@ -695,10 +1230,10 @@ private:
      */
     template <typename T>
     static void _cross_correlation_op(
-        T* dst, Shape2d dst_shape, Coord2d dst_coord,
-        const T* src, Shape3d src_shape,
-        const T* k, Shape2d k_real_shape, Shape2d k_shape, Shape2d k_offset,
-        int64_t row, int64_t col)
+        T* dst, const Shape2d& dst_shape, Coord2d dst_coord,
+        const T* src, const Shape3d& src_shape,
+        const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+        const Shape2d& k_offset, int64_t row, int64_t col)
     {
         auto k_size = k_shape.size() * src_shape.channels();
         auto k_step = k_shape.width() * src_shape.channels();
@@ -748,10 +1283,10 @@ private:
      */
     template <typename T>
     static void _squared_diff_op(
-        T* dst, Shape2d dst_shape, Coord2d dst_coord,
-        const T* src, Shape3d src_shape,
-        const T* k, Shape2d k_real_shape, Shape2d k_shape, Shape2d k_offset,
-        int64_t row, int64_t col)
+        T* dst, const Shape2d& dst_shape, Coord2d dst_coord,
+        const T* src, const Shape3d& src_shape,
+        const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+        const Shape2d& k_offset, int64_t row, int64_t col)
     {
         auto k_size = k_shape.size() * src_shape.channels();
         auto k_step = k_shape.width() * src_shape.channels();
@@ -807,10 +1342,10 @@ private:
      */
     template <typename T>
     static void _absolute_diff_op(
-        T* dst, Shape2d dst_shape, Coord2d dst_coord,
-        const T* src, Shape3d src_shape,
-        const T* k, Shape2d k_real_shape, Shape2d k_shape, Shape2d k_offset,
-        int64_t row, int64_t col)
+        T* dst, const Shape2d& dst_shape, Coord2d dst_coord,
+        const T* src, const Shape3d& src_shape,
+        const T* k, const Shape2d& k_real_shape, const Shape2d& k_shape,
+        const Shape2d& k_offset, int64_t row, int64_t col)
     {
         auto k_size = k_shape.size() * src_shape.channels();
         auto k_step = k_shape.width() * src_shape.channels();
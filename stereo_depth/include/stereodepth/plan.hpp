@@ -0,0 +1,416 @@
+/***************************************************************************
+ *            plan.hpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+
+/*! \file  plan.hpp
+ *  \brief Matcher configuration validated once and executed per frame.
+ */
+
+#include "type.hpp"
+#include "cross_correlation.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+
+#ifndef STEREODEPTH_PLAN_HPP
+#define STEREODEPTH_PLAN_HPP
+
+namespace stereodepth {
+
+/// Result of the validation of a plan and of its execution.
+enum class PlanStatus {
+    OK,                      ///< Valid plan, frame matched.
+    INVALID_KERNEL_SIZE,     ///< Kernel size even or smaller than KERNEL_LIMIT.
+    INVALID_SHAPE,           ///< Width or height smaller than the kernel size.
+    INVALID_DISPARITY_RANGE, ///< min_disparity greater than max_disparity.
+    INVALID_PLAN,            ///< execute() called on a plan that is not valid.
+    NULL_POINTER,            ///< execute() called with a null matrix.
+    INVALID_ROWS,            ///< Row range outside the destination matrix.
+    INVALID_TILE,            ///< Tile outside the destination matrix.
+    INVALID_QUERY            ///< Query outside the destination matrix.
+};
+
+/**
+ * \brief Human readable description of a status.
+ * \param status The status.
+ * \return A static string.
+ */
+inline const char* plan_status_string(PlanStatus status)
+{
+    switch (status)
+    {
+    case PlanStatus::OK: return "ok";
+    case PlanStatus::INVALID_KERNEL_SIZE: return "kernel size must be odd and >= 3";
+    case PlanStatus::INVALID_SHAPE: return "width and height must be >= kernel size";
+    case PlanStatus::INVALID_DISPARITY_RANGE: return "min disparity must be <= max disparity";
+    case PlanStatus::INVALID_PLAN: return "plan is not valid";
+    case PlanStatus::NULL_POINTER: return "null matrix";
+    case PlanStatus::INVALID_ROWS: return "row range outside the destination";
+    case PlanStatus::INVALID_TILE: return "tile outside the destination";
+    case PlanStatus::INVALID_QUERY: return "query outside the destination";
+    }
+    return "unknown status";
+}
+
+/**
+ * \brief Cross-correlation matcher whose shape, kernel size and disparity
+ * range are checked once, at construction.
+ *
+ * Unlike the argMaxCorrMat family, which re-runs inputParsing on every row
+ * or pixel and calls exit() on bad input, a plan reports the problem with
+ * status() and execute() returns a PlanStatus: a service with a bad
+ * configuration keeps running. The row kernel (a compile-time kernel size
+ * specialization when available) is selected at construction too, so
+ * execute() only checks the three pointers per frame and then matches
+ * without any per-pixel validation. The output is identical to
+ * argMaxCorrMat.
+ * \tparam T      Type of the source matrices.
+ * \tparam Traits Accumulator and destination types (see MatchingTraits).
+ */
+template <typename T, typename Traits = MatchingTraits<T>>
+class StereoMatcherPlan
+{
+public:
+    using output_type = typename Traits::output_type;
+
+    /**
+     * \param width         Width of the source matrices.
+     * \param height        Height of the source matrices.
+     * \param kernel_size   Size of the matching window.
+     * \param min_disparity Minimum disparity searched.
+     * \param max_disparity Maximum disparity searched.
+     */
+    StereoMatcherPlan(SizeType width, SizeType height, SizeType kernel_size,
+                      std::int64_t min_disparity = DISPARITY_MIN_UNBOUNDED,
+                      std::int64_t max_disparity = DISPARITY_MAX_UNBOUNDED)
+        : _width{width}
+        , _height{height}
+        , _kernel_size{kernel_size}
+        , _min_disparity{min_disparity}
+        , _max_disparity{max_disparity}
+        , _status{validate(width, height, kernel_size, min_disparity, max_disparity)}
+        , _row_kernel{select_row_kernel(kernel_size)}
+    {}
+
+    PlanStatus status() const { return _status; }
+    bool valid() const { return _status == PlanStatus::OK; }
+
+    SizeType width() const { return _width; }
+    SizeType height() const { return _height; }
+    SizeType kernel_size() const { return _kernel_size; }
+    SizeType output_width() const { return _width - (_kernel_size - 1); }
+    SizeType output_height() const { return _height - (_kernel_size - 1); }
+    std::int64_t min_disparity() const { return _min_disparity; }
+    std::int64_t max_disparity() const { return _max_disparity; }
+
+    /**
+     * \brief Match a frame.
+     * \param src1 First source matrix, height x width.
+     * \param src2 Second source matrix, height x width.
+     * \param dst  Destination matrix, output_height() x output_width().
+     * \param confidence       Optional confidence matrix of the size of dst
+     *                         (see PeakTracker).
+     * \param uniqueness_ratio Uniqueness ratio of the confidence, 0 disables
+     *                         the test.
+     * \return OK, INVALID_PLAN or NULL_POINTER; dst is untouched on error.
+     */
+    PlanStatus execute(const T* src1, const T* src2, output_type* dst,
+                       std::uint8_t* confidence = nullptr,
+                       int uniqueness_ratio = 0) const
+    {
+        return execute_rows(src1, src2, dst, 0, valid() ? output_height() : 0,
+                            confidence, uniqueness_ratio);
+    }
+
+    /**
+     * \brief Match a frame, bands of rows in parallel on pool.
+     * \param src1 First source matrix, height x width.
+     * \param src2 Second source matrix, height x width.
+     * \param dst  Destination matrix, output_height() x output_width().
+     * \param pool Thread pool running the bands.
+     * \param confidence       Optional confidence matrix, as execute.
+     * \param uniqueness_ratio Uniqueness ratio of the confidence.
+     * \return OK, INVALID_PLAN or NULL_POINTER; dst is untouched on error.
+     */
+    PlanStatus execute(const T* src1, const T* src2, output_type* dst,
+                       ThreadPool& pool, std::uint8_t* confidence = nullptr,
+                       int uniqueness_ratio = 0) const
+    {
+        if (!valid()) return PlanStatus::INVALID_PLAN;
+        if (!src1 || !src2 || !dst) return PlanStatus::NULL_POINTER;
+        pool.parallel_for(0, output_height(), 0,
+                          [&](SizeType row_begin, SizeType row_end) {
+            run(src1, src2, dst, row_begin, row_end, 0, output_width(),
+                confidence, uniqueness_ratio);
+        });
+        return PlanStatus::OK;
+    }
+
+    /**
+     * \brief Match count pairs of the plan shape, in parallel on pool.
+     *
+     * The rows of all the pairs form a single range of count x
+     * output_height() rows handed to parallel_for, so threads move on to
+     * the next pair instead of waiting at the end of each one, and pairs in
+     * different phases (memory-bound row fetches, compute-bound windows)
+     * run side by side. No scratch memory is allocated per pair.
+     * \param src1  count pointers to the first source matrices.
+     * \param src2  count pointers to the second source matrices.
+     * \param dst   count pointers to the destination matrices.
+     * \param count Number of pairs.
+     * \param pool  Thread pool running the rows.
+     * \return OK, INVALID_PLAN or NULL_POINTER; no destination is touched
+     *         on error.
+     */
+    PlanStatus execute_batch(const T* const* src1, const T* const* src2,
+                             output_type* const* dst, SizeType count,
+                             ThreadPool& pool = ThreadPool::global()) const
+    {
+        if (!valid()) return PlanStatus::INVALID_PLAN;
+        if (count == 0) return PlanStatus::OK;
+        if (!src1 || !src2 || !dst) return PlanStatus::NULL_POINTER;
+        for (SizeType i = 0; i < count; ++i)
+        {
+            if (!src1[i] || !src2[i] || !dst[i]) return PlanStatus::NULL_POINTER;
+        }
+
+        const SizeType rows = output_height();
+        pool.parallel_for(0, count * rows, 0, [&](SizeType begin, SizeType end) {
+            // A chunk may span the end of a pair and the start of the next.
+            while (begin < end)
+            {
+                const SizeType pair = begin / rows;
+                const SizeType row = begin % rows;
+                const SizeType last = std::min(rows, row + (end - begin));
+                run(src1[pair], src2[pair], dst[pair], row, last, 0, output_width());
+                begin += last - row;
+            }
+        });
+        return PlanStatus::OK;
+    }
+
+    /**
+     * \brief Match the destination rows [row_begin, row_end) of a frame.
+     *
+     * Rows are independent, so disjoint ranges can run concurrently.
+     * \param src1      First source matrix, height x width.
+     * \param src2      Second source matrix, height x width.
+     * \param dst       Destination matrix, output_height() x output_width().
+     * \param row_begin First destination row.
+     * \param row_end   Destination row after the last one.
+     * \param confidence       Optional confidence matrix, as execute.
+     * \param uniqueness_ratio Uniqueness ratio of the confidence.
+     * \return OK, INVALID_PLAN, NULL_POINTER or INVALID_ROWS; dst is
+     *         untouched on error.
+     */
+    PlanStatus execute_rows(const T* src1, const T* src2, output_type* dst,
+                            SizeType row_begin, SizeType row_end,
+                            std::uint8_t* confidence = nullptr,
+                            int uniqueness_ratio = 0) const
+    {
+        if (!valid()) return PlanStatus::INVALID_PLAN;
+        if (!src1 || !src2 || !dst) return PlanStatus::NULL_POINTER;
+        if (row_begin > row_end || row_end > output_height())
+        {
+            return PlanStatus::INVALID_ROWS;
+        }
+        run(src1, src2, dst, row_begin, row_end, 0, output_width(),
+            confidence, uniqueness_ratio);
+        return PlanStatus::OK;
+    }
+
+    /**
+     * \brief Match the destination pixels of rows [row_begin, row_end) and
+     * columns [col_begin, col_end) of a frame.
+     *
+     * The sources are read only inside the tile plus its kernel and
+     * disparity halo. Disjoint tiles can run concurrently.
+     * \param src1      First source matrix, height x width.
+     * \param src2      Second source matrix, height x width.
+     * \param dst       Destination matrix, output_height() x output_width().
+     * \param row_begin First destination row.
+     * \param row_end   Destination row after the last one.
+     * \param col_begin First destination column.
+     * \param col_end   Destination column after the last one.
+     * \param confidence       Optional confidence matrix, as execute.
+     * \param uniqueness_ratio Uniqueness ratio of the confidence.
+     * \return OK, INVALID_PLAN, NULL_POINTER or INVALID_TILE; dst is
+     *         untouched on error.
+     */
+    PlanStatus execute_tile(const T* src1, const T* src2, output_type* dst,
+                            SizeType row_begin, SizeType row_end,
+                            SizeType col_begin, SizeType col_end,
+                            std::uint8_t* confidence = nullptr,
+                            int uniqueness_ratio = 0) const
+    {
+        if (!valid()) return PlanStatus::INVALID_PLAN;
+        if (!src1 || !src2 || !dst) return PlanStatus::NULL_POINTER;
+        if (row_begin > row_end || row_end > output_height()
+            || col_begin > col_end || col_end > output_width())
+        {
+            return PlanStatus::INVALID_TILE;
+        }
+        run(src1, src2, dst, row_begin, row_end, col_begin, col_end,
+            confidence, uniqueness_ratio);
+        return PlanStatus::OK;
+    }
+
+    /**
+     * \brief Match the destination pixels of row row and columns
+     * [col_begin, col_end) over the disparities [min_disparity,
+     * max_disparity], with the kernel of the plan.
+     *
+     * Nothing is checked: this is the building block of matchers that narrow
+     * the range of the plan pixel by pixel, such as TemporalMatcher.
+     * \param src1             First source matrix, height x width.
+     * \param src2             Second source matrix, height x width.
+     * \param dst              Destination matrix, output_height() x output_width().
+     * \param row              Destination row.
+     * \param col_begin        First destination column.
+     * \param col_end          Destination column after the last one.
+     * \param min_disparity    Minimum disparity searched.
+     * \param max_disparity    Maximum disparity searched.
+     * \param confidence       Optional confidence matrix, as execute.
+     * \param uniqueness_ratio Uniqueness ratio of the confidence.
+     */
+    void match_span(const T* src1, const T* src2, output_type* dst,
+                    SizeType row, SizeType col_begin, SizeType col_end,
+                    std::int64_t min_disparity, std::int64_t max_disparity,
+                    std::uint8_t* confidence = nullptr,
+                    int uniqueness_ratio = 0) const
+    {
+        const SizeType offset = row * output_width();
+        _row_kernel(src1 + row * _width, src2 + row * _width, dst + offset,
+                    _width, _kernel_size, col_begin, col_end,
+                    min_disparity, max_disparity,
+                    confidence ? confidence + offset : nullptr, uniqueness_ratio);
+    }
+
+private:
+    using RowKernel = void (*)(const T*, const T*, output_type*, SizeType,
+                               SizeType, SizeType, SizeType,
+                               std::int64_t, std::int64_t,
+                               std::uint8_t*, int);
+
+    void run(const T* src1, const T* src2, output_type* dst,
+             SizeType row_begin, SizeType row_end,
+             SizeType col_begin, SizeType col_end,
+             std::uint8_t* confidence = nullptr, int uniqueness_ratio = 0) const
+    {
+        for (SizeType row = row_begin; row < row_end; ++row)
+        {
+            match_span(src1, src2, dst, row, col_begin, col_end,
+                       _min_disparity, _max_disparity, confidence, uniqueness_ratio);
+        }
+    }
+
+    static PlanStatus validate(SizeType width, SizeType height,
+                               SizeType kernel_size,
+                               std::int64_t min_disparity,
+                               std::int64_t max_disparity)
+    {
+        if (kernel_size < KERNEL_LIMIT || kernel_size % 2 == 0)
+        {
+            return PlanStatus::INVALID_KERNEL_SIZE;
+        }
+        if (width < kernel_size || height < kernel_size)
+        {
+            return PlanStatus::INVALID_SHAPE;
+        }
+        if (min_disparity > max_disparity)
+        {
+            return PlanStatus::INVALID_DISPARITY_RANGE;
+        }
+        return PlanStatus::OK;
+    }
+
+    template <SizeType K>
+    static void fixed_row(const T* src1, const T* src2, output_type* dst,
+                          SizeType width, SizeType,
+                          SizeType col_begin, SizeType col_end,
+                          std::int64_t min_disparity, std::int64_t max_disparity,
+                          std::uint8_t* confidence, int uniqueness_ratio)
+    {
+        for (SizeType x = col_begin; x < col_end; ++x)
+        {
+            dst[x] = static_cast<output_type>(argMaxCorrFixed<K, T, Traits>(
+                src1, src2, x, width, min_disparity, max_disparity,
+                confidence ? confidence + x : nullptr, uniqueness_ratio));
+        }
+    }
+
+    static void generic_row(const T* src1, const T* src2, output_type* dst,
+                            SizeType width, SizeType kernel_size,
+                            SizeType col_begin, SizeType col_end,
+                            std::int64_t min_disparity, std::int64_t max_disparity,
+                            std::uint8_t* confidence, int uniqueness_ratio)
+    {
+        for (SizeType x = col_begin; x < col_end; ++x)
+        {
+            dst[x] = static_cast<output_type>(argMaxCorr<T, Traits>(
+                src1, src2, x, kernel_size, width, min_disparity, max_disparity,
+                confidence ? confidence + x : nullptr, uniqueness_ratio));
+        }
+    }
+
+    /// Same specializations as argMaxCorrVectorDispatch.
+    static RowKernel select_row_kernel(SizeType kernel_size)
+    {
+        switch (kernel_size)
+        {
+        case 3: return &fixed_row<3>;
+        case 5: return &fixed_row<5>;
+        case 7: return &fixed_row<7>;
+        case 9: return &fixed_row<9>;
+        case 11: return &fixed_row<11>;
+        default: return &generic_row;
+        }
+    }
+
+    SizeType _width;
+    SizeType _height;
+    SizeType _kernel_size;
+    std::int64_t _min_disparity;
+    std::int64_t _max_disparity;
+    PlanStatus _status;
+    RowKernel _row_kernel;
+};
+
+/**
+ * \brief Match count pairs of the same shape; see
+ * StereoMatcherPlan::execute_batch.
+ * \param src1          count pointers to the first source matrices.
+ * \param src2          count pointers to the second source matrices.
+ * \param dst           count pointers to the destination matrices.
+ * \param count         Number of pairs.
+ * \param width         Width of the source matrices.
+ * \param height        Height of the source matrices.
+ * \param kernel_size   Size of the matching window.
+ * \param min_disparity Minimum disparity searched.
+ * \param max_disparity Maximum disparity searched.
+ * \param pool          Thread pool running the rows.
+ * \return The status of the plan, or of its execution.
+ */
+template <typename T, typename Traits = MatchingTraits<T>>
+PlanStatus argMaxCorrMatBatch(const T* const* src1, const T* const* src2,
+                              typename Traits::output_type* const* dst,
+                              SizeType count, SizeType width, SizeType height,
+                              SizeType kernel_size,
+                              std::int64_t min_disparity = DISPARITY_MIN_UNBOUNDED,
+                              std::int64_t max_disparity = DISPARITY_MAX_UNBOUNDED,
+                              ThreadPool& pool = ThreadPool::global())
+{
+    const StereoMatcherPlan<T, Traits> plan(width, height, kernel_size,
+                                            min_disparity, max_disparity);
+    if (!plan.valid()) return plan.status();
+    return plan.execute_batch(src1, src2, dst, count, pool);
+}
+
+} // namespace stereodepth
+
+#endif // STEREODEPTH_PLAN_HPP
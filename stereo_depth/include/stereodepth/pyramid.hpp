@@ -0,0 +1,366 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Alessio Zattoni                                    *
+ *                                                                          *
+ * This file is part of CrossCorrelation.                                   *
+ *                                                                          *
+ *   CrossCorrelation is free software: you can redistribute it and/or      *
+ *   modify it under the terms of the GNU Lesser General Public License as  *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   CrossCorrelation is distributed in the hope that it will be            *
+ *   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+
+
+/**
+ * @file pyramid.hpp
+ * @author Alessio Zattoni
+ * @date
+ * @brief Questo file contiene la cross-correlazione coarse-to-fine su una piramide di immagini
+ *
+ * Le due matrici sorgenti sono dimezzate \p levels volte con una media 2 X 2. Il livello più piccolo
+ * è confrontato con l'intervallo di disparità completo (scalato), ogni livello più fine cerca solo
+ * in [2d - radius, 2d + radius] attorno alla disparità d stimata al livello precedente: il numero di
+ * candidati per pixel passa da D a 2 · radius + 1, indipendentemente dalla larghezza dell'immagine.
+ */
+
+
+
+#pragma once
+
+#include "stereodepth/cross_correlation.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+
+/**
+ * @brief Dimezza la matrice \p src mediando blocchi 2 X 2.
+ * @note  → La matrice \p dst deve avere dimensione ( \p width / 2) X ( \p height / 2): l'ultima riga e
+ *          l'ultima colonna di una dimensione dispari sono scartate. \n
+ *        → Per i tipi interi la media è arrotondata al più vicino, la somma usa \p WideAccumulator. \n
+ *
+ * @tparam      T               Tipo delle matrici sorgente e destinazione
+ *
+ * @param[in]   src             Matrice di input
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza della matrice \p src
+ * @param[in]   height          Altezza della matrice \p src
+ *
+ * @return void
+*/
+template <typename T>
+void pyramidDown(const T            *src,
+                 T                  *dst,
+                 const std::size_t  width,
+                 const std::size_t  height)
+{
+    using Acc = typename WideAccumulator<T>::type;
+
+    const std::size_t dst_width = width / 2;
+    const std::size_t dst_height = height / 2;
+    const Acc round = std::is_floating_point<T>::value ? Acc{0} : Acc{2};
+
+    for (std::size_t r = 0; r < dst_height; r++) {
+        const T *row0 = src + (2 * r) * width;
+        const T *row1 = row0 + width;
+        for (std::size_t c = 0; c < dst_width; c++) {
+            const Acc sum = static_cast<Acc>(row0[2 * c]) + static_cast<Acc>(row0[2 * c + 1]) +
+                            static_cast<Acc>(row1[2 * c]) + static_cast<Acc>(row1[2 * c + 1]);
+            dst[r * dst_width + c] = static_cast<T>((sum + round) / 4);
+        }
+    }
+}
+
+
+/**
+ * @brief Scala un estremo dell'intervallo di disparità al livello successivo della piramide.
+ * @note  Gli estremi illimitati restano illimitati; il minimo è arrotondato per difetto e il massimo per
+ *        eccesso, così l'intervallo scalato contiene sempre quello originale.
+ *
+ * @param[in]   disparity       Estremo dell'intervallo
+ * @param[in]   upper           Se l'estremo è il massimo
+ *
+ * @return Estremo al livello successivo
+ * @retval std::int64_t
+*/
+inline std::int64_t pyramidDisparity(const std::int64_t disparity, const bool upper)
+{
+    if (disparity == DISPARITY_MIN_UNBOUNDED || disparity == DISPARITY_MAX_UNBOUNDED) {
+        return disparity;
+    }
+    const std::int64_t half = disparity >= 0 ? disparity / 2 : -((-disparity) / 2);
+    const bool odd = disparity % 2 != 0;
+    return upper ? half + (odd && disparity > 0) : half - (odd && disparity < 0);
+}
+
+
+/**
+ * @brief Calcola il numero di livelli dimezzati che \p argMaxCorrMatPyramid costruisce davvero.
+ * @note  Un livello non è costruito se renderebbe la matrice più piccola del kernel.
+ *
+ * @param[in]   width           Lunghezza delle due matrici
+ * @param[in]   height          Altezza delle due matrici
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   levels          Numero di livelli richiesti
+ *
+ * @return Numero di livelli costruiti, al più \p levels
+ * @retval std::size_t
+*/
+inline std::size_t pyramidLevels(std::size_t        width,
+                                 std::size_t        height,
+                                 const std::size_t  kernel_size,
+                                 const std::size_t  levels)
+{
+    std::size_t top = 0;
+    while (top < levels && width / 2 >= kernel_size && height / 2 >= kernel_size) {
+        width /= 2;
+        height /= 2;
+        top++;
+    }
+    return top;
+}
+
+
+/**
+ * @brief Calcola la dimensione in byte del \p MatcherWorkspace usato da \p argMaxCorrMatPyramid.
+ * @note  La dimensione comprende i livelli dimezzati delle due matrici, gli indici del livello più piccolo,
+ *        le stime di disparità di due livelli consecutivi e le dimensioni e gli intervalli di ogni livello.
+ *
+ * @tparam      T               Tipo delle matrici sorgenti
+ *
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   levels          Numero di livelli dimezzati della piramide
+ *
+ * @return Dimensione in byte del workspace
+ * @retval std::size_t
+*/
+template <typename T>
+std::size_t pyramidWorkspaceSize(const std::size_t width,
+                                 const std::size_t height,
+                                 const std::size_t kernel_size,
+                                 const std::size_t levels)
+{
+    using stereodepth::MatcherWorkspace;
+
+    const std::size_t top = pyramidLevels(width, height, kernel_size, levels);
+    if (top == 0) {
+        return 0;
+    }
+
+    std::size_t size = 2 * MatcherWorkspace::bytes<std::size_t>(top + 1) +
+                       2 * MatcherWorkspace::bytes<std::int64_t>(top + 1);
+    std::size_t w = width, h = height;
+    for (std::size_t level = 1; level <= top; level++) {
+        w /= 2;
+        h /= 2;
+        size += 2 * MatcherWorkspace::bytes<T>(w * h);
+    }
+    size += MatcherWorkspace::bytes<std::uint32_t>((w - (kernel_size - 1)) * (h - (kernel_size - 1)));
+    size += 2 * MatcherWorkspace::bytes<std::int64_t>((width - (kernel_size - 1)) * (height - (kernel_size - 1)));
+    return size;
+}
+
+
+/**
+ * @brief Versione coarse-to-fine di \p argMaxCorrMat su una piramide di \p levels livelli.
+ * @note  → Con \p levels pari a 0 il risultato è identico a \p argMaxCorrMatDispatch. \n
+ *        → I livelli che renderebbero la matrice più piccola del kernel non sono costruiti. \n
+ *        → Il livello più piccolo usa \p argMaxCorrMatDispatch, i livelli più fini \p argMaxCorr con
+ *          l'intervallo [2d - \p radius, 2d + \p radius] ristretto a [ \p min_disparity, \p max_disparity ]. \n
+ *        → Con \p radius maggiore o uguale all'intervallo di disparità il risultato è identico a
+ *          \p argMaxCorrMat. \n
+ *        → La matrice destinazione deve avere dimensione (src_width - (kernel_size - 1)) * (src_height - (kernel_size - 1))
+ *          e usa la stessa convenzione sull'indice di \p argMaxCorrMat. \n
+ *        → I livelli e le stime intermedie sono presi da \p workspace (vedi \p pyramidWorkspaceSize ): dal secondo
+ *          frame con la stessa risoluzione, kernel e numero di livelli la funzione non alloca memoria. \n
+ *
+ * @tparam      T               Tipo delle matrici sorgenti
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ *
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   levels          Numero di livelli dimezzati della piramide
+ * @param[in]   workspace       Memoria di lavoro
+ * @param[in]   radius          Raggio della ricerca attorno alla stima del livello precedente
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ *
+ * @return void
+*/
+template <typename T, typename Traits = MatchingTraits<T>>
+void argMaxCorrMatPyramid(const T                       *src1,
+                          const T                       *src2,
+                          typename Traits::output_type  *dst,
+                          const std::size_t             width,
+                          const std::size_t             height,
+                          const std::size_t             kernel_size,
+                          const std::size_t             levels,
+                          stereodepth::MatcherWorkspace &workspace,
+                          const std::size_t             radius = 2,
+                          const std::int64_t            min_disparity = DISPARITY_MIN_UNBOUNDED,
+                          const std::int64_t            max_disparity = DISPARITY_MAX_UNBOUNDED)
+{
+    inputParsing(src1, src2, kernel_size, width);
+    disparityParsing(min_disparity, max_disparity);
+
+    if (!dst) {
+        std::cerr << "Invalid destination matrix" <<
+        "\n→ Line: " << __LINE__ <<
+        "\n→ Function: " << __func__  <<
+        "\n→ File: " << __FILE__ << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const std::size_t top = pyramidLevels(width, height, kernel_size, levels);
+    if (top == 0) {
+        argMaxCorrMatDispatch<T, Traits>(src1, src2, dst, width, height, kernel_size, min_disparity, max_disparity);
+        return;
+    }
+
+    // Livelli intermedi: indici a 32 bit, le disparità possono superare il tipo destinazione
+    using LevelTraits = MatchingTraits<T, typename Traits::accumulator_type, std::uint32_t>;
+
+    const std::size_t mark = workspace.mark();
+    workspace.reserve(mark + pyramidWorkspaceSize<T>(width, height, kernel_size, levels));
+
+    std::size_t *widths = workspace.allocate<std::size_t>(top + 1);
+    std::size_t *heights = workspace.allocate<std::size_t>(top + 1);
+    std::int64_t *min_d = workspace.allocate<std::int64_t>(top + 1);
+    std::int64_t *max_d = workspace.allocate<std::int64_t>(top + 1);
+    // pyr1[l], pyr2[l]: livello l, con pyr1[0] = src1 e pyr2[0] = src2
+    const T *pyr1[std::numeric_limits<std::size_t>::digits + 1] = {src1};
+    const T *pyr2[std::numeric_limits<std::size_t>::digits + 1] = {src2};
+
+    widths[0] = width;
+    heights[0] = height;
+    min_d[0] = min_disparity;
+    max_d[0] = max_disparity;
+    for (std::size_t level = 1; level <= top; level++) {
+        widths[level] = widths[level - 1] / 2;
+        heights[level] = heights[level - 1] / 2;
+        T *level1 = workspace.allocate<T>(widths[level] * heights[level]);
+        T *level2 = workspace.allocate<T>(widths[level] * heights[level]);
+        pyramidDown(pyr1[level - 1], level1, widths[level - 1], heights[level - 1]);
+        pyramidDown(pyr2[level - 1], level2, widths[level - 1], heights[level - 1]);
+        pyr1[level] = level1;
+        pyr2[level] = level2;
+        min_d[level] = pyramidDisparity(min_d[level - 1], false);
+        max_d[level] = pyramidDisparity(max_d[level - 1], true);
+    }
+
+    const std::int64_t pos = static_cast<std::int64_t>(kernel_size / 2);
+
+    // Livello più piccolo: intervallo completo, indici convertiti in disparità d = x - j
+    std::size_t dst_w = widths[top] - (kernel_size - 1);
+    std::size_t dst_h = heights[top] - (kernel_size - 1);
+    std::uint32_t *index = workspace.allocate<std::uint32_t>(dst_w * dst_h);
+    argMaxCorrMatDispatch<T, LevelTraits>(pyr1[top], pyr2[top], index,
+                                          widths[top], heights[top], kernel_size, min_d[top], max_d[top]);
+
+    const std::size_t full_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+    std::int64_t *coarse = workspace.allocate<std::int64_t>(full_size);
+    std::int64_t *fine = workspace.allocate<std::int64_t>(full_size);
+    for (std::size_t i = 0; i < dst_w * dst_h; i++) {
+        const std::int64_t x = static_cast<std::int64_t>(i % dst_w);
+        coarse[i] = x - (static_cast<std::int64_t>(index[i]) + 1 - pos);
+    }
+
+    for (std::size_t level = top; level-- > 0; ) {
+        const T *s1 = pyr1[level];
+        const T *s2 = pyr2[level];
+        const std::size_t w = widths[level];
+        const std::size_t coarse_w = dst_w, coarse_h = dst_h;
+        dst_w = w - (kernel_size - 1);
+        dst_h = heights[level] - (kernel_size - 1);
+        std::fill(fine, fine + dst_w * dst_h, std::int64_t{0});
+
+        for (std::size_t r = 0; r < dst_h; r++) {
+            // Il centro della finestra al livello precedente è a metà coordinate
+            const std::size_t rc = std::min(std::max((static_cast<std::int64_t>(r) + pos) / 2 - pos, std::int64_t{0}),
+                                            static_cast<std::int64_t>(coarse_h) - 1);
+            for (std::size_t x = 0; x < dst_w; x++) {
+                const std::size_t xc = std::min(std::max((static_cast<std::int64_t>(x) + pos) / 2 - pos, std::int64_t{0}),
+                                                static_cast<std::int64_t>(coarse_w) - 1);
+                const std::int64_t predicted = 2 * coarse[rc * coarse_w + xc];
+                std::int64_t lo = std::max(predicted - static_cast<std::int64_t>(radius), min_d[level]);
+                std::int64_t hi = std::min(predicted + static_cast<std::int64_t>(radius), max_d[level]);
+                if (lo > hi) {
+                    lo = hi = predicted < min_d[level] ? min_d[level] : max_d[level];
+                }
+
+                std::size_t begin, end;
+                disparitySearchRange(x, kernel_size, w, lo, hi, begin, end);
+                if (begin == end) {
+                    // Nessun candidato nella riga: la stima è propagata, la destinazione vale 0 come in argMaxCorr
+                    fine[r * dst_w + x] = predicted;
+                    if (level == 0) {
+                        dst[r * dst_w + x] = 0;
+                    }
+                    continue;
+                }
+
+                const std::size_t idx = argMaxCorr<T, LevelTraits>(s1 + r * w, s2 + r * w, x, kernel_size, w, lo, hi);
+                fine[r * dst_w + x] = static_cast<std::int64_t>(x) - (static_cast<std::int64_t>(idx) + 1 - pos);
+                if (level == 0) {
+                    dst[r * dst_w + x] = static_cast<typename Traits::output_type>(idx);
+                }
+            }
+        }
+        std::swap(coarse, fine);
+    }
+
+    workspace.rewind(mark);
+}
+
+
+/**
+ * @brief Versione di \p argMaxCorrMatPyramid con un workspace temporaneo allocato ad ogni chiamata.
+ * @note  Per elaborare più frame senza allocazioni usare la versione con \p MatcherWorkspace.
+ *
+ * @tparam      T               Tipo delle matrici sorgenti
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ *
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   levels          Numero di livelli dimezzati della piramide
+ * @param[in]   radius          Raggio della ricerca attorno alla stima del livello precedente
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ *
+ * @return void
+*/
+template <typename T, typename Traits = MatchingTraits<T>>
+void argMaxCorrMatPyramid(const T               *src1,
+                          const T               *src2,
+                          typename Traits::output_type *dst,
+                          const std::size_t     width,
+                          const std::size_t     height,
+                          const std::size_t     kernel_size,
+                          const std::size_t     levels,
+                          const std::size_t     radius = 2,
+                          const std::int64_t    min_disparity = DISPARITY_MIN_UNBOUNDED,
+                          const std::int64_t    max_disparity = DISPARITY_MAX_UNBOUNDED)
+{
+    stereodepth::MatcherWorkspace workspace(pyramidWorkspaceSize<T>(width, height, kernel_size, levels));
+    argMaxCorrMatPyramid<T, Traits>(src1, src2, dst, width, height, kernel_size, levels, workspace,
+                                    radius, min_disparity, max_disparity);
+}
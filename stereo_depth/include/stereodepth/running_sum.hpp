@@ -0,0 +1,377 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Alessio Zattoni                                    *
+ *                                                                          *
+ * This file is part of CrossCorrelation.                                   *
+ *                                                                          *
+ *   CrossCorrelation is free software: you can redistribute it and/or      *
+ *   modify it under the terms of the GNU Lesser General Public License as  *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   CrossCorrelation is distributed in the hope that it will be            *
+ *   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+
+
+/**
+ * @file running_sum.hpp
+ * @author Alessio Zattoni
+ * @date
+ * @brief Questo file contiene la cross-correlazione a costo costante per finestra basata su somme mobili
+ *
+ * Fissata la disparità d, il costo di una finestra è la somma K X K dell'immagine prodotto
+ * P_d(r, c) = src1(r, c - d) * src2(r, c). Mantenendo per ogni disparità le somme per colonna di P_d
+ * sulle ultime K righe, il passaggio alla riga successiva costa un'addizione e una sottrazione per colonna
+ * e il passaggio alla finestra successiva lungo la riga costa un'addizione e una sottrazione per candidato:
+ * il costo per candidato non dipende più da K.
+ */
+
+
+
+#pragma once
+
+#include "stereodepth/cross_correlation.hpp"
+#include "stereodepth/cost_volume.hpp"
+
+#include <vector>
+
+
+/**
+ * @brief Calcola la dimensione in byte del \p MatcherWorkspace usato da \p argMaxCorrMatRunningSum.
+ *
+ * @tparam      T               Tipo delle matrici sorgenti
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ *
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ *
+ * @return Dimensione in byte del workspace
+ * @retval std::size_t
+*/
+template <typename T, typename Traits = MatchingTraits<T>>
+std::size_t runningSumWorkspaceSize(const std::size_t   width,
+                                    const std::size_t   kernel_size,
+                                    std::int64_t        min_disparity = DISPARITY_MIN_UNBOUNDED,
+                                    std::int64_t        max_disparity = DISPARITY_MAX_UNBOUNDED)
+{
+    using Acc = typename Traits::accumulator_type;
+    using stereodepth::MatcherWorkspace;
+
+    clampDisparityRange(width, kernel_size, min_disparity, max_disparity);
+    const std::size_t disparities = static_cast<std::size_t>(max_disparity - min_disparity + 1);
+    const std::size_t dst_width = width - (kernel_size - 1);
+
+    return MatcherWorkspace::bytes<Acc>(dst_width) +
+           MatcherWorkspace::bytes<std::size_t>(dst_width) +
+           MatcherWorkspace::bytes<Acc>(disparities * width);
+}
+
+
+/**
+ * @brief Calcola la cross-correlazione tra \p src1 e \p src2 con somme mobili per colonna e per riga.
+ * @note  → Produce lo stesso risultato di \p argMaxCorrMat (stessa convenzione sull'indice e stessa
+ *          gestione dei pari merito) per tipi interi senza segno, poiché le somme mobili sono esatte
+ *          in aritmetica modulare. Per tipi in virgola mobile i costi possono differire per arrotondamento. \n
+ *        → Il costo per candidato è O(1) rispetto a \p kernel_size: una riga costa O(W·D). \n
+ *        → La memoria ausiliaria è di D X \p width elementi, con D = \p max_disparity - \p min_disparity + 1:
+ *          con l'intervallo di default D vale 2 · ( \p width - \p kernel_size ) + 1. \n
+ *        → La matrice destinazione deve avere dimensione (src_width - (kernel_size - 1)) * (src_height - (kernel_size - 1)). \n
+ *        → La memoria ausiliaria è presa da \p workspace (vedi \p runningSumWorkspaceSize ): dal secondo frame con
+ *          la stessa risoluzione, kernel e intervallo la funzione non alloca memoria. \n
+ *
+ * @tparam      T               Tipo delle matrici sorgenti e destinazione
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ *
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   workspace       Memoria di lavoro
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ *
+ * @return void
+*/
+template <typename T, typename Traits = MatchingTraits<T>>
+void argMaxCorrMatRunningSum(const T                        *src1,
+                             const T                        *src2,
+                             typename Traits::output_type   *dst,
+                             const std::size_t              width,
+                             const std::size_t              height,
+                             const std::size_t              kernel_size,
+                             stereodepth::MatcherWorkspace  &workspace,
+                             std::int64_t                   min_disparity = DISPARITY_MIN_UNBOUNDED,
+                             std::int64_t                   max_disparity = DISPARITY_MAX_UNBOUNDED)
+{
+    inputParsing(src1, src2, kernel_size, width);
+    disparityParsing(min_disparity, max_disparity);
+
+    if (!dst) {
+        std::cerr << "Invalid destination matrix" <<
+        "\n→ Line: " << __LINE__ <<
+        "\n→ Function: " << __func__  <<
+        "\n→ File: " << __FILE__ << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    const std::size_t dst_width = width - (kernel_size - 1);
+    const std::size_t dst_height = height - (kernel_size - 1);
+    const std::int64_t pos = static_cast<std::int64_t>(kernel_size / 2);
+    const std::int64_t w = static_cast<std::int64_t>(width);
+    const std::int64_t last = w - static_cast<std::int64_t>(kernel_size);
+
+    using Acc = typename Traits::accumulator_type;
+
+    const std::size_t mark = workspace.mark();
+    workspace.reserve(mark + runningSumWorkspaceSize<T, Traits>(width, kernel_size, min_disparity, max_disparity));
+
+    clampDisparityRange(width, kernel_size, min_disparity, max_disparity);
+    const std::size_t disparities = static_cast<std::size_t>(max_disparity - min_disparity + 1);
+
+    Acc *best = workspace.allocate<Acc>(dst_width);
+    std::size_t *best_idx = workspace.allocate<std::size_t>(dst_width);
+
+    // col_sums[d * width + c] = somma su K righe di src1(r, c - d) * src2(r, c)
+    Acc *col_sums = workspace.allocate<Acc>(disparities * width);
+    std::fill(col_sums, col_sums + disparities * width, Acc{0});
+
+    for (std::size_t row = 0; row < dst_height; row++) {
+        for (std::size_t n = 0; n < disparities; n++) {
+            const std::int64_t d = min_disparity + static_cast<std::int64_t>(n);
+            const std::int64_t c_begin = std::max(d, std::int64_t{0});
+            const std::int64_t c_end = std::min(w + d, w);
+            Acc *sums = col_sums + n * width;
+
+            if (row == 0) {
+                for (std::size_t r = 0; r < kernel_size; r++) {
+                    const T *s1 = src1 + r * width - d;
+                    const T *s2 = src2 + r * width;
+                    for (std::int64_t c = c_begin; c < c_end; c++) {
+                        sums[c] += static_cast<Acc>(s1[c]) * static_cast<Acc>(s2[c]);
+                    }
+                }
+            }
+            else {
+                const T *out1 = src1 + (row - 1) * width - d;
+                const T *out2 = src2 + (row - 1) * width;
+                const T *in1 = src1 + (row + kernel_size - 1) * width - d;
+                const T *in2 = src2 + (row + kernel_size - 1) * width;
+                for (std::int64_t c = c_begin; c < c_end; c++) {
+                    sums[c] += static_cast<Acc>(in1[c]) * static_cast<Acc>(in2[c]);
+                    sums[c] -= static_cast<Acc>(out1[c]) * static_cast<Acc>(out2[c]);
+                }
+            }
+        }
+
+        std::fill(best, best + dst_width, Acc{0});
+        std::fill(best_idx, best_idx + dst_width, 0);
+
+        // Disparità decrescenti: per ogni x i candidati sono visitati con colonna crescente, come in argMaxCorr
+        for (std::size_t n = disparities; n-- > 0; ) {
+            const std::int64_t d = min_disparity + static_cast<std::int64_t>(n);
+            const std::int64_t x_begin = std::max(d, std::int64_t{0});
+            const std::int64_t x_end = std::min(last + d, last) + 1;
+            const Acc *sums = col_sums + n * width;
+
+            if (x_begin >= x_end) {
+                continue;
+            }
+
+            Acc window{0};
+            for (std::int64_t c = x_begin; c < x_begin + static_cast<std::int64_t>(kernel_size); c++) {
+                window += sums[c];
+            }
+
+            for (std::int64_t x = x_begin; x < x_end; x++) {
+                if (x > x_begin) {
+                    window += sums[x + static_cast<std::int64_t>(kernel_size) - 1];
+                    window -= sums[x - 1];
+                }
+                if (window >= best[x]) {
+                    best[x] = window;
+                    best_idx[x] = static_cast<std::size_t>(x - d + pos - 1);
+                }
+            }
+        }
+
+        for (std::size_t x = 0; x < dst_width; x++) {
+            *(dst + (row * dst_width) + x) = static_cast<typename Traits::output_type>(best_idx[x]);
+        }
+    }
+
+    workspace.rewind(mark);
+}
+
+
+/**
+ * @brief Versione di \p argMaxCorrMatRunningSum con un workspace temporaneo allocato ad ogni chiamata.
+ * @note  Per elaborare più frame senza allocazioni usare la versione con \p MatcherWorkspace.
+ *
+ * @tparam      T               Tipo delle matrici sorgenti e destinazione
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ *
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ *
+ * @return void
+*/
+template <typename T, typename Traits = MatchingTraits<T>>
+void argMaxCorrMatRunningSum(const T            *src1,
+                             const T            *src2,
+                             typename Traits::output_type *dst,
+                             const std::size_t  width,
+                             const std::size_t  height,
+                             const std::size_t  kernel_size,
+                             std::int64_t       min_disparity = DISPARITY_MIN_UNBOUNDED,
+                             std::int64_t       max_disparity = DISPARITY_MAX_UNBOUNDED)
+{
+    stereodepth::MatcherWorkspace workspace;
+    argMaxCorrMatRunningSum<T, Traits>(src1, src2, dst, width, height, kernel_size, workspace, min_disparity, max_disparity);
+}
+
+
+/**
+ * @brief Somma scorrevole lungo la riga dei prodotti \p src1 (c - d) * \p src2 (c) su \p kernel_size colonne,
+ *        per le finestre da \p x_begin a \p x_end - 1.
+ * @note  → Il risultato della finestra x viene passato a \p op insieme a x. \n
+ *        → Il costo è O(1) per finestra, indipendente da \p kernel_size. \n
+ *
+ * @tparam      Acc             Tipo dell'accumulatore
+ * @tparam      T               Tipo delle righe sorgenti
+ * @tparam      Op              Tipo dell'operazione da applicare ad ogni finestra
+ *
+ * @param[in]   row1            Riga della prima matrice
+ * @param[in]   row2            Riga della seconda matrice
+ * @param[in]   d               Disparità
+ * @param[in]   x_begin         Prima finestra
+ * @param[in]   x_end           Finestra successiva all'ultima
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   op              Operazione chiamata come op(x, somma)
+ *
+ * @return void
+*/
+template <typename Acc, typename T, typename Op>
+inline void slideRowProducts(const T            *row1,
+                             const T            *row2,
+                             const std::int64_t d,
+                             const std::int64_t x_begin,
+                             const std::int64_t x_end,
+                             const std::size_t  kernel_size,
+                             Op                 op)
+{
+    const std::int64_t k = static_cast<std::int64_t>(kernel_size);
+    Acc sum{0};
+
+    for (std::int64_t c = x_begin; c < x_begin + k; c++) {
+        sum += static_cast<Acc>(row1[c - d]) * static_cast<Acc>(row2[c]);
+    }
+    op(x_begin, sum);
+
+    for (std::int64_t x = x_begin + 1; x < x_end; x++) {
+        sum += static_cast<Acc>(row1[x + k - 1 - d]) * static_cast<Acc>(row2[x + k - 1]);
+        sum -= static_cast<Acc>(row1[x - 1 - d]) * static_cast<Acc>(row2[x - 1]);
+        op(x, sum);
+    }
+}
+
+
+/**
+ * @brief Riempie il volume dei costi \p volume con la cross-correlazione tra \p src1 e \p src2 usando somme mobili.
+ * @note  → Il volume viene ridimensionato a (height - (kernel_size - 1)) X (width - (kernel_size - 1)) X D:
+ *          se la capacità è sufficiente (stessa risoluzione del frame precedente) non avviene alcuna allocazione. \n
+ *        → Ogni riga del volume è ottenuta dalla precedente sommando la riga che entra nella finestra e
+ *          sottraendo quella che esce, quindi il costo per elemento è O(1) rispetto a \p kernel_size. \n
+ *        → Gli elementi che corrispondono a finestre fuori dalla riga valgono 0 e vengono ignorati da
+ *          \p stereodepth::winner_takes_all. \n
+ *        → Per tipi interi senza segno i costi coincidono con quelli calcolati da \p argMaxCorr con
+ *          accumulatore \p Acc. \n
+ *
+ * @tparam      T               Tipo delle matrici sorgenti
+ * @tparam      Acc             Tipo dei costi nel volume
+ *
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  volume          Volume dei costi
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ *
+ * @return void
+*/
+template <typename T, typename Acc>
+void costVolumeRunningSum(const T                       *src1,
+                          const T                       *src2,
+                          stereodepth::CostVolume<Acc>  &volume,
+                          const std::size_t             width,
+                          const std::size_t             height,
+                          const std::size_t             kernel_size,
+                          std::int64_t                  min_disparity = DISPARITY_MIN_UNBOUNDED,
+                          std::int64_t                  max_disparity = DISPARITY_MAX_UNBOUNDED)
+{
+    inputParsing(src1, src2, kernel_size, width);
+    disparityParsing(min_disparity, max_disparity);
+    clampDisparityRange(width, kernel_size, min_disparity, max_disparity);
+
+    const std::size_t dst_width = width - (kernel_size - 1);
+    const std::size_t dst_height = height - (kernel_size - 1);
+    const std::int64_t last = static_cast<std::int64_t>(width - kernel_size);
+
+    volume.resize(dst_height, dst_width, min_disparity, max_disparity);
+    volume.fill(Acc{0});
+
+    const std::size_t row_stride = volume.row_stride();
+    const std::size_t col_stride = volume.col_stride();
+
+    for (std::size_t n = 0; n < volume.disparities(); n++) {
+        const std::int64_t d = volume.disparity(n);
+        const std::int64_t x_begin = std::max(d, std::int64_t{0});
+        const std::int64_t x_end = std::min(last + d, last) + 1;
+
+        if (x_begin >= x_end) {
+            continue;
+        }
+
+        Acc *costs = volume.data() + volume.index(0, 0, n);
+
+        for (std::size_t r = 0; r < kernel_size; r++) {
+            slideRowProducts<Acc>(src1 + r * width, src2 + r * width, d, x_begin, x_end, kernel_size,
+                [costs, col_stride](std::int64_t x, Acc sum) {
+                    costs[x * col_stride] += sum;
+                });
+        }
+
+        for (std::size_t row = 1; row < dst_height; row++) {
+            const Acc *prev = costs + (row - 1) * row_stride;
+            Acc *curr = costs + row * row_stride;
+
+            slideRowProducts<Acc>(src1 + (row + kernel_size - 1) * width, src2 + (row + kernel_size - 1) * width,
+                             d, x_begin, x_end, kernel_size,
+                [prev, curr, col_stride](std::int64_t x, Acc sum) {
+                    curr[x * col_stride] = prev[x * col_stride] + sum;
+                });
+            slideRowProducts<Acc>(src1 + (row - 1) * width, src2 + (row - 1) * width,
+                             d, x_begin, x_end, kernel_size,
+                [curr, col_stride](std::int64_t x, Acc sum) {
+                    curr[x * col_stride] -= sum;
+                });
+        }
+    }
+}
@@ -0,0 +1,207 @@
+/***************************************************************************
+ *            sgm.hpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+
+/*! \file  sgm.hpp
+ *  \brief Semi-Global Matching aggregation of a per-pixel cost volume.
+ */
+
+#include "type.hpp"
+#include "cost_volume.hpp"
+#include "census.hpp"
+#include "simd.hpp"
+#include "workspace.hpp"
+
+#include <cstdint>
+
+#ifndef STEREODEPTH_SGM_HPP
+#define STEREODEPTH_SGM_HPP
+
+namespace stereodepth {
+
+/**
+ * \brief Parameters of the SGM aggregation.
+ *
+ * Along each path the cost of disparity d is increased by p1 when the
+ * disparity of the previous pixel differs by one and by p2 for larger jumps.
+ */
+struct SgmParameters {
+    SizeType paths = 8;              ///< Number of path directions, 4 or 8.
+    std::uint16_t p1 = 7;            ///< Penalty for a disparity change of 1.
+    std::uint16_t p2 = 86;           ///< Penalty for larger disparity changes.
+    SizeType num_threads = 0;        ///< OpenMP threads, 0 means the default.
+};
+
+/**
+ * \brief Size in bytes of the MatcherWorkspace used by sgm_aggregate.
+ * \param width       Width of the cost volume.
+ * \param disparities Number of disparities of the cost volume.
+ * \param params      SGM parameters; the number of threads sets the size.
+ * \return The workspace size in bytes.
+ */
+SizeType sgm_workspace_size(SizeType width, SizeType disparities,
+                            const SgmParameters& params = SgmParameters{});
+
+/**
+ * \brief Aggregate the matching costs along 4 or 8 scanline directions.
+ *
+ * aggregated(r, c, n) is the sum over the path directions of
+ * L(p, n) = C(p, n) + min(L(p-r, n), L(p-r, n+-1) + p1, min L(p-r) + p2)
+ *           - min L(p-r).
+ * The per-disparity minimum reductions run on the given SIMD level. One
+ * direction is processed at a time, streaming over the image with a single
+ * line of path costs, so besides the two volumes the memory is
+ * O(width x disparities) per thread. Scanlines that do not depend on each
+ * other (rows for horizontal paths, pixels of a row otherwise) are split
+ * among the OpenMP threads; the result does not depend on the number of
+ * threads.
+ * \param costs      Per-pixel costs, HWD layout.
+ * \param aggregated Output volume, HWD layout, resized to the shape of costs.
+ * \param params     Penalties, number of paths and threads.
+ * \param level      SIMD level of the path kernels.
+ * \throw std::invalid_argument if a volume is not HWD, the number of paths
+ *        is not 4 or 8, or the aggregated costs could overflow 16 bits.
+ */
+void sgm_aggregate(const CostVolume<std::uint16_t>& costs,
+                   CostVolume<std::uint16_t>& aggregated,
+                   const SgmParameters& params = SgmParameters{},
+                   SimdLevel level = simdLevel());
+
+/**
+ * \brief sgm_aggregate taking the lines of path costs from workspace.
+ *
+ * Once workspace and aggregated are sized for the resolution, further calls
+ * with the same parameters do not allocate.
+ * \param costs      Per-pixel costs, HWD layout.
+ * \param aggregated Output volume, HWD layout, resized to the shape of costs.
+ * \param workspace  Scratch memory, see sgm_workspace_size.
+ * \param params     Penalties, number of paths and threads.
+ * \param level      SIMD level of the path kernels.
+ * \throw std::invalid_argument as sgm_aggregate; std::logic_error if the
+ *        workspace must grow while other buffers are taken from it.
+ */
+void sgm_aggregate(const CostVolume<std::uint16_t>& costs,
+                   CostVolume<std::uint16_t>& aggregated,
+                   MatcherWorkspace& workspace,
+                   const SgmParameters& params = SgmParameters{},
+                   SimdLevel level = simdLevel());
+
+/**
+ * \brief Size in bytes of the MatcherWorkspace used by sgm_census_disparity.
+ * \param width        Width of the source matrices.
+ * \param height       Height of the source matrices.
+ * \param kernel_size  Size of the matching window.
+ * \param min_disparity Minimum disparity searched.
+ * \param max_disparity Maximum disparity searched.
+ * \param params       SGM parameters.
+ * \return The workspace size in bytes.
+ */
+inline SizeType sgm_census_workspace_size(
+    SizeType width, SizeType height, SizeType kernel_size,
+    std::int64_t min_disparity = DISPARITY_MIN_UNBOUNDED,
+    std::int64_t max_disparity = DISPARITY_MAX_UNBOUNDED,
+    const SgmParameters& params = SgmParameters{})
+{
+    const SizeType census = censusWorkspaceSize(width, height);
+    if (kernel_size > width || kernel_size > height
+        || max_disparity < min_disparity)
+    {
+        return census;
+    }
+    clampDisparityRange(width, kernel_size, min_disparity, max_disparity);
+    const auto disparities
+        = static_cast<SizeType>(max_disparity - min_disparity + 1);
+    return census
+        + sgm_workspace_size(width - (kernel_size - 1), disparities, params);
+}
+
+/**
+ * \brief sgm_census_disparity with caller-owned volumes and scratch memory.
+ *
+ * The census descriptors and the SGM lines are taken from workspace, the
+ * volumes are resized in place: from the second frame at the same
+ * resolution the call does not allocate.
+ * \tparam T           Type of the source matrices.
+ * \tparam U           Type of the destination elements.
+ * \param src1         First source matrix.
+ * \param src2         Second source matrix.
+ * \param dst          Destination matrix.
+ * \param width        Width of the source matrices.
+ * \param height       Height of the source matrices.
+ * \param kernel_size  Size of the matching window.
+ * \param costs        Census cost volume, HWD layout.
+ * \param aggregated   Aggregated cost volume, HWD layout.
+ * \param workspace    Scratch memory, see sgm_census_workspace_size.
+ * \param min_disparity Minimum disparity searched.
+ * \param max_disparity Maximum disparity searched.
+ * \param params       SGM parameters.
+ * \return The pointer to the destination matrix.
+ */
+template <typename T, typename U>
+U* sgm_census_disparity(const T* src1, const T* src2, U* dst,
+                        SizeType width, SizeType height, SizeType kernel_size,
+                        CostVolume<std::uint16_t>& costs,
+                        CostVolume<std::uint16_t>& aggregated,
+                        MatcherWorkspace& workspace,
+                        std::int64_t min_disparity = DISPARITY_MIN_UNBOUNDED,
+                        std::int64_t max_disparity = DISPARITY_MAX_UNBOUNDED,
+                        const SgmParameters& params = SgmParameters{})
+{
+    const SizeType mark = workspace.mark();
+    // sgm_aggregate nests in the same arena: reserve its lines up front.
+    workspace.reserve(mark + sgm_census_workspace_size(
+        width, height, kernel_size, min_disparity, max_disparity, params));
+    std::uint64_t* census1 = workspace.allocate<std::uint64_t>(width * height);
+    std::uint64_t* census2 = workspace.allocate<std::uint64_t>(width * height);
+    censusTransform(src1, census1, width, height);
+    censusTransform(src2, census2, width, height);
+
+    costVolumeCensus(census1, census2, costs,
+                     width, height, kernel_size, min_disparity, max_disparity);
+    sgm_aggregate(costs, aggregated, workspace, params);
+    winner_takes_min(dst, aggregated, kernel_size);
+    workspace.rewind(mark);
+    return dst;
+}
+
+/**
+ * \brief Census + SGM disparity of src2 with respect to src1.
+ *
+ * The destination has the size and the index convention of argMaxCorrMat;
+ * with p1 = p2 = 0 it is equal to argMinCensusMat.
+ * \tparam T           Type of the source matrices.
+ * \tparam U           Type of the destination elements.
+ * \param src1         First source matrix.
+ * \param src2         Second source matrix.
+ * \param dst          Destination matrix.
+ * \param width        Width of the source matrices.
+ * \param height       Height of the source matrices.
+ * \param kernel_size  Size of the matching window.
+ * \param min_disparity Minimum disparity searched.
+ * \param max_disparity Maximum disparity searched.
+ * \param params       SGM parameters.
+ * \return The pointer to the destination matrix.
+ */
+template <typename T, typename U>
+U* sgm_census_disparity(const T* src1, const T* src2, U* dst,
+                        SizeType width, SizeType height, SizeType kernel_size,
+                        std::int64_t min_disparity = DISPARITY_MIN_UNBOUNDED,
+                        std::int64_t max_disparity = DISPARITY_MAX_UNBOUNDED,
+                        const SgmParameters& params = SgmParameters{})
+{
+    CostVolume<std::uint16_t> costs;
+    CostVolume<std::uint16_t> aggregated;
+    MatcherWorkspace workspace(sgm_census_workspace_size(
+        width, height, kernel_size, min_disparity, max_disparity, params));
+    return sgm_census_disparity(src1, src2, dst, width, height, kernel_size,
+                                costs, aggregated, workspace,
+                                min_disparity, max_disparity, params);
+}
+
+} // namespace stereodepth
+
+#endif // STEREODEPTH_SGM_HPP
@@ -0,0 +1,347 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Alessio Zattoni                                    *
+ *                                                                          *
+ * This file is part of CrossCorrelation.                                   *
+ *                                                                          *
+ *   CrossCorrelation is free software: you can redistribute it and/or      *
+ *   modify it under the terms of the GNU Lesser General Public License as  *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   CrossCorrelation is distributed in the hope that it will be            *
+ *   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+
+
+/**
+ * @file simd.hpp
+ * @author Alessio Zattoni
+ * @date
+ * @brief Questo file contiene i kernel vettoriali SSE4/AVX2 per il calcolo dei costi su immagini a 8 bit
+ *
+ * Il livello SIMD viene scelto una sola volta all'avvio interrogando la CPU (CPUID); su architetture
+ * diverse da x86 o con compilatori che non supportano gli attributi \p target viene usata la versione scalare.
+ */
+
+
+
+#pragma once
+
+#include "stereodepth/cross_correlation.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+
+/// Funzione di costo calcolata sulla finestra
+enum class CostFunction {
+    PRODUCT_SUM,    ///< Somma dei prodotti (cross-correlazione), da massimizzare
+    SAD,            ///< Somma delle differenze assolute, da minimizzare
+    SSD             ///< Somma delle differenze al quadrato, da minimizzare
+};
+
+
+/// Insieme di istruzioni usato dai kernel vettoriali
+enum class SimdLevel {
+    SCALAR,         ///< Nessuna istruzione vettoriale
+    SSE4,           ///< SSE4.1, 128 bit
+    AVX2            ///< AVX2, 256 bit
+};
+
+
+/**
+ * @brief Interroga la CPU e restituisce il livello SIMD più alto supportato.
+ *
+ * @return Il livello SIMD supportato dalla CPU
+ * @retval SimdLevel
+*/
+SimdLevel detectSimdLevel();
+
+
+/**
+ * @brief Restituisce il livello SIMD scelto all'avvio, usato di default da tutti i kernel.
+ *
+ * @return Il livello SIMD corrente
+ * @retval SimdLevel
+*/
+SimdLevel simdLevel();
+
+
+/**
+ * @brief Indica se la CPU supporta il livello SIMD \p level.
+ *
+ * @param[in]   level   Livello SIMD
+ *
+ * @return true se il livello è supportato
+ * @retval bool
+*/
+bool simdLevelSupported(SimdLevel level);
+
+
+/**
+ * @brief Restituisce il nome del livello SIMD \p level.
+ *
+ * @param[in]   level   Livello SIMD
+ *
+ * @return Nome del livello
+ * @retval const char*
+*/
+const char *simdLevelName(SimdLevel level);
+
+
+/**
+ * @brief Calcola il costo delle finestre \p kernel_size X \p kernel_size tra \p src1 e \p src2 per una disparità fissata.
+ * @note  → Per ogni x in [ \p x_begin, \p x_end ) confronta la finestra di \p src2 che parte dalla colonna x con
+ *          la finestra di \p src1 che parte dalla colonna x - \p d: \p costs [x - \p x_begin] riceve il costo. \n
+ *        → Le finestre devono essere interne alla riga: 0 <= x - \p d e x + \p kernel_size <= \p width. \n
+ *        → \p src1 e \p src2 puntano alla prima riga della finestra, le righe hanno lunghezza \p width. \n
+ *        → \p scratch deve contenere almeno \p x_end - \p x_begin + \p kernel_size - 1 elementi. \n
+ *        → Le corsie vettoriali sono scelte con \p accumulatorBits: la SAD con \p kernel_size fino a 16 usa
+ *          corsie a 16 bit, gli altri casi corsie a 32 bit. I costi sono esatti per \p kernel_size fino a 257. \n
+ *
+ * @param[in]   cost            Funzione di costo
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[in]   width           Lunghezza delle due matrici
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   d               Disparità
+ * @param[in]   x_begin         Prima finestra
+ * @param[in]   x_end           Finestra successiva all'ultima
+ * @param[out]  costs           Costi delle finestre
+ * @param[out]  scratch         Memoria di appoggio per le somme per colonna
+ * @param[in]   level           Livello SIMD da usare
+ *
+ * @return void
+*/
+void windowCostsU8(CostFunction         cost,
+                   const std::uint8_t   *src1,
+                   const std::uint8_t   *src2,
+                   std::size_t          width,
+                   std::size_t          kernel_size,
+                   std::int64_t         d,
+                   std::size_t          x_begin,
+                   std::size_t          x_end,
+                   std::uint32_t        *costs,
+                   std::uint32_t        *scratch,
+                   SimdLevel            level = simdLevel());
+
+
+/**
+ * @brief Calcola la somma delle differenze assolute tra due blocchi \p rows X \p cols di due immagini a 8 bit.
+ * @note  → Le due immagini hanno righe di lunghezza \p stride; \p a e \p b puntano al primo pixel del blocco. \n
+ *        → Usata per confrontare un frame con il precedente: con AVX2 costa circa un'istruzione ogni 32 pixel. \n
+ *
+ * @param[in]   a               Primo blocco
+ * @param[in]   b               Secondo blocco
+ * @param[in]   stride          Lunghezza delle righe delle due immagini
+ * @param[in]   rows            Righe del blocco
+ * @param[in]   cols            Colonne del blocco
+ * @param[in]   level           Livello SIMD da usare
+ *
+ * @return Somma delle differenze assolute
+ * @retval std::uint64_t
+*/
+std::uint64_t blockSadU8(const std::uint8_t     *a,
+                         const std::uint8_t     *b,
+                         std::size_t            stride,
+                         std::size_t            rows,
+                         std::size_t            cols,
+                         SimdLevel              level = simdLevel());
+
+
+/**
+ * @brief Calcola la dimensione in byte del \p MatcherWorkspace usato da \p argMaxCorrMatSimd.
+ *
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ *
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   confidence      Se la mappa di confidenza è richiesta
+ *
+ * @return Dimensione in byte del workspace
+ * @retval std::size_t
+*/
+template <typename Traits = MatchingTraits<std::uint8_t>>
+std::size_t simdWorkspaceSize(const std::size_t width, const std::size_t kernel_size, const bool confidence = false)
+{
+    using stereodepth::MatcherWorkspace;
+    using Acc = typename Traits::accumulator_type;
+
+    const std::size_t dst_width = width - (kernel_size - 1);
+    return MatcherWorkspace::bytes<std::uint32_t>(dst_width) +
+           MatcherWorkspace::bytes<std::uint32_t>(width) +
+           MatcherWorkspace::bytes<Acc>(dst_width) +
+           MatcherWorkspace::bytes<std::size_t>(dst_width) +
+           (confidence ? MatcherWorkspace::bytes<PeakTracker<Acc>>(dst_width) : 0);
+}
+
+
+/**
+ * @brief Versione vettoriale di \p argMaxCorrMat per immagini a 8 bit.
+ * @note  → Il risultato coincide con \p argMaxCorrMat<uint8_t, Traits>: la somma dei prodotti è calcolata esattamente
+ *          su 32 bit e convertita in \p Traits::accumulator_type prima del confronto, quindi con l'accumulatore
+ *          di default a 8 bit si ottiene lo stesso overflow del riferimento. \n
+ *        → I candidati sono visitati con la stessa colonna crescente e gli stessi pari merito del riferimento,
+ *          quindi anche la mappa di confidenza coincide con quella di \p argMaxCorrMat. \n
+ *
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ *
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   workspace       Memoria di lavoro (vedi \p simdWorkspaceSize )
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ * @param[in]   level           Livello SIMD da usare
+ * @param[out]  confidence      Se non nulla, matrice della confidenza di ogni elemento di \p dst (vedi \p argMaxCorr )
+ * @param[in]   uniqueness_ratio Margine percentuale del test di unicità, 0 lo disabilita
+ *
+ * @return void
+*/
+template <typename Traits = MatchingTraits<std::uint8_t>>
+void argMaxCorrMatSimd(const std::uint8_t               *src1,
+                       const std::uint8_t               *src2,
+                       typename Traits::output_type     *dst,
+                       std::size_t                      width,
+                       std::size_t                      height,
+                       std::size_t                      kernel_size,
+                       stereodepth::MatcherWorkspace    &workspace,
+                       std::int64_t                     min_disparity = DISPARITY_MIN_UNBOUNDED,
+                       std::int64_t                     max_disparity = DISPARITY_MAX_UNBOUNDED,
+                       SimdLevel                        level = simdLevel(),
+                       std::uint8_t                     *confidence = nullptr,
+                       const int                        uniqueness_ratio = 0)
+{
+    static_assert(std::is_same<typename Traits::input_type, std::uint8_t>::value,
+                  "argMaxCorrMatSimd requires 8 bit input");
+
+    using Acc = typename Traits::accumulator_type;
+
+    inputParsing(src1, src2, kernel_size, width);
+    disparityParsing(min_disparity, max_disparity);
+
+    if (!dst) {
+        std::cerr << "Invalid destination matrix" <<
+        "\n→ Line: " << __LINE__ <<
+        "\n→ Function: " << __func__  <<
+        "\n→ File: " << __FILE__ << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    clampDisparityRange(width, kernel_size, min_disparity, max_disparity);
+
+    const std::size_t dst_width = width - (kernel_size - 1);
+    const std::size_t dst_height = height - (kernel_size - 1);
+    const std::int64_t pos = static_cast<std::int64_t>(kernel_size / 2);
+    const std::int64_t last = static_cast<std::int64_t>(width - kernel_size);
+
+    const std::size_t mark = workspace.mark();
+    workspace.reserve(mark + simdWorkspaceSize<Traits>(width, kernel_size, confidence != nullptr));
+
+    std::uint32_t *costs = workspace.allocate<std::uint32_t>(dst_width);
+    std::uint32_t *scratch = workspace.allocate<std::uint32_t>(width);
+    Acc *best = workspace.allocate<Acc>(dst_width);
+    std::size_t *best_idx = workspace.allocate<std::size_t>(dst_width);
+    // Un PeakTracker per colonna: i candidati di ogni pixel arrivano in colonne consecutive
+    PeakTracker<Acc> *peaks = confidence ? workspace.allocate<PeakTracker<Acc>>(dst_width) : nullptr;
+
+    for (std::size_t row = 0; row < dst_height; row++) {
+        std::fill(best, best + dst_width, Acc{0});
+        std::fill(best_idx, best_idx + dst_width, 0);
+        if (peaks) {
+            for (std::size_t x = 0; x < dst_width; x++) {
+                new (peaks + x) PeakTracker<Acc>(Acc{0});
+            }
+        }
+
+        // Disparità decrescenti: colonne candidate crescenti, come in argMaxCorr
+        for (std::int64_t d = max_disparity; d >= min_disparity; d--) {
+            const std::int64_t x_begin = std::max(d, std::int64_t{0});
+            const std::int64_t x_end = std::min(last + d, last) + 1;
+
+            if (x_begin >= x_end) {
+                continue;
+            }
+
+            windowCostsU8(CostFunction::PRODUCT_SUM, src1 + row * width, src2 + row * width,
+                          width, kernel_size, d,
+                          static_cast<std::size_t>(x_begin), static_cast<std::size_t>(x_end),
+                          costs, scratch, level);
+
+            for (std::int64_t x = x_begin; x < x_end; x++) {
+                const Acc cost = static_cast<Acc>(costs[x - x_begin]);
+                if (cost >= best[x]) {
+                    best[x] = cost;
+                    best_idx[x] = static_cast<std::size_t>(x - d + pos - 1);
+                }
+            }
+            if (peaks) {
+                for (std::int64_t x = x_begin; x < x_end; x++) {
+                    peaks[x].update(static_cast<Acc>(costs[x - x_begin]));
+                }
+            }
+        }
+
+        for (std::size_t x = 0; x < dst_width; x++) {
+            *(dst + (row * dst_width) + x) = static_cast<typename Traits::output_type>(best_idx[x]);
+        }
+        if (peaks) {
+            for (std::size_t x = 0; x < dst_width; x++) {
+                *(confidence + (row * dst_width) + x) = peaks[x].confidence(uniqueness_ratio);
+            }
+        }
+    }
+
+    workspace.rewind(mark);
+}
+
+
+/**
+ * @brief Versione di \p argMaxCorrMatSimd con un workspace temporaneo allocato ad ogni chiamata.
+ * @note  Per elaborare più frame senza allocazioni usare la versione con \p MatcherWorkspace.
+ *
+ * @tparam      Traits          Tipi di accumulatore e destinazione (vedi \p MatchingTraits)
+ *
+ * @param[in]   src1            Prima matrice di input
+ * @param[in]   src2            Seconda matrice di input
+ * @param[out]  dst             Matrice destinazione
+ * @param[in]   width           Lunghezza delle due matrici \p src1, \p src2
+ * @param[in]   height          Altezza delle due matrici \p src1, \p src2
+ * @param[in]   kernel_size     Dimensione del kernel
+ * @param[in]   min_disparity   Disparità minima cercata
+ * @param[in]   max_disparity   Disparità massima cercata
+ * @param[in]   level           Livello SIMD da usare
+ * @param[out]  confidence      Se non nulla, matrice della confidenza di ogni elemento di \p dst (vedi \p argMaxCorr )
+ * @param[in]   uniqueness_ratio Margine percentuale del test di unicità, 0 lo disabilita
+ *
+ * @return void
+*/
+template <typename Traits = MatchingTraits<std::uint8_t>>
+void argMaxCorrMatSimd(const std::uint8_t   *src1,
+                       const std::uint8_t   *src2,
+                       typename Traits::output_type *dst,
+                       std::size_t          width,
+                       std::size_t          height,
+                       std::size_t          kernel_size,
+                       std::int64_t         min_disparity = DISPARITY_MIN_UNBOUNDED,
+                       std::int64_t         max_disparity = DISPARITY_MAX_UNBOUNDED,
+                       SimdLevel            level = simdLevel(),
+                       std::uint8_t         *confidence = nullptr,
+                       const int            uniqueness_ratio = 0)
+{
+    stereodepth::MatcherWorkspace workspace;
+    argMaxCorrMatSimd<Traits>(src1, src2, dst, width, height, kernel_size, workspace, min_disparity, max_disparity, level,
+                              confidence, uniqueness_ratio);
+}
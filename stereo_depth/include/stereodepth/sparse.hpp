@@ -0,0 +1,246 @@
+/***************************************************************************
+ *            sparse.hpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+
+/*! \file  sparse.hpp
+ *  \brief Disparity of regions and points, matched on demand tile by tile.
+ */
+
+#include "type.hpp"
+#include "tiled.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#ifndef STEREODEPTH_SPARSE_HPP
+#define STEREODEPTH_SPARSE_HPP
+
+namespace stereodepth {
+
+/// Side of the tiles of a SparseMatcher when TileConfig leaves it to zero.
+constexpr SizeType SPARSE_TILE_SIZE = 16;
+
+/// A pixel of the destination matrix.
+struct PointQuery
+{
+    SizeType row;
+    SizeType col;
+};
+
+/**
+ * \brief Matcher for callers that need the disparity of a few points or
+ * boxes per frame rather than the whole map.
+ *
+ * A query matches only the tiles it touches, the first time they are
+ * touched in the frame; later queries on the same tiles read the cached
+ * result. The cost of a frame is therefore proportional to the area of the
+ * tiles covered by the queries, not to the size of the image. Tiles are
+ * small by default (SPARSE_TILE_SIZE) so that a point query costs little
+ * more than the pixel itself. begin_frame() invalidates the cache in
+ * constant time. Coordinates are those of the destination matrix of
+ * argMaxCorrMat, whose values the queries return.
+ *
+ * Not thread safe: a SparseMatcher serves one caller at a time.
+ * \tparam T      Type of the source matrices.
+ * \tparam Traits Accumulator and destination types (see MatchingTraits).
+ */
+template <typename T, typename Traits = MatchingTraits<T>>
+class SparseMatcher
+{
+public:
+    using output_type = typename Traits::output_type;
+
+    /**
+     * \param width         Width of the source matrices.
+     * \param height        Height of the source matrices.
+     * \param kernel_size   Size of the matching window.
+     * \param min_disparity Minimum disparity searched.
+     * \param max_disparity Maximum disparity searched.
+     * \param config        Tile shape; zero sides are SPARSE_TILE_SIZE.
+     */
+    SparseMatcher(SizeType width, SizeType height, SizeType kernel_size,
+                  std::int64_t min_disparity = DISPARITY_MIN_UNBOUNDED,
+                  std::int64_t max_disparity = DISPARITY_MAX_UNBOUNDED,
+                  TileConfig config = TileConfig())
+        : _tiled{width, height, kernel_size, min_disparity, max_disparity,
+                 sparse_config(config)}
+        , _src1{nullptr}
+        , _src2{nullptr}
+        , _frame{0}
+        , _computed{0}
+        , _tiles_per_row{0}
+    {
+        if (!_tiled.valid()) return;
+        const auto& plan = _tiled.plan();
+        _tiles_per_row = (plan.output_width() + _tiled.tile_width() - 1)
+                         / _tiled.tile_width();
+        _cache.resize(plan.output_width() * plan.output_height());
+        _stamp.resize(_tiled.tiles().size(), 0);
+    }
+
+    PlanStatus status() const { return _tiled.status(); }
+    bool valid() const { return _tiled.valid(); }
+    const TiledMatcher<T, Traits>& tiled() const { return _tiled; }
+
+    /// Tiles matched since the last begin_frame().
+    SizeType computed_tiles() const { return _computed; }
+
+    /**
+     * \brief Bind the sources of a new frame and drop the cached tiles.
+     * The sources must stay valid until the next begin_frame().
+     * \return OK, INVALID_PLAN or NULL_POINTER.
+     */
+    PlanStatus begin_frame(const T* src1, const T* src2)
+    {
+        if (!valid()) return PlanStatus::INVALID_PLAN;
+        if (!src1 || !src2) return PlanStatus::NULL_POINTER;
+        _src1 = src1;
+        _src2 = src2;
+        _computed = 0;
+        // A stamp of zero never matches: wrap around by clearing.
+        if (++_frame == 0)
+        {
+            std::fill(_stamp.begin(), _stamp.end(), 0);
+            _frame = 1;
+        }
+        return PlanStatus::OK;
+    }
+
+    /**
+     * \brief Disparity of a single destination pixel.
+     * \param row   Destination row.
+     * \param col   Destination column.
+     * \param value The disparity, as argMaxCorrMat.
+     * \return OK, INVALID_PLAN, NULL_POINTER (no frame) or INVALID_QUERY.
+     */
+    PlanStatus query_point(SizeType row, SizeType col, output_type& value)
+    {
+        const PlanStatus status = check(row, row + 1, col, col + 1);
+        if (status != PlanStatus::OK) return status;
+        ensure(tile_index(row, col));
+        value = _cache[row * _tiled.plan().output_width() + col];
+        return PlanStatus::OK;
+    }
+
+    /**
+     * \brief Disparity of a list of destination pixels.
+     * \param points The pixels.
+     * \param count  Number of pixels.
+     * \param values count disparities, in the order of points.
+     * \return OK, INVALID_PLAN, NULL_POINTER or INVALID_QUERY; values is
+     *         untouched on error.
+     */
+    PlanStatus query_points(const PointQuery* points, SizeType count,
+                            output_type* values)
+    {
+        if (count == 0) return valid() ? PlanStatus::OK : PlanStatus::INVALID_PLAN;
+        if (!points || !values) return valid() ? PlanStatus::NULL_POINTER
+                                                : PlanStatus::INVALID_PLAN;
+        for (SizeType i = 0; i < count; ++i)
+        {
+            const PlanStatus status = check(points[i].row, points[i].row + 1,
+                                            points[i].col, points[i].col + 1);
+            if (status != PlanStatus::OK) return status;
+        }
+        const SizeType dst_width = _tiled.plan().output_width();
+        for (SizeType i = 0; i < count; ++i)
+        {
+            ensure(tile_index(points[i].row, points[i].col));
+            values[i] = _cache[points[i].row * dst_width + points[i].col];
+        }
+        return PlanStatus::OK;
+    }
+
+    /**
+     * \brief Disparity of the destination rectangle [row_begin, row_end) x
+     * [col_begin, col_end).
+     * \param dst        Rectangle of (row_end - row_begin) rows.
+     * \param dst_stride Elements between two rows of dst, at least
+     *                   col_end - col_begin.
+     * \return OK, INVALID_PLAN, NULL_POINTER or INVALID_QUERY; dst is
+     *         untouched on error.
+     */
+    PlanStatus query_region(SizeType row_begin, SizeType row_end,
+                            SizeType col_begin, SizeType col_end,
+                            output_type* dst, SizeType dst_stride)
+    {
+        const PlanStatus status = check(row_begin, row_end, col_begin, col_end);
+        if (status != PlanStatus::OK) return status;
+        if (!dst) return PlanStatus::NULL_POINTER;
+        if (dst_stride < col_end - col_begin) return PlanStatus::INVALID_QUERY;
+        if (row_begin == row_end || col_begin == col_end) return PlanStatus::OK;
+
+        const SizeType tile_width = _tiled.tile_width();
+        const SizeType tile_height = _tiled.tile_height();
+        for (SizeType r = row_begin / tile_height; r <= (row_end - 1) / tile_height; ++r)
+        {
+            for (SizeType c = col_begin / tile_width; c <= (col_end - 1) / tile_width; ++c)
+            {
+                ensure(r * _tiles_per_row + c);
+            }
+        }
+
+        const SizeType dst_width = _tiled.plan().output_width();
+        for (SizeType row = row_begin; row < row_end; ++row)
+        {
+            const output_type* src = _cache.data() + row * dst_width;
+            std::copy(src + col_begin, src + col_end,
+                      dst + (row - row_begin) * dst_stride);
+        }
+        return PlanStatus::OK;
+    }
+
+private:
+    static TileConfig sparse_config(TileConfig config)
+    {
+        if (!config.tile_width) config.tile_width = SPARSE_TILE_SIZE;
+        if (!config.tile_height) config.tile_height = SPARSE_TILE_SIZE;
+        return config;
+    }
+
+    PlanStatus check(SizeType row_begin, SizeType row_end,
+                     SizeType col_begin, SizeType col_end) const
+    {
+        if (!valid()) return PlanStatus::INVALID_PLAN;
+        if (!_src1 || !_src2) return PlanStatus::NULL_POINTER;
+        const auto& plan = _tiled.plan();
+        if (row_begin > row_end || row_end > plan.output_height()
+            || col_begin > col_end || col_end > plan.output_width())
+        {
+            return PlanStatus::INVALID_QUERY;
+        }
+        return PlanStatus::OK;
+    }
+
+    SizeType tile_index(SizeType row, SizeType col) const
+    {
+        return (row / _tiled.tile_height()) * _tiles_per_row
+               + col / _tiled.tile_width();
+    }
+
+    void ensure(SizeType index)
+    {
+        if (_stamp[index] == _frame) return;
+        _tiled.execute_tile(_src1, _src2, _cache.data(), index);
+        _stamp[index] = _frame;
+        ++_computed;
+    }
+
+    TiledMatcher<T, Traits> _tiled;
+    const T* _src1;
+    const T* _src2;
+    std::uint32_t _frame;
+    SizeType _computed;
+    SizeType _tiles_per_row;
+    std::vector<output_type> _cache;
+    std::vector<std::uint32_t> _stamp;
+};
+
+} // namespace stereodepth
+
+#endif // STEREODEPTH_SPARSE_HPP
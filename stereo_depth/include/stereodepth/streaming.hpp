@@ -0,0 +1,142 @@
+/***************************************************************************
+ *            streaming.hpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+
+/*! \file  streaming.hpp
+ *  \brief Push-style matcher fed one rectified row at a time.
+ */
+
+#include "type.hpp"
+#include "cross_correlation.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <stdexcept>
+#include <vector>
+
+#ifndef STEREODEPTH_STREAMING_HPP
+#define STEREODEPTH_STREAMING_HPP
+
+namespace stereodepth {
+
+/**
+ * \brief Cross-correlation matcher that consumes the rows of the two images
+ * as they are delivered and emits each disparity row as soon as its K
+ * source rows are available.
+ *
+ * Only the last K rows of each image are kept. Every row is written twice
+ * in a ring of 2K rows, at slots n % K and n % K + K, so the last K rows
+ * are always contiguous in memory and are matched by
+ * argMaxCorrVectorDispatch exactly as argMaxCorrMat does: the emitted rows
+ * are bit-identical to the rows of argMaxCorrMat on the whole images, with
+ * O(K x width) memory and a latency of one row.
+ * \tparam T      Type of the source rows.
+ * \tparam Traits Accumulator and destination types (see MatchingTraits).
+ */
+template <typename T, typename Traits = MatchingTraits<T>>
+class StreamingMatcher
+{
+public:
+    using output_type = typename Traits::output_type;
+
+    /**
+     * \param width         Width of the source rows.
+     * \param kernel_size   Size of the matching window.
+     * \param min_disparity Minimum disparity searched.
+     * \param max_disparity Maximum disparity searched.
+     * \throw std::invalid_argument if kernel_size is even or smaller than
+     *        KERNEL_LIMIT, width is smaller than kernel_size or the
+     *        disparity range is empty.
+     */
+    StreamingMatcher(SizeType width, SizeType kernel_size,
+                     std::int64_t min_disparity = DISPARITY_MIN_UNBOUNDED,
+                     std::int64_t max_disparity = DISPARITY_MAX_UNBOUNDED)
+        : _width{width}
+        , _kernel_size{kernel_size}
+        , _min_disparity{min_disparity}
+        , _max_disparity{max_disparity}
+        , _rows_pushed{0}
+        , _ring1(2 * kernel_size * width)
+        , _ring2(2 * kernel_size * width)
+    {
+        if (kernel_size < KERNEL_LIMIT || kernel_size % 2 == 0)
+        {
+            throw std::invalid_argument(
+                "StreamingMatcher: kernel_size must be odd and >= KERNEL_LIMIT");
+        }
+        if (width < kernel_size)
+        {
+            throw std::invalid_argument(
+                "StreamingMatcher: width must be >= kernel_size");
+        }
+        if (max_disparity < min_disparity)
+        {
+            throw std::invalid_argument(
+                "StreamingMatcher: max_disparity must be >= min_disparity");
+        }
+    }
+
+    /**
+     * \brief Add the next row of both images.
+     * \param row1 Next row of the first image, width elements.
+     * \param row2 Next row of the second image, width elements.
+     * \param dst  Destination of output_width() elements, written when a
+     *             disparity row becomes computable.
+     * \return True if dst has been written with disparity row
+     *         rows_emitted() - 1.
+     * \throw std::invalid_argument if a pointer is null.
+     */
+    bool push(const T* row1, const T* row2, output_type* dst)
+    {
+        if (!row1 || !row2 || !dst)
+        {
+            throw std::invalid_argument("StreamingMatcher: null row");
+        }
+        const SizeType slot = _rows_pushed % _kernel_size;
+        for (SizeType copy : {slot, slot + _kernel_size})
+        {
+            std::copy(row1, row1 + _width, _ring1.data() + copy * _width);
+            std::copy(row2, row2 + _width, _ring2.data() + copy * _width);
+        }
+        ++_rows_pushed;
+        if (_rows_pushed < _kernel_size) return false;
+
+        // The oldest of the last K rows is in the slot written next.
+        const SizeType first = (_rows_pushed % _kernel_size) * _width;
+        argMaxCorrVectorDispatch<T, Traits>(
+            _ring1.data() + first, _ring2.data() + first, dst,
+            _kernel_size, _width, _min_disparity, _max_disparity);
+        return true;
+    }
+
+    /// Forget the pushed rows, to start a new frame.
+    void reset() { _rows_pushed = 0; }
+
+    [[nodiscard]] SizeType width() const { return _width; }
+    [[nodiscard]] SizeType kernel_size() const { return _kernel_size; }
+    [[nodiscard]] SizeType output_width() const
+    { return _width - (_kernel_size - 1); }
+    [[nodiscard]] SizeType rows_pushed() const { return _rows_pushed; }
+    [[nodiscard]] SizeType rows_emitted() const
+    {
+        return _rows_pushed < _kernel_size ? 0
+            : _rows_pushed - (_kernel_size - 1);
+    }
+
+private:
+    SizeType _width;
+    SizeType _kernel_size;
+    std::int64_t _min_disparity;
+    std::int64_t _max_disparity;
+    SizeType _rows_pushed;
+    std::vector<T> _ring1;
+    std::vector<T> _ring2;
+};
+
+} // namespace stereodepth
+
+#endif // STEREODEPTH_STREAMING_HPP
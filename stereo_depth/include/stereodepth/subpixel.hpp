@@ -0,0 +1,212 @@
+/***************************************************************************
+ *            subpixel.hpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+
+/*! \file  subpixel.hpp
+ *  \brief Winner-takes-all with subpixel refinement and fixed point output.
+ */
+
+#include "type.hpp"
+#include "cost_volume.hpp"
+#include "cross_correlation.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+#ifndef STEREODEPTH_SUBPIXEL_HPP
+#define STEREODEPTH_SUBPIXEL_HPP
+
+namespace stereodepth {
+
+/// Fractional bits of the fixed point disparity maps.
+constexpr int DISPARITY_SHIFT = 4;
+/// Fixed point disparities are disparity x 16, as the CV_16S output of
+/// cv::StereoBM used in disparity_map.
+constexpr std::int16_t DISPARITY_SCALE = 1 << DISPARITY_SHIFT;
+/// Largest |disparity| whose fixed point value, refined by up to half a
+/// pixel, fits the int16 output: 2047.
+constexpr std::int64_t DISPARITY_FIXED_MAX =
+    (std::numeric_limits<std::int16_t>::max() - DISPARITY_SCALE / 2) / DISPARITY_SCALE;
+
+/// Whether the best candidate has the highest or the lowest cost.
+enum class CostOrder {
+    MAXIMIZE, ///< Similarity costs (cross-correlation).
+    MINIMIZE  ///< Dissimilarity costs (census, SAD, SGM).
+};
+
+/// Curve fitted to the best cost and its two neighbours.
+enum class SubpixelFit {
+    NONE,       ///< Integer disparities.
+    PARABOLA,   ///< Quadratic costs (correlation, SSD, SGM).
+    EQUIANGULAR ///< Linear costs (SAD, census).
+};
+
+/**
+ * \brief Value written for pixels without candidates: (min_disparity - 1)
+ * x 16, as cv::StereoBM does.
+ * \param volume The cost volume.
+ * \return The invalid fixed point disparity.
+ */
+template <typename T>
+std::int16_t invalid_disparity(const CostVolume<T>& volume)
+{
+    const auto value = (volume.min_disparity() - 1) * DISPARITY_SCALE;
+    return static_cast<std::int16_t>(std::max<std::int64_t>(
+        value, std::numeric_limits<std::int16_t>::min()));
+}
+
+/**
+ * \brief Throw unless every disparity of the volume fits the fixed point
+ * int16 output, i.e. lies within +-DISPARITY_FIXED_MAX.
+ * \param volume The cost volume.
+ * \param caller Name of the function, prefixed to the message.
+ * \throw std::invalid_argument if the range of the volume is too wide.
+ */
+template <typename T>
+void check_fixed_point_range(const CostVolume<T>& volume, const char* caller)
+{
+    if (volume.min_disparity() < -DISPARITY_FIXED_MAX
+        || volume.max_disparity() > DISPARITY_FIXED_MAX)
+    {
+        throw std::invalid_argument(
+            std::string(caller) + ": disparities would overflow 16 bits");
+    }
+}
+
+/**
+ * \brief Offset in (-0.5, 0.5) of the extremum of the curve through the
+ * costs of the best disparity and of its two neighbours.
+ * \param prev  Cost of the best disparity - 1.
+ * \param best  Cost of the best disparity.
+ * \param next  Cost of the best disparity + 1.
+ * \param order Whether the best cost is a maximum or a minimum.
+ * \param fit   Curve to fit.
+ * \return The offset to add to the best disparity.
+ */
+inline double subpixel_offset(double prev, double best, double next,
+                              CostOrder order, SubpixelFit fit)
+{
+    double offset = 0.0;
+    if (fit == SubpixelFit::PARABOLA)
+    {
+        const double den = 2.0 * (prev - 2.0 * best + next);
+        if (den != 0.0) offset = (prev - next) / den;
+    }
+    else if (fit == SubpixelFit::EQUIANGULAR)
+    {
+        const double den = order == CostOrder::MINIMIZE
+            ? 2.0 * (std::max(prev, next) - best)
+            : 2.0 * (best - std::min(prev, next));
+        if (den != 0.0)
+        {
+            offset = order == CostOrder::MINIMIZE
+                ? (prev - next) / den : (next - prev) / den;
+        }
+    }
+    return std::min(std::max(offset, -0.5), 0.5);
+}
+
+/**
+ * \brief Winner-takes-all disparity of each pixel of the volume, refined to
+ * subpixel precision from the costs already in the volume.
+ *
+ * The best candidate is selected as winner_takes_all (MAXIMIZE) or
+ * winner_takes_min (MINIMIZE) do. When both neighbouring disparities are
+ * valid candidates a curve is fitted to the three costs and the disparity
+ * of its extremum is written in fixed point, disparity x DISPARITY_SCALE.
+ * Unlike the argMaxCorr index, the output is the disparity d = x - j
+ * between the window x of the second matrix and the window j of the first.
+ * Costs should not wrap: use a wide accumulator for correlation volumes.
+ *
+ * When confidence is given, the same scan also tracks the second best cost
+ * outside the +-1 neighbourhood of the best one (see PeakTracker) and writes
+ * its peak ratio confidence; pixels failing the uniqueness test, or without
+ * candidates, get 0 and can be skipped downstream.
+ * \tparam T              Type of the costs.
+ * \param dst             Destination matrix of shape height x width of the volume.
+ * \param volume          The cost volume.
+ * \param order           Whether the best cost is a maximum or a minimum.
+ * \param fit             Curve fitted around the best disparity.
+ * \param confidence      Optional confidence matrix of the same shape as dst.
+ * \param uniqueness_ratio Margin in percent of the uniqueness test of
+ *                        cv::StereoBM, 0 disables it.
+ * \return The pointer to the destination matrix.
+ * \throw std::invalid_argument if the disparity range of the volume exceeds
+ *        +-DISPARITY_FIXED_MAX, so that the fixed point output would wrap;
+ *        limit the range of wide images before building the volume.
+ */
+template <typename T>
+std::int16_t* subpixel_disparity(std::int16_t* dst, const CostVolume<T>& volume,
+                                 CostOrder order,
+                                 SubpixelFit fit = SubpixelFit::PARABOLA,
+                                 std::uint8_t* confidence = nullptr,
+                                 int uniqueness_ratio = 0)
+{
+    check_fixed_point_range(volume, "subpixel_disparity");
+
+    const auto width = static_cast<std::int64_t>(volume.width());
+    const auto d_stride = volume.disparity_stride();
+    const std::int16_t invalid = invalid_disparity(volume);
+    // Never better than a candidate, so the first one is always taken.
+    const T worst = order == CostOrder::MAXIMIZE
+        ? std::numeric_limits<T>::lowest() : std::numeric_limits<T>::max();
+    for (SizeType row = 0; row < volume.height(); ++row)
+    {
+        for (SizeType col = 0; col < volume.width(); ++col)
+        {
+            const auto x = static_cast<std::int64_t>(col);
+            const auto n_begin = std::max(x - width + 1 - volume.min_disparity(),
+                                          std::int64_t{0});
+            const auto n_end = std::min(x - volume.min_disparity() + 1,
+                static_cast<std::int64_t>(volume.disparities()));
+            const T* costs = volume.data() + volume.index(row, col, 0);
+            std::int16_t& out = dst[row * volume.width() + col];
+
+            if (n_begin >= n_end)
+            {
+                out = invalid;
+                if (confidence) confidence[row * volume.width() + col] = 0;
+                continue;
+            }
+
+            PeakTracker<T> peak(worst, order == CostOrder::MAXIMIZE);
+            for (auto n = n_end - 1; n >= n_begin; --n)
+            {
+                peak.update(costs[static_cast<SizeType>(n) * d_stride]);
+            }
+            const auto best_n = n_end - 1 - static_cast<std::int64_t>(peak.best_pos);
+            if (confidence)
+            {
+                confidence[row * volume.width() + col] = peak.confidence(uniqueness_ratio);
+            }
+
+            double offset = 0.0;
+            if (fit != SubpixelFit::NONE && best_n > n_begin && best_n + 1 < n_end)
+            {
+                const auto n = static_cast<SizeType>(best_n);
+                offset = subpixel_offset(
+                    static_cast<double>(costs[(n - 1) * d_stride]),
+                    static_cast<double>(costs[n * d_stride]),
+                    static_cast<double>(costs[(n + 1) * d_stride]),
+                    order, fit);
+            }
+
+            const auto d = volume.disparity(static_cast<SizeType>(best_n));
+            out = static_cast<std::int16_t>(d * DISPARITY_SCALE
+                + static_cast<std::int64_t>(std::lround(offset * DISPARITY_SCALE)));
+        }
+    }
+    return dst;
+}
+
+} // namespace stereodepth
+
+#endif // STEREODEPTH_SUBPIXEL_HPP
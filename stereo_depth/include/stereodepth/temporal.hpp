@@ -0,0 +1,261 @@
+/***************************************************************************
+ *            temporal.hpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+
+/*! \file  temporal.hpp
+ *  \brief Matcher seeded by the disparity of the previous video frame.
+ */
+
+#include "type.hpp"
+#include "cross_correlation.hpp"
+#include "plan.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+#ifndef STEREODEPTH_TEMPORAL_HPP
+#define STEREODEPTH_TEMPORAL_HPP
+
+namespace stereodepth {
+
+/// Parameters of the temporal seeding.
+struct TemporalConfig
+{
+    /// Half width of the search around the previous disparity.
+    std::int64_t delta = 2;
+    /// Pixels below this confidence (see PeakTracker) are searched in full.
+    std::uint8_t min_confidence = 32;
+    /// Pixels whose window of the second source changed by more than this
+    /// mean absolute difference are searched in full.
+    double max_change = 4.0;
+    /// Uniqueness ratio of the confidence, 0 disables the test.
+    int uniqueness_ratio = 0;
+};
+
+/**
+ * \brief Cross-correlation matcher for a video stream from a static rig.
+ *
+ * The first frame, and every frame after reset(), is matched over the full
+ * disparity range. Afterwards each pixel is searched only within
+ * [d - delta, d + delta] of its disparity d in the previous frame, unless
+ * - its confidence in the previous frame was below min_confidence, or
+ * - its window of the second source changed by more than max_change, or
+ * - the seeded best lands on the border of the narrow window, so the peak
+ *   may lie outside it;
+ * then the full range is searched. Every search runs the row kernel of the
+ * plan with its confidence output (see PeakTracker). The confidence of a
+ * seeded pixel is the minimum between the previous one and the one of the
+ * narrow search, so it decays until a full search refreshes it. On a slowly
+ * changing scene most pixels search 2 delta + 1 candidates instead of the
+ * whole range.
+ * \tparam T      Type of the source matrices.
+ * \tparam Traits Accumulator and destination types (see MatchingTraits); the
+ *                accumulator must be wider than T, since a wrapping one
+ *                makes the confidence, and so min_confidence, meaningless.
+ */
+template <typename T, typename Traits = WideMatchingTraits<T>>
+class TemporalMatcher
+{
+public:
+    using output_type = typename Traits::output_type;
+    using accumulator_type = typename Traits::accumulator_type;
+
+    static_assert(std::is_floating_point<accumulator_type>::value
+                  || sizeof(accumulator_type) > sizeof(T),
+                  "TemporalMatcher needs an accumulator wider than the source type");
+
+    /**
+     * \param width         Width of the source matrices.
+     * \param height        Height of the source matrices.
+     * \param kernel_size   Size of the matching window.
+     * \param min_disparity Minimum disparity searched.
+     * \param max_disparity Maximum disparity searched.
+     * \param config        Seeding parameters.
+     */
+    TemporalMatcher(SizeType width, SizeType height, SizeType kernel_size,
+                    std::int64_t min_disparity = DISPARITY_MIN_UNBOUNDED,
+                    std::int64_t max_disparity = DISPARITY_MAX_UNBOUNDED,
+                    TemporalConfig config = TemporalConfig())
+        : _plan{width, height, kernel_size, min_disparity, max_disparity}
+        , _config{config}
+        , _has_history{false}
+        , _seeded_pixels{0}
+    {
+        if (!_plan.valid()) return;
+        _config.delta = std::max<std::int64_t>(_config.delta, 0);
+        const SizeType dst_size = _plan.output_width() * _plan.output_height();
+        _previous.resize(width * height);
+        _disparity.resize(dst_size);
+        _confidence.resize(dst_size);
+    }
+
+    PlanStatus status() const { return _plan.status(); }
+    bool valid() const { return _plan.valid(); }
+    const StereoMatcherPlan<T, Traits>& plan() const { return _plan; }
+    const TemporalConfig& config() const { return _config; }
+
+    /// True once a frame has been matched since construction or reset().
+    bool has_history() const { return _has_history; }
+
+    /// Pixels of the last frame searched around the previous disparity.
+    SizeType seeded_pixels() const { return _seeded_pixels; }
+
+    /// Forget the previous frame: the next one is searched in full.
+    void reset()
+    {
+        _has_history = false;
+        _seeded_pixels = 0;
+    }
+
+    /**
+     * \brief Match the next frame of the stream.
+     * \param src1       First source matrix, height x width.
+     * \param src2       Second source matrix, height x width.
+     * \param dst        Destination matrix, as StereoMatcherPlan::execute.
+     * \param confidence Optional confidence matrix of the same size.
+     * \return OK, INVALID_PLAN or NULL_POINTER; nothing is touched on error.
+     */
+    PlanStatus execute(const T* src1, const T* src2, output_type* dst,
+                       std::uint8_t* confidence = nullptr)
+    {
+        if (!valid()) return PlanStatus::INVALID_PLAN;
+        if (!src1 || !src2 || !dst) return PlanStatus::NULL_POINTER;
+        const SizeType seeded = match_rows(src1, src2, dst, confidence,
+                                           0, _plan.output_height());
+        finish(src2, seeded);
+        return PlanStatus::OK;
+    }
+
+    /**
+     * \brief As execute, with bands of rows in parallel on pool.
+     */
+    PlanStatus execute(const T* src1, const T* src2, output_type* dst,
+                       std::uint8_t* confidence, ThreadPool& pool)
+    {
+        if (!valid()) return PlanStatus::INVALID_PLAN;
+        if (!src1 || !src2 || !dst) return PlanStatus::NULL_POINTER;
+        std::atomic<SizeType> seeded{0};
+        pool.parallel_for(0, _plan.output_height(), 0,
+                          [&](SizeType row_begin, SizeType row_end) {
+            seeded += match_rows(src1, src2, dst, confidence, row_begin, row_end);
+        });
+        finish(src2, seeded.load());
+        return PlanStatus::OK;
+    }
+
+private:
+    SizeType match_rows(const T* src1, const T* src2, output_type* dst,
+                        std::uint8_t* confidence,
+                        SizeType row_begin, SizeType row_end)
+    {
+        const SizeType width = _plan.width();
+        const SizeType kernel_size = _plan.kernel_size();
+        const SizeType dst_width = _plan.output_width();
+        const std::int64_t pos = static_cast<std::int64_t>(kernel_size / 2);
+        const std::int64_t min_d = _plan.min_disparity();
+        const std::int64_t max_d = _plan.max_disparity();
+        const double max_change = _config.max_change
+                                  * static_cast<double>(kernel_size * kernel_size);
+        SizeType seeded = 0;
+
+        for (SizeType row = row_begin; row < row_end; ++row)
+        {
+            const T* row2 = src2 + row * width;
+            const SizeType offset = row * dst_width;
+            if (!_has_history)
+            {
+                _plan.match_span(src1, src2, dst, row, 0, dst_width, min_d, max_d,
+                                 _confidence.data(), _config.uniqueness_ratio);
+            }
+            for (SizeType x = 0; x < dst_width; ++x)
+            {
+                const SizeType idx = offset + x;
+                const std::uint8_t previous = _confidence[idx];
+
+                if (_has_history)
+                {
+                    bool done = false;
+                    if (previous >= _config.min_confidence
+                        && window_change(row2, _previous.data() + row * width, x) <= max_change)
+                    {
+                        const std::int64_t lo = std::max(_disparity[idx] - _config.delta, min_d);
+                        const std::int64_t hi = std::min(_disparity[idx] + _config.delta, max_d);
+                        _plan.match_span(src1, src2, dst, row, x, x + 1, lo, hi,
+                                         _confidence.data(), _config.uniqueness_ratio);
+                        const std::int64_t d = to_disparity(x, pos, dst[idx]);
+                        const std::uint8_t conf = _confidence[idx];
+                        // A peak on a border that is not the one of the full
+                        // range may be the slope of a peak outside the window.
+                        done = conf > 0 && (d != lo || lo == min_d) && (d != hi || hi == max_d);
+                        if (done)
+                        {
+                            _confidence[idx] = std::min(conf, previous);
+                            ++seeded;
+                        }
+                    }
+                    if (!done)
+                    {
+                        _plan.match_span(src1, src2, dst, row, x, x + 1, min_d, max_d,
+                                         _confidence.data(), _config.uniqueness_ratio);
+                    }
+                }
+
+                _disparity[idx] = to_disparity(x, pos, dst[idx]);
+                if (confidence) confidence[idx] = _confidence[idx];
+            }
+        }
+        return seeded;
+    }
+
+    /// Sum of absolute differences between the current and the previous
+    /// window of the second source at column x.
+    double window_change(const T* current, const T* previous, SizeType x) const
+    {
+        const SizeType width = _plan.width();
+        const SizeType kernel_size = _plan.kernel_size();
+        double sum = 0.0;
+        for (SizeType j = 0; j < kernel_size; ++j)
+        {
+            for (SizeType k = 0; k < kernel_size; ++k)
+            {
+                const double a = static_cast<double>(current[j * width + x + k]);
+                const double b = static_cast<double>(previous[j * width + x + k]);
+                sum += a > b ? a - b : b - a;
+            }
+        }
+        return sum;
+    }
+
+    /// Disparity of the index returned by argMaxCorr for column x.
+    static std::int64_t to_disparity(SizeType x, std::int64_t pos, output_type best)
+    {
+        return static_cast<std::int64_t>(x) + pos - 1 - static_cast<std::int64_t>(best);
+    }
+
+    void finish(const T* src2, SizeType seeded)
+    {
+        std::copy(src2, src2 + _previous.size(), _previous.begin());
+        _has_history = true;
+        _seeded_pixels = seeded;
+    }
+
+    StereoMatcherPlan<T, Traits> _plan;
+    TemporalConfig _config;
+    bool _has_history;
+    SizeType _seeded_pixels;
+    std::vector<T> _previous;
+    std::vector<std::int64_t> _disparity;
+    std::vector<std::uint8_t> _confidence;
+};
+
+} // namespace stereodepth
+
+#endif // STEREODEPTH_TEMPORAL_HPP
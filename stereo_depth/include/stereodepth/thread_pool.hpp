@@ -0,0 +1,111 @@
+/***************************************************************************
+ *            thread_pool.hpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+
+/*! \file  thread_pool.hpp
+ *  \brief Persistent work-stealing thread pool shared by the CPU stages.
+ */
+
+#include "type.hpp"
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef STEREODEPTH_THREAD_POOL_HPP
+#define STEREODEPTH_THREAD_POOL_HPP
+
+namespace stereodepth {
+
+/**
+ * \brief Pool of worker threads that lives across frames.
+ *
+ * parallel_for splits a range of indices (row bands, tiles, ...) in chunks
+ * and deals them in contiguous blocks to per-thread deques. Each thread
+ * takes its own chunks from the front, in order, and when its deque is
+ * empty steals from the back of the others, so a thread that drew cheap
+ * chunks helps the ones that drew expensive ones. The calling thread takes
+ * part in the work as thread 0.
+ *
+ * Concurrent parallel_for calls from different threads are serialized; a
+ * parallel_for issued from inside a chunk runs inline on the calling
+ * worker. An exception thrown by a chunk is rethrown by parallel_for once
+ * every chunk has completed.
+ */
+class ThreadPool
+{
+public:
+    /// Body of a parallel_for, called on the chunk [begin, end).
+    using RangeFunction = std::function<void(SizeType begin, SizeType end)>;
+
+    /**
+     * \param num_threads Number of threads taking part in the work, the
+     *                    caller included; 0 means the hardware concurrency.
+     */
+    explicit ThreadPool(SizeType num_threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /// Threads taking part in the work, the caller included.
+    SizeType num_threads() const { return _queues.size(); }
+
+    /**
+     * \brief Call body on chunks covering [begin, end) exactly once, in
+     * parallel, and return when all of them have completed.
+     * \param begin First index.
+     * \param end   Index after the last one.
+     * \param grain Indices per chunk; 0 picks about four chunks per thread.
+     * \param body  Function called on each chunk.
+     */
+    void parallel_for(SizeType begin, SizeType end, SizeType grain,
+                      const RangeFunction& body);
+
+    /// Pool with one thread per hardware thread, created on first use.
+    static ThreadPool& global();
+
+private:
+    struct Job;
+
+    struct Task
+    {
+        Job* job;
+        SizeType begin;
+        SizeType end;
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void worker(SizeType index);
+    bool pop(SizeType index, Task& task);
+    bool steal(SizeType index, Task& task);
+    void run(const Task& task);
+    void drain(SizeType index);
+
+    std::vector<std::unique_ptr<Queue>> _queues;
+    std::vector<std::thread> _workers;
+    std::mutex _submit;
+    std::mutex _mutex;
+    std::condition_variable _wake;
+    std::condition_variable _done;
+    std::uint64_t _generation;
+    bool _stop;
+};
+
+} // namespace stereodepth
+
+#endif // STEREODEPTH_THREAD_POOL_HPP
@@ -0,0 +1,301 @@
+/***************************************************************************
+ *            tiled.hpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+
+/*! \file  tiled.hpp
+ *  \brief Cache-blocked execution of a StereoMatcherPlan.
+ */
+
+#include "type.hpp"
+#include "plan.hpp"
+#include "thread_pool.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#endif
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#ifndef STEREODEPTH_TILED_HPP
+#define STEREODEPTH_TILED_HPP
+
+namespace stereodepth {
+
+/// Cache size assumed when the L2 size cannot be queried.
+constexpr SizeType DEFAULT_TILE_CACHE_BYTES = 256 * 1024;
+
+/// Narrowest tile derived from the cache size, unless the output is narrower.
+constexpr SizeType MIN_TILE_WIDTH = 16;
+
+/// Block of destination pixels, rows [row_begin, row_end) and columns
+/// [col_begin, col_end).
+struct Tile
+{
+    SizeType row_begin;
+    SizeType row_end;
+    SizeType col_begin;
+    SizeType col_end;
+};
+
+/// Tiling parameters; a zero field is derived.
+struct TileConfig
+{
+    SizeType tile_width = 0;   ///< Destination columns per tile.
+    SizeType tile_height = 0;  ///< Destination rows per tile.
+    SizeType cache_bytes = 0;  ///< Budget of a tile working set, L2 if zero.
+    SizeType num_threads = 0;  ///< OpenMP threads, all available if zero.
+};
+
+/**
+ * \brief Size of the L2 cache of the machine.
+ * \return The size in bytes, DEFAULT_TILE_CACHE_BYTES if unknown.
+ */
+inline SizeType default_cache_bytes()
+{
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    const long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+    if (size > 0) return static_cast<SizeType>(size);
+#endif
+    return DEFAULT_TILE_CACHE_BYTES;
+}
+
+/**
+ * \brief Bytes of the two sources read to match a tile.
+ *
+ * The first source is read over the tile, its kernel halo and the span of
+ * the disparity range; the second one over the tile and its kernel halo.
+ * \param tile_width  Destination columns of the tile.
+ * \param tile_height Destination rows of the tile.
+ * \param kernel_size Size of the matching window.
+ * \param span        max_disparity - min_disparity, after clamping.
+ * \param elem_size   Size of a source element.
+ * \return The working set in bytes.
+ */
+inline SizeType tile_working_set(SizeType tile_width, SizeType tile_height,
+                                 SizeType kernel_size, SizeType span,
+                                 SizeType elem_size)
+{
+    const SizeType halo = kernel_size - 1;
+    return elem_size * (tile_height + halo)
+           * (2 * (tile_width + halo) + span);
+}
+
+/**
+ * \brief Largest tile whose working set fits cache_bytes.
+ *
+ * The width starts from the disparity span, so that the halo read by the
+ * candidate windows is at most as large as the tile itself, and is halved
+ * until at least one row fits; the height then fills the budget.
+ * \param output_width  Columns of the destination.
+ * \param output_height Rows of the destination.
+ * \param kernel_size   Size of the matching window.
+ * \param span          max_disparity - min_disparity, after clamping.
+ * \param elem_size     Size of a source element.
+ * \param cache_bytes   Budget of the working set.
+ * \param tile_width    Derived tile width.
+ * \param tile_height   Derived tile height.
+ */
+inline void derive_tile_shape(SizeType output_width, SizeType output_height,
+                              SizeType kernel_size, SizeType span,
+                              SizeType elem_size, SizeType cache_bytes,
+                              SizeType& tile_width, SizeType& tile_height)
+{
+    tile_width = std::min(output_width, std::max(span, MIN_TILE_WIDTH));
+    while (tile_width > 1
+           && tile_working_set(tile_width, 1, kernel_size, span, elem_size) > cache_bytes)
+    {
+        tile_width /= 2;
+    }
+
+    const SizeType row_bytes = tile_working_set(tile_width, 1, kernel_size, span, elem_size)
+                               / kernel_size;
+    const SizeType rows = cache_bytes / row_bytes;
+    tile_height = rows > kernel_size - 1 ? rows - (kernel_size - 1) : 1;
+    tile_height = std::min(tile_height, output_height);
+}
+
+/**
+ * \brief Split an output_width x output_height destination in tiles of
+ * tile_width x tile_height, row-major; the last row and column of tiles
+ * may be smaller.
+ * \return The tiles, covering every destination pixel exactly once.
+ */
+inline std::vector<Tile> make_tiles(SizeType output_width, SizeType output_height,
+                                    SizeType tile_width, SizeType tile_height)
+{
+    std::vector<Tile> tiles;
+    if (output_width == 0 || output_height == 0) return tiles;
+    tile_width = std::max<SizeType>(tile_width, 1);
+    tile_height = std::max<SizeType>(tile_height, 1);
+
+    tiles.reserve(((output_height + tile_height - 1) / tile_height)
+                  * ((output_width + tile_width - 1) / tile_width));
+    for (SizeType row = 0; row < output_height; row += tile_height)
+    {
+        for (SizeType col = 0; col < output_width; col += tile_width)
+        {
+            tiles.push_back({row, std::min(row + tile_height, output_height),
+                             col, std::min(col + tile_width, output_width)});
+        }
+    }
+    return tiles;
+}
+
+/**
+ * \brief StereoMatcherPlan executed tile by tile.
+ *
+ * On wide images with a wide search the K rows of candidate windows read
+ * for one pixel do not stay in cache until the next row reads them again.
+ * A tile bounds the region of the sources read while it is matched (see
+ * tile_working_set) so that each source line is fetched once per tile
+ * rather than once per destination row. Tiles are the unit of parallel
+ * work and are scheduled dynamically, since the border tiles search fewer
+ * candidates. The output is identical to argMaxCorrMat.
+ * \tparam T      Type of the source matrices.
+ * \tparam Traits Accumulator and destination types (see MatchingTraits).
+ */
+template <typename T, typename Traits = MatchingTraits<T>>
+class TiledMatcher
+{
+public:
+    using output_type = typename Traits::output_type;
+
+    /**
+     * \param width         Width of the source matrices.
+     * \param height        Height of the source matrices.
+     * \param kernel_size   Size of the matching window.
+     * \param min_disparity Minimum disparity searched.
+     * \param max_disparity Maximum disparity searched.
+     * \param config        Tile shape, cache budget and threads.
+     */
+    TiledMatcher(SizeType width, SizeType height, SizeType kernel_size,
+                 std::int64_t min_disparity = DISPARITY_MIN_UNBOUNDED,
+                 std::int64_t max_disparity = DISPARITY_MAX_UNBOUNDED,
+                 TileConfig config = TileConfig())
+        : _plan{width, height, kernel_size, min_disparity, max_disparity}
+        , _config{config}
+        , _tile_width{0}
+        , _tile_height{0}
+    {
+        if (!_plan.valid()) return;
+
+        std::int64_t min_d = min_disparity;
+        std::int64_t max_d = max_disparity;
+        clampDisparityRange(width, kernel_size, min_d, max_d);
+        const SizeType span = static_cast<SizeType>(max_d - min_d);
+        const SizeType cache_bytes = _config.cache_bytes ? _config.cache_bytes
+                                                         : default_cache_bytes();
+
+        derive_tile_shape(_plan.output_width(), _plan.output_height(),
+                          kernel_size, span, sizeof(T), cache_bytes,
+                          _tile_width, _tile_height);
+        if (_config.tile_width)
+        {
+            _tile_width = std::min(_config.tile_width, _plan.output_width());
+        }
+        if (_config.tile_height)
+        {
+            _tile_height = std::min(_config.tile_height, _plan.output_height());
+        }
+        _tiles = make_tiles(_plan.output_width(), _plan.output_height(),
+                            _tile_width, _tile_height);
+    }
+
+    PlanStatus status() const { return _plan.status(); }
+    bool valid() const { return _plan.valid(); }
+
+    const StereoMatcherPlan<T, Traits>& plan() const { return _plan; }
+    const std::vector<Tile>& tiles() const { return _tiles; }
+    SizeType tile_width() const { return _tile_width; }
+    SizeType tile_height() const { return _tile_height; }
+
+    /**
+     * \brief Match a frame, tiles in parallel.
+     * \param src1 First source matrix, height x width.
+     * \param src2 Second source matrix, height x width.
+     * \param dst  Destination matrix, output_height() x output_width() of
+     *             the plan.
+     * \return OK, INVALID_PLAN or NULL_POINTER; dst is untouched on error.
+     */
+    PlanStatus execute(const T* src1, const T* src2, output_type* dst) const
+    {
+        if (!valid()) return PlanStatus::INVALID_PLAN;
+        if (!src1 || !src2 || !dst) return PlanStatus::NULL_POINTER;
+
+        const std::int64_t count = static_cast<std::int64_t>(_tiles.size());
+#ifdef _OPENMP
+        const int threads = _config.num_threads ? static_cast<int>(_config.num_threads)
+                                                : omp_get_max_threads();
+        #pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+#endif
+        for (std::int64_t i = 0; i < count; ++i)
+        {
+            const Tile& tile = _tiles[static_cast<SizeType>(i)];
+            _plan.execute_tile(src1, src2, dst, tile.row_begin, tile.row_end,
+                               tile.col_begin, tile.col_end);
+        }
+        return PlanStatus::OK;
+    }
+
+    /**
+     * \brief Match a frame, tiles in parallel on pool; config.num_threads
+     * is ignored.
+     * \param src1 First source matrix, height x width.
+     * \param src2 Second source matrix, height x width.
+     * \param dst  Destination matrix, output_height() x output_width() of
+     *             the plan.
+     * \param pool Thread pool running the tiles, one tile per chunk.
+     * \return OK, INVALID_PLAN or NULL_POINTER; dst is untouched on error.
+     */
+    PlanStatus execute(const T* src1, const T* src2, output_type* dst,
+                       ThreadPool& pool) const
+    {
+        if (!valid()) return PlanStatus::INVALID_PLAN;
+        if (!src1 || !src2 || !dst) return PlanStatus::NULL_POINTER;
+        pool.parallel_for(0, _tiles.size(), 1, [&](SizeType begin, SizeType end) {
+            for (SizeType i = begin; i < end; ++i)
+            {
+                const Tile& tile = _tiles[i];
+                _plan.execute_tile(src1, src2, dst, tile.row_begin, tile.row_end,
+                                   tile.col_begin, tile.col_end);
+            }
+        });
+        return PlanStatus::OK;
+    }
+
+    /**
+     * \brief Match a single tile of a frame.
+     * \param index Position of the tile in tiles().
+     * \return OK, INVALID_PLAN, NULL_POINTER or INVALID_TILE.
+     */
+    PlanStatus execute_tile(const T* src1, const T* src2, output_type* dst,
+                            SizeType index) const
+    {
+        if (!valid()) return PlanStatus::INVALID_PLAN;
+        if (index >= _tiles.size()) return PlanStatus::INVALID_TILE;
+        const Tile& tile = _tiles[index];
+        return _plan.execute_tile(src1, src2, dst, tile.row_begin, tile.row_end,
+                                  tile.col_begin, tile.col_end);
+    }
+
+private:
+    StereoMatcherPlan<T, Traits> _plan;
+    TileConfig _config;
+    SizeType _tile_width;
+    SizeType _tile_height;
+    std::vector<Tile> _tiles;
+};
+
+} // namespace stereodepth
+
+#endif // STEREODEPTH_TILED_HPP
@@ -0,0 +1,163 @@
+/***************************************************************************
+ *            workspace.hpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+
+/*! \file  workspace.hpp
+ *  \brief Scratch memory arena shared by the CPU matchers.
+ */
+
+#include "type.hpp"
+
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#ifndef STEREODEPTH_WORKSPACE_HPP
+#define STEREODEPTH_WORKSPACE_HPP
+
+namespace stereodepth {
+
+/**
+ * \brief Bump allocator for the scratch buffers of the matchers.
+ *
+ * The arena is sized once per resolution, kernel size and disparity range
+ * (see the *WorkspaceSize functions next to each matcher) and then reused
+ * across frames: a matcher takes its buffers with allocate() and gives them
+ * back with rewind() before returning, so steady-state frames do not touch
+ * the heap. Every buffer starts on an ALIGNMENT byte boundary.
+ *
+ * allocations() only counts the buffers allocated by the arena itself; the
+ * heap traffic of a whole frame is checked by test_workspace, which counts
+ * the calls to the global operator new.
+ */
+class MatcherWorkspace
+{
+public:
+    /// Alignment in bytes of every buffer, as CostVolume::ALIGNMENT.
+    static constexpr SizeType ALIGNMENT = 64;
+
+    MatcherWorkspace()
+        : _capacity{0}
+        , _used{0}
+        , _allocations{0}
+        , _buffer{nullptr}
+        , _data{nullptr}
+    {}
+
+    explicit MatcherWorkspace(SizeType size)
+        : MatcherWorkspace()
+    {
+        reserve(size);
+    }
+
+    MatcherWorkspace(const MatcherWorkspace&) = delete;
+    MatcherWorkspace& operator=(const MatcherWorkspace&) = delete;
+
+    /// The moved-from arena is left empty, as a default constructed one.
+    MatcherWorkspace(MatcherWorkspace&& other) noexcept
+        : _capacity{std::exchange(other._capacity, 0)}
+        , _used{std::exchange(other._used, 0)}
+        , _allocations{std::exchange(other._allocations, 0)}
+        , _buffer{std::move(other._buffer)}
+        , _data{std::exchange(other._data, nullptr)}
+    {}
+
+    MatcherWorkspace& operator=(MatcherWorkspace&& other) noexcept
+    {
+        if (this != &other)
+        {
+            _capacity = std::exchange(other._capacity, 0);
+            _used = std::exchange(other._used, 0);
+            _allocations = std::exchange(other._allocations, 0);
+            _buffer = std::move(other._buffer);
+            _data = std::exchange(other._data, nullptr);
+        }
+        return *this;
+    }
+
+    /**
+     * \brief Bytes taken by count elements of type T, rounded up to ALIGNMENT.
+     * \tparam T     Type of the elements.
+     * \param count  Number of elements.
+     * \return The size of the buffer inside the arena.
+     */
+    template <typename T>
+    static constexpr SizeType bytes(SizeType count)
+    {
+        return (count * sizeof(T) + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+    }
+
+    /**
+     * \brief Make room for size bytes, reallocating only if the current
+     * capacity is not enough.
+     * \param size Total size of the arena in bytes.
+     * \return True if the arena has been reallocated.
+     * \throw std::logic_error if the arena must grow while buffers are in use.
+     */
+    bool reserve(SizeType size)
+    {
+        if (size <= _capacity) return false;
+        if (_used != 0)
+        {
+            throw std::logic_error(
+                "MatcherWorkspace: cannot grow while buffers are in use");
+        }
+        _capacity = (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+        _buffer.reset(new unsigned char[_capacity + ALIGNMENT]);
+        void* ptr = _buffer.get();
+        SizeType space = _capacity + ALIGNMENT;
+        _data = static_cast<unsigned char*>(
+            std::align(ALIGNMENT, _capacity, ptr, space));
+        ++_allocations;
+        return true;
+    }
+
+    /**
+     * \brief Take an uninitialized buffer of count elements.
+     * \tparam T    Type of the elements, trivially destructible.
+     * \param count Number of elements.
+     * \return The pointer to the first element.
+     * \throw std::length_error if the remaining capacity is not enough.
+     */
+    template <typename T>
+    T* allocate(SizeType count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value,
+                      "MatcherWorkspace buffers are never destroyed");
+        const SizeType size = bytes<T>(count);
+        if (size > _capacity - _used)
+        {
+            throw std::length_error("MatcherWorkspace: capacity exceeded");
+        }
+        T* ptr = reinterpret_cast<T*>(_data + _used);
+        _used += size;
+        return ptr;
+    }
+
+    /// Current position of the arena, to be passed to rewind().
+    SizeType mark() const { return _used; }
+
+    /// Release every buffer taken after mark.
+    void rewind(SizeType mark) { _used = mark; }
+
+    SizeType capacity() const { return _capacity; }
+    SizeType used() const { return _used; }
+    SizeType allocations() const { return _allocations; }
+
+private:
+    SizeType _capacity;
+    SizeType _used;
+    SizeType _allocations;
+    std::unique_ptr<unsigned char[]> _buffer;
+    unsigned char* _data;
+};
+
+} // namespace stereodepth
+
+#endif // STEREODEPTH_WORKSPACE_HPP
@@ -10,4 +10,13 @@
 
 namespace stereodepth {
 
+// Definitions of the constexpr members, needed before C++17 when odr-used.
+constexpr SizeType Math::Shape2d::SIZE;
+constexpr SizeType Math::Shape2d::HEIGHT_IDX;
+constexpr SizeType Math::Shape2d::WIDTH_IDX;
+constexpr SizeType Math::Shape3d::SIZE;
+constexpr SizeType Math::Shape3d::HEIGHT_IDX;
+constexpr SizeType Math::Shape3d::WIDTH_IDX;
+constexpr SizeType Math::Shape3d::CHANNEL_IDX;
+
 } // namespace stereodepth
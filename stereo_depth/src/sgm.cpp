@@ -0,0 +1,398 @@
+/***************************************************************************
+ *            sgm.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "stereodepth/sgm.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <utility>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define STEREODEPTH_SGM_X86 1
+#include <immintrin.h>
+#else
+#define STEREODEPTH_SGM_X86 0
+#endif
+
+
+namespace stereodepth {
+
+namespace {
+
+/// Path cost stored around each line entry, never selected by the minimum.
+constexpr std::uint16_t SENTINEL = std::numeric_limits<std::uint16_t>::max();
+
+/// Signature of the kernels updating the path costs of one pixel.
+/// prev is null at the first pixel of a path, otherwise prev[-1] and prev[D]
+/// hold SENTINEL.
+using PathStep = void (*)(const std::uint16_t* prev, const std::uint16_t* cost,
+                          std::uint16_t* cur, std::uint16_t* sum,
+                          SizeType disparities, std::uint16_t p1,
+                          std::uint16_t p2);
+
+struct Direction {
+    int dx;
+    int dy;
+};
+
+/// The first four directions are the 4-path mode.
+constexpr Direction DIRECTIONS[8] = {
+    {1, 0}, {-1, 0}, {0, 1}, {0, -1}, {1, 1}, {-1, 1}, {1, -1}, {-1, -1}
+};
+
+void path_start(const std::uint16_t* cost, std::uint16_t* cur,
+                std::uint16_t* sum, SizeType disparities)
+{
+    for (SizeType d = 0; d < disparities; ++d)
+    {
+        cur[d] = cost[d];
+        sum[d] = static_cast<std::uint16_t>(sum[d] + cost[d]);
+    }
+}
+
+void path_tail(const std::uint16_t* prev, const std::uint16_t* cost,
+               std::uint16_t* cur, std::uint16_t* sum,
+               SizeType d, SizeType disparities, std::uint16_t p1,
+               std::uint16_t min_prev, std::uint32_t jump)
+{
+    for (; d < disparities; ++d)
+    {
+        std::uint32_t m = std::min<std::uint32_t>(prev[d], jump);
+        m = std::min<std::uint32_t>(m, std::uint32_t{prev[d - 1]} + p1);
+        m = std::min<std::uint32_t>(m, std::uint32_t{prev[d + 1]} + p1);
+        cur[d] = static_cast<std::uint16_t>(cost[d] + m - min_prev);
+        sum[d] = static_cast<std::uint16_t>(sum[d] + cur[d]);
+    }
+}
+
+void path_step_scalar(const std::uint16_t* prev, const std::uint16_t* cost,
+                      std::uint16_t* cur, std::uint16_t* sum,
+                      SizeType disparities, std::uint16_t p1, std::uint16_t p2)
+{
+    if (!prev)
+    {
+        path_start(cost, cur, sum, disparities);
+        return;
+    }
+    const std::uint16_t min_prev = *std::min_element(prev, prev + disparities);
+    path_tail(prev, cost, cur, sum, 0, disparities, p1, min_prev,
+              std::uint32_t{min_prev} + p2);
+}
+
+#if STEREODEPTH_SGM_X86
+
+__attribute__((target("sse4.1")))
+void path_step_sse4(const std::uint16_t* prev, const std::uint16_t* cost,
+                    std::uint16_t* cur, std::uint16_t* sum,
+                    SizeType disparities, std::uint16_t p1, std::uint16_t p2)
+{
+    if (!prev)
+    {
+        path_start(cost, cur, sum, disparities);
+        return;
+    }
+
+    SizeType d = 0;
+    __m128i vmin = _mm_set1_epi16(-1);
+    for (; d + 8 <= disparities; d += 8)
+    {
+        vmin = _mm_min_epu16(vmin, _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(prev + d)));
+    }
+    auto min_prev = static_cast<std::uint16_t>(
+        _mm_extract_epi16(_mm_minpos_epu16(vmin), 0));
+    for (; d < disparities; ++d) min_prev = std::min(min_prev, prev[d]);
+
+    const std::uint32_t jump = std::uint32_t{min_prev} + p2;
+    const __m128i vp1 = _mm_set1_epi16(static_cast<short>(p1));
+    const __m128i vjump = _mm_set1_epi16(static_cast<short>(
+        std::min<std::uint32_t>(jump, SENTINEL)));
+    const __m128i vmin_prev = _mm_set1_epi16(static_cast<short>(min_prev));
+
+    for (d = 0; d + 8 <= disparities; d += 8)
+    {
+        const __m128i same = _mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(prev + d));
+        const __m128i lower = _mm_adds_epu16(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(prev + d - 1)), vp1);
+        const __m128i upper = _mm_adds_epu16(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(prev + d + 1)), vp1);
+        const __m128i m = _mm_min_epu16(_mm_min_epu16(same, vjump),
+                                        _mm_min_epu16(lower, upper));
+        const __m128i l = _mm_add_epi16(_mm_loadu_si128(
+            reinterpret_cast<const __m128i*>(cost + d)),
+            _mm_sub_epi16(m, vmin_prev));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(cur + d), l);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(sum + d), _mm_add_epi16(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(sum + d)), l));
+    }
+    path_tail(prev, cost, cur, sum, d, disparities, p1, min_prev, jump);
+}
+
+__attribute__((target("avx2")))
+void path_step_avx2(const std::uint16_t* prev, const std::uint16_t* cost,
+                    std::uint16_t* cur, std::uint16_t* sum,
+                    SizeType disparities, std::uint16_t p1, std::uint16_t p2)
+{
+    if (!prev)
+    {
+        path_start(cost, cur, sum, disparities);
+        return;
+    }
+
+    SizeType d = 0;
+    __m256i vmin = _mm256_set1_epi16(-1);
+    for (; d + 16 <= disparities; d += 16)
+    {
+        vmin = _mm256_min_epu16(vmin, _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(prev + d)));
+    }
+    const __m128i half = _mm_min_epu16(_mm256_castsi256_si128(vmin),
+                                       _mm256_extracti128_si256(vmin, 1));
+    auto min_prev = static_cast<std::uint16_t>(
+        _mm_extract_epi16(_mm_minpos_epu16(half), 0));
+    for (; d < disparities; ++d) min_prev = std::min(min_prev, prev[d]);
+
+    const std::uint32_t jump = std::uint32_t{min_prev} + p2;
+    const __m256i vp1 = _mm256_set1_epi16(static_cast<short>(p1));
+    const __m256i vjump = _mm256_set1_epi16(static_cast<short>(
+        std::min<std::uint32_t>(jump, SENTINEL)));
+    const __m256i vmin_prev = _mm256_set1_epi16(static_cast<short>(min_prev));
+
+    for (d = 0; d + 16 <= disparities; d += 16)
+    {
+        const __m256i same = _mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(prev + d));
+        const __m256i lower = _mm256_adds_epu16(_mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(prev + d - 1)), vp1);
+        const __m256i upper = _mm256_adds_epu16(_mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(prev + d + 1)), vp1);
+        const __m256i m = _mm256_min_epu16(_mm256_min_epu16(same, vjump),
+                                           _mm256_min_epu16(lower, upper));
+        const __m256i l = _mm256_add_epi16(_mm256_loadu_si256(
+            reinterpret_cast<const __m256i*>(cost + d)),
+            _mm256_sub_epi16(m, vmin_prev));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(cur + d), l);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(sum + d),
+            _mm256_add_epi16(_mm256_loadu_si256(
+                reinterpret_cast<const __m256i*>(sum + d)), l));
+    }
+    path_tail(prev, cost, cur, sum, d, disparities, p1, min_prev, jump);
+}
+
+#endif // STEREODEPTH_SGM_X86
+
+PathStep select_path_step(SimdLevel level)
+{
+    if (!simdLevelSupported(level)) level = simdLevel();
+    switch (level)
+    {
+#if STEREODEPTH_SGM_X86
+        case SimdLevel::AVX2: return path_step_avx2;
+        case SimdLevel::SSE4: return path_step_sse4;
+#endif
+        default: return path_step_scalar;
+    }
+}
+
+/// Number of OpenMP threads of the aggregation.
+int sgm_threads(const SgmParameters& params)
+{
+#ifdef _OPENMP
+    return params.num_threads
+        ? static_cast<int>(params.num_threads) : omp_get_max_threads();
+#else
+    (void) params;
+    return 1;
+#endif
+}
+
+/// Horizontal paths: every row is an independent scanline. Thread t uses the
+/// two lines of lines + t * 2 * (disparities + 2).
+void aggregate_rows(const CostVolume<std::uint16_t>& costs,
+                    CostVolume<std::uint16_t>& aggregated, int dx,
+                    const SgmParameters& params, PathStep step, int threads,
+                    std::uint16_t* lines)
+{
+    const SizeType height = costs.height();
+    const SizeType width = costs.width();
+    const SizeType disparities = costs.disparities();
+    const SizeType stride = disparities + 2;
+    (void) threads;
+
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(threads)
+#endif
+    {
+#ifdef _OPENMP
+        const auto thread = static_cast<SizeType>(omp_get_thread_num());
+#else
+        const SizeType thread = 0;
+#endif
+        std::uint16_t* line = lines + thread * 2 * stride;
+        std::fill(line, line + 2 * stride, SENTINEL);
+
+#ifdef _OPENMP
+        #pragma omp for schedule(static)
+#endif
+        for (std::int64_t r = 0; r < static_cast<std::int64_t>(height); ++r)
+        {
+            const auto row = static_cast<SizeType>(r);
+            std::uint16_t* prev = line + 1;
+            std::uint16_t* cur = line + stride + 1;
+            for (SizeType i = 0; i < width; ++i)
+            {
+                const SizeType x = dx > 0 ? i : width - 1 - i;
+                step(i ? prev : nullptr, costs.data() + costs.index(row, x, 0),
+                     cur, aggregated.data() + aggregated.index(row, x, 0),
+                     disparities, params.p1, params.p2);
+                std::swap(prev, cur);
+            }
+        }
+    }
+}
+
+/// Vertical and diagonal paths: rows are visited in order, the pixels of a
+/// row only depend on the previous row. lines holds 2 * width lines.
+void aggregate_columns(const CostVolume<std::uint16_t>& costs,
+                       CostVolume<std::uint16_t>& aggregated, int dx, int dy,
+                       const SgmParameters& params, PathStep step, int threads,
+                       std::uint16_t* lines)
+{
+    const SizeType height = costs.height();
+    const auto width = static_cast<std::int64_t>(costs.width());
+    const SizeType disparities = costs.disparities();
+    const SizeType stride = disparities + 2;
+    (void) threads;
+
+    std::fill(lines, lines + 2 * costs.width() * stride, SENTINEL);
+    std::uint16_t* prev_line = lines + 1;
+    std::uint16_t* cur_line = lines + costs.width() * stride + 1;
+
+#ifdef _OPENMP
+    #pragma omp parallel num_threads(threads)
+#endif
+    {
+        for (SizeType i = 0; i < height; ++i)
+        {
+            const SizeType row = dy > 0 ? i : height - 1 - i;
+
+#ifdef _OPENMP
+            #pragma omp for schedule(static)
+#endif
+            for (std::int64_t x = 0; x < width; ++x)
+            {
+                const std::int64_t px = x - dx;
+                const bool has_prev = i > 0 && px >= 0 && px < width;
+                const auto col = static_cast<SizeType>(x);
+                step(has_prev ? prev_line + px * stride : nullptr,
+                     costs.data() + costs.index(row, col, 0),
+                     cur_line + col * stride,
+                     aggregated.data() + aggregated.index(row, col, 0),
+                     disparities, params.p1, params.p2);
+            }
+
+#ifdef _OPENMP
+            #pragma omp single
+#endif
+            std::swap(prev_line, cur_line);
+        }
+    }
+}
+
+/// Elements of the path cost lines of a volume width x disparities.
+SizeType sgm_line_elements(SizeType width, SizeType disparities,
+                           const SgmParameters& params)
+{
+    const auto threads = static_cast<SizeType>(sgm_threads(params));
+    return std::max(threads, width) * 2 * (disparities + 2);
+}
+
+} // namespace
+
+SizeType sgm_workspace_size(SizeType width, SizeType disparities,
+                            const SgmParameters& params)
+{
+    return MatcherWorkspace::bytes<std::uint16_t>(
+        sgm_line_elements(width, disparities, params));
+}
+
+void sgm_aggregate(const CostVolume<std::uint16_t>& costs,
+                   CostVolume<std::uint16_t>& aggregated,
+                   const SgmParameters& params,
+                   SimdLevel level)
+{
+    MatcherWorkspace workspace(
+        sgm_workspace_size(costs.width(), costs.disparities(), params));
+    sgm_aggregate(costs, aggregated, workspace, params, level);
+}
+
+void sgm_aggregate(const CostVolume<std::uint16_t>& costs,
+                   CostVolume<std::uint16_t>& aggregated,
+                   MatcherWorkspace& workspace,
+                   const SgmParameters& params,
+                   SimdLevel level)
+{
+    using Layout = CostVolume<std::uint16_t>::Layout;
+
+    if (costs.layout() != Layout::HWD || aggregated.layout() != Layout::HWD)
+    {
+        throw std::invalid_argument("sgm_aggregate: volumes must be HWD");
+    }
+    if (params.paths != 4 && params.paths != 8)
+    {
+        throw std::invalid_argument("sgm_aggregate: paths must be 4 or 8");
+    }
+
+    const std::uint16_t max_cost = costs.size()
+        ? *std::max_element(costs.data(), costs.data() + costs.size()) : 0;
+    // Path costs are bounded by max_cost + p2, their sum must fit 16 bits.
+    const std::uint64_t bound = params.paths
+        * (std::uint64_t{max_cost} + params.p1 + params.p2);
+    if (bound > SENTINEL - 1)
+    {
+        throw std::invalid_argument(
+            "sgm_aggregate: aggregated costs would overflow 16 bits");
+    }
+
+    aggregated.resize(costs.height(), costs.width(),
+                      costs.min_disparity(), costs.max_disparity());
+    aggregated.fill(0);
+    if (!costs.size()) return;
+
+    const int threads = sgm_threads(params);
+    const PathStep step = select_path_step(level);
+
+    const SizeType mark = workspace.mark();
+    workspace.reserve(mark + sgm_workspace_size(costs.width(),
+                                                costs.disparities(), params));
+    std::uint16_t* lines = workspace.allocate<std::uint16_t>(
+        sgm_line_elements(costs.width(), costs.disparities(), params));
+
+    for (SizeType p = 0; p < params.paths; ++p)
+    {
+        const Direction& dir = DIRECTIONS[p];
+        if (dir.dy == 0)
+        {
+            aggregate_rows(costs, aggregated, dir.dx, params, step, threads,
+                           lines);
+        }
+        else
+        {
+            aggregate_columns(costs, aggregated, dir.dx, dir.dy, params, step,
+                              threads, lines);
+        }
+    }
+    workspace.rewind(mark);
+}
+
+} // namespace stereodepth
@@ -0,0 +1,575 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Alessio Zattoni                                    *
+ *                                                                          *
+ * This file is part of CrossCorrelation.                                   *
+ *                                                                          *
+ *   CrossCorrelation is free software: you can redistribute it and/or      *
+ *   modify it under the terms of the GNU Lesser General Public License as  *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   CrossCorrelation is distributed in the hope that it will be            *
+ *   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+
+
+/**
+ * @file    simd.cpp
+ * @author  Alessio Zattoni
+ * @date
+ *
+ * I kernel vettoriali sono compilati con l'attributo \p target, quindi la libreria non richiede
+ * flag -mavx2/-msse4.1 globali e resta eseguibile su CPU prive di queste estensioni.
+ */
+
+
+
+#include <stereodepth/simd.hpp>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define STEREODEPTH_SIMD_X86 1
+#include <immintrin.h>
+#else
+#define STEREODEPTH_SIMD_X86 0
+#endif
+
+
+namespace {
+
+template <CostFunction F>
+inline std::uint32_t pixelCost(const std::uint8_t a, const std::uint8_t b)
+{
+    const std::int32_t diff = static_cast<std::int32_t>(a) - static_cast<std::int32_t>(b);
+
+    switch (F) {
+        case CostFunction::PRODUCT_SUM:
+            return static_cast<std::uint32_t>(a) * b;
+        case CostFunction::SAD:
+            return static_cast<std::uint32_t>(diff < 0 ? -diff : diff);
+        case CostFunction::SSD:
+        default:
+            return static_cast<std::uint32_t>(diff * diff);
+    }
+}
+
+
+// col[i] = somma su kernel_size righe del costo tra src1[r][i] e src2[r][i], per i < n
+template <CostFunction F, typename C>
+void columnCostsScalar(const std::uint8_t   *src1,
+                       const std::uint8_t   *src2,
+                       std::size_t          width,
+                       std::size_t          kernel_size,
+                       std::size_t          n,
+                       std::size_t          i,
+                       C                    *col)
+{
+    for (std::size_t c = i; c < n; c++) {
+        col[c] = 0;
+    }
+
+    for (std::size_t r = 0; r < kernel_size; r++) {
+        const std::uint8_t *a = src1 + r * width;
+        const std::uint8_t *b = src2 + r * width;
+        for (std::size_t c = i; c < n; c++) {
+            col[c] = static_cast<C>(col[c] + pixelCost<F>(a[c], b[c]));
+        }
+    }
+}
+
+
+// costs[x] = somma di kernel_size somme per colonna consecutive, per x < m
+template <typename C>
+void windowSumsScalar(const C               *col,
+                      std::size_t           kernel_size,
+                      std::size_t           m,
+                      std::size_t           x,
+                      std::uint32_t         *costs)
+{
+    if (x >= m) {
+        return;
+    }
+
+    // Il totale è rappresentabile in C, quindi eventuali overflow intermedi si compensano
+    C sum = 0;
+    for (std::size_t k = 0; k < kernel_size; k++) {
+        sum = static_cast<C>(sum + col[x + k]);
+    }
+    costs[x] = sum;
+
+    for (x = x + 1; x < m; x++) {
+        sum = static_cast<C>(sum + col[x + kernel_size - 1]);
+        sum = static_cast<C>(sum - col[x - 1]);
+        costs[x] = sum;
+    }
+}
+
+
+std::uint64_t blockSadScalar(const std::uint8_t *a,
+                             const std::uint8_t *b,
+                             std::size_t        stride,
+                             std::size_t        rows,
+                             std::size_t        cols,
+                             std::size_t        begin)
+{
+    std::uint64_t sum = 0;
+    for (std::size_t r = 0; r < rows; r++) {
+        for (std::size_t c = begin; c < cols; c++) {
+            sum += pixelCost<CostFunction::SAD>(a[r * stride + c], b[r * stride + c]);
+        }
+    }
+    return sum;
+}
+
+
+#if STEREODEPTH_SIMD_X86
+
+template <CostFunction F>
+__attribute__((target("sse4.1")))
+void columnCostsSse4(const std::uint8_t *src1,
+                     const std::uint8_t *src2,
+                     std::size_t        width,
+                     std::size_t        kernel_size,
+                     std::size_t        n,
+                     std::uint32_t      *col)
+{
+    const __m128i zero = _mm_setzero_si128();
+    std::size_t i = 0;
+
+    if (F == CostFunction::SAD) {
+        // 16 differenze assolute per istruzione, accumulate su 16 bit
+        for (; i + 16 <= n; i += 16) {
+            __m128i lo = zero, hi = zero;
+            for (std::size_t r = 0; r < kernel_size; r++) {
+                const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src1 + r * width + i));
+                const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src2 + r * width + i));
+                const __m128i ad = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+                lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(ad, zero));
+                hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(ad, zero));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(col + i), _mm_unpacklo_epi16(lo, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(col + i + 4), _mm_unpackhi_epi16(lo, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(col + i + 8), _mm_unpacklo_epi16(hi, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(col + i + 12), _mm_unpackhi_epi16(hi, zero));
+        }
+    }
+    else {
+        // 8 prodotti per istruzione su 16 bit, accumulati su 32 bit
+        for (; i + 8 <= n; i += 8) {
+            __m128i lo = zero, hi = zero;
+            for (std::size_t r = 0; r < kernel_size; r++) {
+                const __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src1 + r * width + i)));
+                const __m128i b = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src2 + r * width + i)));
+                __m128i v;
+                if (F == CostFunction::PRODUCT_SUM) {
+                    v = _mm_mullo_epi16(a, b);
+                }
+                else {
+                    const __m128i diff = _mm_sub_epi16(a, b);
+                    v = _mm_mullo_epi16(diff, diff);
+                }
+                lo = _mm_add_epi32(lo, _mm_unpacklo_epi16(v, zero));
+                hi = _mm_add_epi32(hi, _mm_unpackhi_epi16(v, zero));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(col + i), lo);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(col + i + 4), hi);
+        }
+    }
+
+    columnCostsScalar<F>(src1, src2, width, kernel_size, n, i, col);
+}
+
+
+__attribute__((target("sse4.1")))
+void windowSumsSse4(const std::uint32_t *col,
+                    std::size_t         kernel_size,
+                    std::size_t         m,
+                    std::uint32_t       *costs)
+{
+    std::size_t x = 0;
+
+    for (; x + 4 <= m; x += 4) {
+        __m128i sum = _mm_setzero_si128();
+        for (std::size_t k = 0; k < kernel_size; k++) {
+            sum = _mm_add_epi32(sum, _mm_loadu_si128(reinterpret_cast<const __m128i *>(col + x + k)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(costs + x), sum);
+    }
+
+    windowSumsScalar(col, kernel_size, m, x, costs);
+}
+
+
+// SAD a 16 bit: colonne e finestre restano su corsie a 16 bit, allargate a 32 bit solo in uscita
+__attribute__((target("sse4.1")))
+void sadCostsSse4U16(const std::uint8_t *src1,
+                     const std::uint8_t *src2,
+                     std::size_t        width,
+                     std::size_t        kernel_size,
+                     std::size_t        m,
+                     std::uint32_t      *costs,
+                     std::uint16_t      *col)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const std::size_t n = m + kernel_size - 1;
+    std::size_t i = 0;
+
+    for (; i + 16 <= n; i += 16) {
+        __m128i lo = zero, hi = zero;
+        for (std::size_t r = 0; r < kernel_size; r++) {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src1 + r * width + i));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src2 + r * width + i));
+            const __m128i ad = _mm_or_si128(_mm_subs_epu8(a, b), _mm_subs_epu8(b, a));
+            lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(ad, zero));
+            hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(ad, zero));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(col + i), lo);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(col + i + 8), hi);
+    }
+    columnCostsScalar<CostFunction::SAD>(src1, src2, width, kernel_size, n, i, col);
+
+    std::size_t x = 0;
+    for (; x + 8 <= m; x += 8) {
+        __m128i sum = zero;
+        for (std::size_t k = 0; k < kernel_size; k++) {
+            sum = _mm_add_epi16(sum, _mm_loadu_si128(reinterpret_cast<const __m128i *>(col + x + k)));
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(costs + x), _mm_unpacklo_epi16(sum, zero));
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(costs + x + 4), _mm_unpackhi_epi16(sum, zero));
+    }
+    windowSumsScalar(col, kernel_size, m, x, costs);
+}
+
+
+template <CostFunction F>
+__attribute__((target("avx2")))
+void columnCostsAvx2(const std::uint8_t *src1,
+                     const std::uint8_t *src2,
+                     std::size_t        width,
+                     std::size_t        kernel_size,
+                     std::size_t        n,
+                     std::uint32_t      *col)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    std::size_t i = 0;
+
+    if (F == CostFunction::SAD) {
+        // 32 differenze assolute per istruzione, accumulate su 16 bit
+        for (; i + 32 <= n; i += 32) {
+            __m256i lo = zero, hi = zero;
+            for (std::size_t r = 0; r < kernel_size; r++) {
+                const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src1 + r * width + i));
+                const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src2 + r * width + i));
+                const __m256i ad = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+                lo = _mm256_add_epi16(lo, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(ad)));
+                hi = _mm256_add_epi16(hi, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(ad, 1)));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(col + i), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(lo)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(col + i + 8), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(lo, 1)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(col + i + 16), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(hi)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(col + i + 24), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(hi, 1)));
+        }
+    }
+    else {
+        // 16 prodotti per istruzione su 16 bit, accumulati su 32 bit
+        for (; i + 16 <= n; i += 16) {
+            __m256i lo = zero, hi = zero;
+            for (std::size_t r = 0; r < kernel_size; r++) {
+                const __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src1 + r * width + i)));
+                const __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src2 + r * width + i)));
+                __m256i v;
+                if (F == CostFunction::PRODUCT_SUM) {
+                    v = _mm256_mullo_epi16(a, b);
+                }
+                else {
+                    const __m256i diff = _mm256_sub_epi16(a, b);
+                    v = _mm256_mullo_epi16(diff, diff);
+                }
+                lo = _mm256_add_epi32(lo, _mm256_cvtepu16_epi32(_mm256_castsi256_si128(v)));
+                hi = _mm256_add_epi32(hi, _mm256_cvtepu16_epi32(_mm256_extracti128_si256(v, 1)));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(col + i), lo);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(col + i + 8), hi);
+        }
+    }
+
+    columnCostsScalar<F>(src1, src2, width, kernel_size, n, i, col);
+}
+
+
+__attribute__((target("avx2")))
+void windowSumsAvx2(const std::uint32_t *col,
+                    std::size_t         kernel_size,
+                    std::size_t         m,
+                    std::uint32_t       *costs)
+{
+    std::size_t x = 0;
+
+    for (; x + 8 <= m; x += 8) {
+        __m256i sum = _mm256_setzero_si256();
+        for (std::size_t k = 0; k < kernel_size; k++) {
+            sum = _mm256_add_epi32(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(col + x + k)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(costs + x), sum);
+    }
+
+    windowSumsScalar(col, kernel_size, m, x, costs);
+}
+
+
+__attribute__((target("avx2")))
+void sadCostsAvx2U16(const std::uint8_t *src1,
+                     const std::uint8_t *src2,
+                     std::size_t        width,
+                     std::size_t        kernel_size,
+                     std::size_t        m,
+                     std::uint32_t      *costs,
+                     std::uint16_t      *col)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    const std::size_t n = m + kernel_size - 1;
+    std::size_t i = 0;
+
+    for (; i + 32 <= n; i += 32) {
+        __m256i lo = zero, hi = zero;
+        for (std::size_t r = 0; r < kernel_size; r++) {
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src1 + r * width + i));
+            const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src2 + r * width + i));
+            const __m256i ad = _mm256_or_si256(_mm256_subs_epu8(a, b), _mm256_subs_epu8(b, a));
+            lo = _mm256_add_epi16(lo, _mm256_cvtepu8_epi16(_mm256_castsi256_si128(ad)));
+            hi = _mm256_add_epi16(hi, _mm256_cvtepu8_epi16(_mm256_extracti128_si256(ad, 1)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(col + i), lo);
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(col + i + 16), hi);
+    }
+    columnCostsScalar<CostFunction::SAD>(src1, src2, width, kernel_size, n, i, col);
+
+    std::size_t x = 0;
+    for (; x + 16 <= m; x += 16) {
+        __m256i sum = zero;
+        for (std::size_t k = 0; k < kernel_size; k++) {
+            sum = _mm256_add_epi16(sum, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(col + x + k)));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(costs + x), _mm256_cvtepu16_epi32(_mm256_castsi256_si128(sum)));
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(costs + x + 8), _mm256_cvtepu16_epi32(_mm256_extracti128_si256(sum, 1)));
+    }
+    windowSumsScalar(col, kernel_size, m, x, costs);
+}
+
+
+__attribute__((target("sse4.1")))
+std::uint64_t blockSadSse4(const std::uint8_t   *a,
+                           const std::uint8_t   *b,
+                           std::size_t          stride,
+                           std::size_t          rows,
+                           std::size_t          cols)
+{
+    __m128i sum = _mm_setzero_si128();
+    const std::size_t vec = cols / 16 * 16;
+
+    for (std::size_t r = 0; r < rows; r++) {
+        for (std::size_t c = 0; c < vec; c += 16) {
+            const __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a + r * stride + c));
+            const __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + r * stride + c));
+            sum = _mm_add_epi64(sum, _mm_sad_epu8(x, y));
+        }
+    }
+    std::uint64_t lanes[2];
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(lanes), sum);
+    return lanes[0] + lanes[1] + blockSadScalar(a, b, stride, rows, cols, vec);
+}
+
+
+__attribute__((target("avx2")))
+std::uint64_t blockSadAvx2(const std::uint8_t   *a,
+                           const std::uint8_t   *b,
+                           std::size_t          stride,
+                           std::size_t          rows,
+                           std::size_t          cols)
+{
+    __m256i sum = _mm256_setzero_si256();
+    const std::size_t vec = cols / 32 * 32;
+
+    for (std::size_t r = 0; r < rows; r++) {
+        for (std::size_t c = 0; c < vec; c += 32) {
+            const __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + r * stride + c));
+            const __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + r * stride + c));
+            sum = _mm256_add_epi64(sum, _mm256_sad_epu8(x, y));
+        }
+    }
+    std::uint64_t lanes[4];
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes), sum);
+    return lanes[0] + lanes[1] + lanes[2] + lanes[3] + blockSadScalar(a, b, stride, rows, cols, vec);
+}
+
+#endif // STEREODEPTH_SIMD_X86
+
+
+template <CostFunction F>
+void windowCosts(const std::uint8_t *src1,
+                 const std::uint8_t *src2,
+                 std::size_t        width,
+                 std::size_t        kernel_size,
+                 std::size_t        m,
+                 std::uint32_t      *costs,
+                 std::uint32_t      *col,
+                 SimdLevel          level)
+{
+    const std::size_t n = m + kernel_size - 1;
+
+    // Corsia più stretta che non va in overflow: la SAD su finestre fino a 16 X 16 sta in 16 bit
+    if (F == CostFunction::SAD && accumulatorBits(255, kernel_size) == 16) {
+        // Le somme per colonna a 16 bit occupano la prima metà di scratch
+        std::uint16_t *col16 = reinterpret_cast<std::uint16_t *>(col);
+
+        switch (level) {
+#if STEREODEPTH_SIMD_X86
+            case SimdLevel::AVX2:
+                sadCostsAvx2U16(src1, src2, width, kernel_size, m, costs, col16);
+                return;
+            case SimdLevel::SSE4:
+                sadCostsSse4U16(src1, src2, width, kernel_size, m, costs, col16);
+                return;
+#endif
+            default:
+                columnCostsScalar<F>(src1, src2, width, kernel_size, n, 0, col16);
+                windowSumsScalar(col16, kernel_size, m, 0, costs);
+                return;
+        }
+    }
+
+    switch (level) {
+#if STEREODEPTH_SIMD_X86
+        case SimdLevel::AVX2:
+            columnCostsAvx2<F>(src1, src2, width, kernel_size, n, col);
+            windowSumsAvx2(col, kernel_size, m, costs);
+            break;
+        case SimdLevel::SSE4:
+            columnCostsSse4<F>(src1, src2, width, kernel_size, n, col);
+            windowSumsSse4(col, kernel_size, m, costs);
+            break;
+#endif
+        default:
+            columnCostsScalar<F>(src1, src2, width, kernel_size, n, 0, col);
+            windowSumsScalar(col, kernel_size, m, 0, costs);
+            break;
+    }
+}
+
+} // namespace
+
+
+SimdLevel detectSimdLevel()
+{
+#if STEREODEPTH_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return SimdLevel::SSE4;
+    }
+#endif
+    return SimdLevel::SCALAR;
+}
+
+
+SimdLevel simdLevel()
+{
+    static const SimdLevel level = detectSimdLevel();
+    return level;
+}
+
+
+bool simdLevelSupported(SimdLevel level)
+{
+    return static_cast<int>(level) <= static_cast<int>(simdLevel());
+}
+
+
+const char *simdLevelName(SimdLevel level)
+{
+    switch (level) {
+        case SimdLevel::AVX2:
+            return "AVX2";
+        case SimdLevel::SSE4:
+            return "SSE4";
+        default:
+            return "SCALAR";
+    }
+}
+
+
+void windowCostsU8(CostFunction         cost,
+                   const std::uint8_t   *src1,
+                   const std::uint8_t   *src2,
+                   std::size_t          width,
+                   std::size_t          kernel_size,
+                   std::int64_t         d,
+                   std::size_t          x_begin,
+                   std::size_t          x_end,
+                   std::uint32_t        *costs,
+                   std::uint32_t        *scratch,
+                   SimdLevel            level)
+{
+    if (x_begin >= x_end) {
+        return;
+    }
+
+    if (accumulatorBits(cost == CostFunction::SAD ? 255 : 255 * 255, kernel_size) > 32) {
+        std::cerr << "Kernel size too large for 32 bit costs" <<
+        "\n→ Line: " << __LINE__ <<
+        "\n→ Function: " << __func__  <<
+        "\n→ File: " << __FILE__ << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (!simdLevelSupported(level)) {
+        level = simdLevel();
+    }
+
+    const std::size_t m = x_end - x_begin;
+    const std::uint8_t *a = src1 + static_cast<std::int64_t>(x_begin) - d;
+    const std::uint8_t *b = src2 + x_begin;
+
+    switch (cost) {
+        case CostFunction::PRODUCT_SUM:
+            windowCosts<CostFunction::PRODUCT_SUM>(a, b, width, kernel_size, m, costs, scratch, level);
+            break;
+        case CostFunction::SAD:
+            windowCosts<CostFunction::SAD>(a, b, width, kernel_size, m, costs, scratch, level);
+            break;
+        case CostFunction::SSD:
+            windowCosts<CostFunction::SSD>(a, b, width, kernel_size, m, costs, scratch, level);
+            break;
+    }
+}
+
+
+std::uint64_t blockSadU8(const std::uint8_t     *a,
+                         const std::uint8_t     *b,
+                         std::size_t            stride,
+                         std::size_t            rows,
+                         std::size_t            cols,
+                         SimdLevel              level)
+{
+    if (!simdLevelSupported(level)) {
+        level = simdLevel();
+    }
+
+    switch (level) {
+#if STEREODEPTH_SIMD_X86
+        case SimdLevel::AVX2:
+            return blockSadAvx2(a, b, stride, rows, cols);
+        case SimdLevel::SSE4:
+            return blockSadSse4(a, b, stride, rows, cols);
+#endif
+        default:
+            return blockSadScalar(a, b, stride, rows, cols, 0);
+    }
+}
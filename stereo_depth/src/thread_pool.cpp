@@ -0,0 +1,209 @@
+/***************************************************************************
+ *            thread_pool.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "stereodepth/thread_pool.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+
+
+namespace stereodepth {
+
+namespace {
+
+/// Chunks being executed by this thread, in any pool.
+thread_local SizeType t_depth = 0;
+
+} // namespace
+
+/// A parallel_for in flight; it lives on the stack of the caller.
+struct ThreadPool::Job
+{
+    const RangeFunction* body;
+    std::atomic<SizeType> pending;
+    std::mutex error_mutex;
+    std::exception_ptr error;
+};
+
+ThreadPool::ThreadPool(SizeType num_threads)
+    : _generation{0}
+    , _stop{false}
+{
+    if (num_threads == 0)
+    {
+        num_threads = std::max<SizeType>(std::thread::hardware_concurrency(), 1);
+    }
+    for (SizeType i = 0; i < num_threads; ++i)
+    {
+        _queues.emplace_back(new Queue);
+    }
+    for (SizeType i = 1; i < num_threads; ++i)
+    {
+        _workers.emplace_back(&ThreadPool::worker, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (auto& thread : _workers)
+    {
+        thread.join();
+    }
+}
+
+void ThreadPool::parallel_for(SizeType begin, SizeType end, SizeType grain,
+                              const RangeFunction& body)
+{
+    if (end <= begin) return;
+
+    const SizeType count = end - begin;
+    const SizeType threads = num_threads();
+    if (grain == 0)
+    {
+        grain = std::max<SizeType>(count / (4 * threads), 1);
+    }
+    const SizeType chunks = (count + grain - 1) / grain;
+
+    // Nothing to share, or already inside a chunk: no thread would be free.
+    if (threads == 1 || chunks == 1 || t_depth > 0)
+    {
+        ++t_depth;
+        try
+        {
+            body(begin, end);
+        }
+        catch (...)
+        {
+            --t_depth;
+            throw;
+        }
+        --t_depth;
+        return;
+    }
+
+    std::lock_guard<std::mutex> submit(_submit);
+
+    Job job;
+    job.body = &body;
+    job.pending = chunks;
+
+    // Contiguous blocks of chunks, as rowBand, so each thread starts on
+    // neighbouring rows.
+    for (SizeType q = 0; q < threads; ++q)
+    {
+        const SizeType first = (chunks * q) / threads;
+        const SizeType last = (chunks * (q + 1)) / threads;
+        std::lock_guard<std::mutex> lock(_queues[q]->mutex);
+        for (SizeType c = first; c < last; ++c)
+        {
+            _queues[q]->tasks.push_back(
+                {&job, begin + c * grain, std::min(begin + (c + 1) * grain, end)});
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        ++_generation;
+    }
+    _wake.notify_all();
+
+    drain(0);
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        _done.wait(lock, [&job] { return job.pending.load() == 0; });
+    }
+
+    if (job.error)
+    {
+        std::rethrow_exception(job.error);
+    }
+}
+
+ThreadPool& ThreadPool::global()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::worker(SizeType index)
+{
+    std::uint64_t seen = 0;
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _wake.wait(lock, [this, seen] { return _stop || _generation != seen; });
+            if (_stop) return;
+            seen = _generation;
+        }
+        drain(index);
+    }
+}
+
+bool ThreadPool::pop(SizeType index, Task& task)
+{
+    Queue& queue = *_queues[index];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tasks.empty()) return false;
+    task = queue.tasks.front();
+    queue.tasks.pop_front();
+    return true;
+}
+
+bool ThreadPool::steal(SizeType index, Task& task)
+{
+    const SizeType threads = num_threads();
+    for (SizeType k = 1; k < threads; ++k)
+    {
+        Queue& queue = *_queues[(index + k) % threads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.tasks.empty()) continue;
+        task = queue.tasks.back();
+        queue.tasks.pop_back();
+        return true;
+    }
+    return false;
+}
+
+void ThreadPool::run(const Task& task)
+{
+    Job& job = *task.job;
+    ++t_depth;
+    try
+    {
+        (*job.body)(task.begin, task.end);
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> lock(job.error_mutex);
+        if (!job.error) job.error = std::current_exception();
+    }
+    --t_depth;
+
+    // job may be gone as soon as pending reaches zero.
+    if (job.pending.fetch_sub(1) == 1)
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _done.notify_all();
+    }
+}
+
+void ThreadPool::drain(SizeType index)
+{
+    Task task;
+    while (pop(index, task) || steal(index, task))
+    {
+        run(task);
+    }
+}
+
+} // namespace stereodepth
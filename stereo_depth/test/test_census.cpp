@@ -0,0 +1,120 @@
+/***************************************************************************
+ *            test_census.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "stereodepth/census.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <algorithm>
+
+using namespace std;
+
+class TestCensus {
+public:
+    using TestNumType = uint8_t;
+    using SizeType = std::size_t;
+
+    void test() {
+        TEST_CALL(test_hamming());
+        TEST_CALL(test_transform());
+        TEST_CALL(test_reference());
+        TEST_CALL(test_exposure_shift());
+    }
+
+private:
+    void test_hamming() {
+        TEST_EQUAL(hammingDistance(0, 0), 0);
+        TEST_EQUAL(hammingDistance(0, ~0ull), 64);
+        TEST_EQUAL(hammingDistance(0xF0ull, 0x0Full), 8);
+        TEST_EQUAL(hammingDistance(1ull << 63, 1), 2);
+    }
+
+    void test_transform() {
+        const SizeType width = 12, height = 10;
+        std::vector<TestNumType> flat(width * height, 7);
+        std::vector<uint64_t> census(width * height);
+
+        censusTransform(flat.data(), census.data(), width, height);
+        TEST_ASSERT(std::all_of(census.begin(), census.end(),
+                                [](uint64_t v) { return v == 0; }));
+
+        // Pixel centrale più luminoso dei vicini: tutti i 62 bit a 1
+        flat[5 * width + 6] = 9;
+        censusTransform(flat.data(), census.data(), width, height);
+        TEST_EQUAL(census[5 * width + 6], (1ull << CENSUS_MAX_COST) - 1);
+        // Il vicino (5, 7) vede solo il pixel luminoso, che non è minore
+        TEST_EQUAL(census[5 * width + 7], 0);
+    }
+
+    void test_reference() {
+        const SizeType width = 40, height = 15, kernel_size = 5;
+        const auto src1 = random_matrix<TestNumType>(height, width, 1, 200);
+        const auto src2 = random_matrix<TestNumType>(height, width, 2, 200);
+        std::vector<uint64_t> census1(width * height), census2(width * height);
+        censusTransform(src1.data(), census1.data(), width, height);
+        censusTransform(src2.data(), census2.data(), width, height);
+
+        const SizeType dst_width = width - (kernel_size - 1);
+        const SizeType dst_height = height - (kernel_size - 1);
+        const SizeType pos = kernel_size / 2;
+        std::vector<TestNumType> output(dst_width * dst_height);
+        argMinCensusMat<TestNumType>(src1.data(), src2.data(), output.data(),
+                                     width, height, kernel_size, -3, 10);
+
+        bool equal = true;
+        for (SizeType r = 0; r < dst_height; ++r)
+            for (SizeType x = 0; x < dst_width; ++x) {
+                uint32_t min = CENSUS_MAX_COST + 1;
+                SizeType idx = 0;
+                for (SizeType j = 0; j + kernel_size <= width; ++j) {
+                    const std::int64_t d = std::int64_t(x) - std::int64_t(j);
+                    if (d < -3 || d > 10) continue;
+                    const uint32_t cost = hammingDistance(census1[(r + pos) * width + j + pos],
+                                                          census2[(r + pos) * width + x + pos]);
+                    if (cost <= min) {
+                        min = cost;
+                        idx = j + pos - 1;
+                    }
+                }
+                equal = equal && output[r * dst_width + x] == idx;
+            }
+        TEST_ASSERT(equal);
+    }
+
+    void test_exposure_shift() {
+        const SizeType width = 64, height = 20, kernel_size = 3, shift = 6;
+        const auto src1 = random_matrix<TestNumType>(height, width, 3, 200);
+        std::vector<TestNumType> src2(width * height);
+        // src2(x) = src1(x - shift) con un guadagno di esposizione diverso
+        for (SizeType r = 0; r < height; ++r)
+            for (SizeType c = 0; c < width; ++c)
+                src2[r * width + c] = static_cast<TestNumType>(
+                    src1[r * width + (c >= shift ? c - shift : 0)] + 40);
+
+        const SizeType dst_width = width - (kernel_size - 1);
+        const SizeType dst_height = height - (kernel_size - 1);
+        const SizeType pos = kernel_size / 2;
+        std::vector<uint16_t> output(dst_width * dst_height);
+        argMinCensusMat<TestNumType, MatchingTraits<TestNumType, TestNumType, uint16_t>>(
+            src1.data(), src2.data(), output.data(), width, height, kernel_size, 0, 16);
+
+        // Pixel con finestra census interna ad entrambe le immagini
+        bool equal = true;
+        for (SizeType r = CENSUS_WINDOW_HEIGHT / 2; r + CENSUS_WINDOW_HEIGHT / 2 + pos < height; ++r)
+            for (SizeType x = shift + CENSUS_WINDOW_WIDTH; x + CENSUS_WINDOW_WIDTH < dst_width; ++x)
+                equal = equal && output[r * dst_width + x] == x - shift + pos - 1;
+        TEST_ASSERT(equal);
+    }
+};
+
+int main() {
+    TestCensus().test();
+    return TEST_FAILURES;
+}
@@ -0,0 +1,141 @@
+/***************************************************************************
+ *            test_consistency.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "stereodepth/consistency.hpp"
+#include "stereodepth/census.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace stereodepth;
+
+class TestConsistency {
+public:
+    void test() {
+        TEST_CALL(test_right_disparity());
+        TEST_CALL(test_threshold());
+        TEST_CALL(test_shifted_scene());
+        TEST_CALL(test_overflow());
+    }
+
+private:
+    void test_right_disparity() {
+        CostVolume<double> volume(3, 17, -4, 6);
+        const auto costs = random_matrix<double>(1, volume.size(), 11, 2);
+        std::copy(costs.begin(), costs.end(), volume.data());
+
+        std::vector<std::int16_t> right(volume.height() * volume.width());
+        right_disparity(right.data(), volume, CostOrder::MINIMIZE);
+
+        // Ricerca esplicita lungo la diagonale x = j + d
+        bool equal = true;
+        const auto w = std::int64_t(volume.width());
+        for (SizeType r = 0; r < volume.height(); ++r)
+            for (std::int64_t j = 0; j < w; ++j) {
+                double best = 2.0;
+                std::int64_t best_d = 0;
+                for (SizeType n = 0; n < volume.disparities(); ++n) {
+                    const std::int64_t x = j + volume.disparity(n);
+                    if (x < 0 || x >= w) continue;
+                    if (volume(r, SizeType(x), n) < best) {
+                        best = volume(r, SizeType(x), n);
+                        best_d = volume.disparity(n);
+                    }
+                }
+                equal = equal && right[r * volume.width() + SizeType(j)] == best_d * DISPARITY_SCALE;
+            }
+        TEST_ASSERT(equal);
+    }
+
+    void test_threshold() {
+        // Una riga, 6 finestre, disparità 0..3: costo minimo sulle coppie scelte
+        CostVolume<int> volume(1, 6, 0, 3);
+        volume.fill(10);
+        volume(0, 4, 1) = 1; // x = 4 vede j = 3 con d = 1
+        volume(0, 5, 2) = 0; // j = 3 preferisce x = 5, d = 2
+
+        std::vector<std::int16_t> disparity(6);
+        subpixel_disparity(disparity.data(), volume, CostOrder::MINIMIZE, SubpixelFit::NONE);
+        TEST_EQUAL(disparity[4], 16);
+
+        auto strict = disparity;
+        TEST_EQUAL(left_right_check(strict.data(), volume, CostOrder::MINIMIZE, -1), 0);
+        TEST_ASSERT(strict == disparity);
+        left_right_check(strict.data(), volume, CostOrder::MINIMIZE, 0);
+        TEST_EQUAL(strict[4], invalid_disparity(volume));
+        TEST_EQUAL(strict[5], 32);
+
+        auto loose = disparity;
+        left_right_check(loose.data(), volume, CostOrder::MINIMIZE, 1);
+        TEST_EQUAL(loose[4], 16);
+    }
+
+    void test_shifted_scene() {
+        const SizeType width = 64, height = 14, kernel_size = 3, shift = 5;
+        const auto src1 = random_matrix(height, width, 3, 200);
+        // La banda a sinistra non ha corrispondenze: valori indipendenti
+        auto src2 = random_matrix(height, width, 5, 200);
+        for (SizeType r = 0; r < height; ++r)
+            for (SizeType c = shift; c < width; ++c)
+                src2[r * width + c] = src1[r * width + c - shift];
+
+        std::vector<uint64_t> census1(width * height), census2(width * height);
+        censusTransform(src1.data(), census1.data(), width, height);
+        censusTransform(src2.data(), census2.data(), width, height);
+        CostVolume<uint16_t> volume;
+        costVolumeCensus(census1.data(), census2.data(), volume, width, height,
+                         kernel_size, 0, 12);
+
+        std::vector<std::int16_t> disparity(volume.height() * volume.width());
+        subpixel_disparity(disparity.data(), volume, CostOrder::MINIMIZE, SubpixelFit::NONE);
+        left_right_check(disparity.data(), volume, CostOrder::MINIMIZE, 0);
+
+        // Le finestre interne sono coerenti; la banda occlusa a sinistra è invalidata
+        SizeType valid = 0, occluded_valid = 0;
+        for (SizeType r = CENSUS_WINDOW_HEIGHT / 2; r + CENSUS_WINDOW_HEIGHT < volume.height(); ++r)
+            for (SizeType x = 0; x < volume.width(); ++x) {
+                const auto d = disparity[r * volume.width() + x];
+                if (x >= shift + CENSUS_WINDOW_WIDTH && x + CENSUS_WINDOW_WIDTH < volume.width())
+                    valid += d == shift * DISPARITY_SCALE;
+                if (x < shift)
+                    occluded_valid += d != invalid_disparity(volume);
+            }
+        const SizeType rows = volume.height() - CENSUS_WINDOW_HEIGHT - CENSUS_WINDOW_HEIGHT / 2;
+        TEST_EQUAL(valid, rows * (volume.width() - shift - 2 * CENSUS_WINDOW_WIDTH));
+        TEST_EQUAL(occluded_valid, 0);
+    }
+
+    void test_overflow() {
+        // Disparità oltre DISPARITY_FIXED_MAX non stanno in 16 bit: rifiutate
+        for (std::int64_t min_d : {-DISPARITY_FIXED_MAX - 1, std::int64_t{0}}) {
+            CostVolume<uint16_t> wide(1, 4, min_d, min_d == 0 ? DISPARITY_FIXED_MAX + 1 : 0);
+            wide.fill(0);
+            std::vector<std::int16_t> disparity(4, 7);
+            TEST_THROWS(right_disparity(disparity.data(), wide, CostOrder::MINIMIZE), std::invalid_argument);
+            TEST_THROWS(left_right_check(disparity.data(), wide, CostOrder::MINIMIZE, 0), std::invalid_argument);
+            TEST_EQUAL(disparity[0], 7);
+            // Controllo disabilitato: nessuna scrittura, nessun errore
+            TEST_EQUAL(left_right_check(disparity.data(), wide, CostOrder::MINIMIZE, -1), 0);
+        }
+
+        CostVolume<uint16_t> limit(1, 4, -DISPARITY_FIXED_MAX, DISPARITY_FIXED_MAX);
+        limit.fill(0);
+        std::vector<std::int16_t> right(4);
+        right_disparity(right.data(), limit, CostOrder::MINIMIZE);
+        // Al limite è accettato; a pari merito vince la disparità più grande nella riga
+        TEST_EQUAL(right[0], 3 * DISPARITY_SCALE);
+    }
+};
+
+int main() {
+    TestConsistency().test();
+    return TEST_FAILURES;
+}
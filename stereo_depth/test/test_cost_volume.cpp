@@ -0,0 +1,143 @@
+/***************************************************************************
+ *            test_cost_volume.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "stereodepth/cost_volume.hpp"
+#include "stereodepth/running_sum.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace stereodepth;
+
+class TestCostVolume {
+public:
+    using TestNumType = uint8_t;
+
+    void test() {
+        TEST_CALL(test_shape());
+        TEST_CALL(test_layout());
+        TEST_CALL(test_reuse());
+        TEST_CALL(test_move());
+        TEST_CALL(test_running_sum_wta());
+    }
+
+private:
+    void test_shape() {
+        CostVolume<TestNumType> volume(4, 5, -2, 3);
+        TEST_EQUAL(volume.height(), 4);
+        TEST_EQUAL(volume.width(), 5);
+        TEST_EQUAL(volume.disparities(), 6);
+        TEST_EQUAL(volume.size(), 4 * 5 * 6);
+        TEST_EQUAL(volume.min_disparity(), -2);
+        TEST_EQUAL(volume.max_disparity(), 3);
+        TEST_EQUAL(volume.disparity(0), -2);
+        TEST_EQUAL(reinterpret_cast<std::uintptr_t>(volume.data())
+            % CostVolume<TestNumType>::ALIGNMENT, 0);
+        TEST_THROWS(volume.resize(4, 5, 3, 2), std::invalid_argument);
+    }
+
+    void test_layout() {
+        for (auto layout : {CostVolume<int>::Layout::HWD,
+                            CostVolume<int>::Layout::DHW})
+        {
+            CostVolume<int> volume(3, 4, 0, 4, layout);
+            for (SizeType r = 0; r < 3; ++r)
+                for (SizeType c = 0; c < 4; ++c)
+                    for (SizeType n = 0; n < 5; ++n)
+                        volume(r, c, n) = static_cast<int>(100 * r + 10 * c + n);
+
+            TEST_EQUAL(volume(2, 3, 4), 234);
+            TEST_EQUAL(volume.data()[volume.index(1, 2, 3)], 123);
+            TEST_EQUAL(volume.data()[volume.index(1, 2, 0)
+                + 3 * volume.disparity_stride()], 123);
+            TEST_EQUAL(volume.data()[volume.index(1, 0, 3)
+                + 2 * volume.col_stride()], 123);
+            TEST_EQUAL(volume.data()[volume.index(0, 2, 3)
+                + 1 * volume.row_stride()], 123);
+        }
+        CostVolume<int> hwd(3, 4, 0, 4, CostVolume<int>::Layout::HWD);
+        TEST_EQUAL(hwd.disparity_stride(), 1);
+        CostVolume<int> dhw(3, 4, 0, 4, CostVolume<int>::Layout::DHW);
+        TEST_EQUAL(dhw.col_stride(), 1);
+    }
+
+    void test_reuse() {
+        CostVolume<TestNumType> volume;
+        TEST_ASSERT(volume.resize(10, 20, 0, 15));
+        const TestNumType* data = volume.data();
+        TEST_ASSERT(!volume.resize(10, 20, 0, 15));
+        TEST_ASSERT(!volume.resize(5, 20, 0, 15));
+        TEST_ASSERT(volume.data() == data);
+        TEST_EQUAL(volume.capacity(), 10 * 20 * 16);
+        TEST_ASSERT(volume.resize(11, 20, 0, 15));
+    }
+
+    void test_move() {
+        CostVolume<TestNumType> v(4, 5, -2, 3);
+        v.fill(1);
+        const TestNumType* data = v.data();
+
+        // Il volume spostato resta vuoto: resize rialloca e fill non
+        // scrive nel buffer del nuovo proprietario
+        CostVolume<TestNumType> w(std::move(v));
+        TEST_ASSERT(w.data() == data);
+        TEST_ASSERT(v.data() == nullptr);
+        TEST_EQUAL(v.capacity(), 0);
+        TEST_EQUAL(v.size(), 0);
+        TEST_ASSERT(v.resize(4, 5, -2, 3));
+        TEST_ASSERT(v.data() != w.data());
+        v.fill(7);
+        TEST_EQUAL(w(3, 4, 5), 1);
+
+        CostVolume<TestNumType> z;
+        z = std::move(w);
+        TEST_ASSERT(z.data() == data);
+        TEST_ASSERT(w.data() == nullptr);
+        TEST_EQUAL(w.capacity(), 0);
+        TEST_EQUAL(z.min_disparity(), -2);
+        TEST_EQUAL(z.disparities(), 6);
+    }
+
+    void test_running_sum_wta() {
+        const SizeType width = 40, height = 14;
+        const auto src1 = random_matrix<TestNumType>(height, width, 1);
+        const auto src2 = random_matrix<TestNumType>(height, width, 2);
+
+        const std::int64_t ranges[][2] = {
+            {DISPARITY_MIN_UNBOUNDED, DISPARITY_MAX_UNBOUNDED},
+            {0, 12}, {-5, 5}, {60, 70}
+        };
+        for (auto layout : {CostVolume<TestNumType>::Layout::HWD,
+                            CostVolume<TestNumType>::Layout::DHW})
+        {
+            CostVolume<TestNumType> volume(layout);
+            for (SizeType k = 3; k <= 9; k += 2)
+            {
+                const SizeType dst_size = (width - (k - 1)) * (height - (k - 1));
+                std::vector<TestNumType> truth(dst_size), output(dst_size);
+                for (const auto& range : ranges)
+                {
+                    argMaxCorrMat<TestNumType>(src1.data(), src2.data(),
+                        truth.data(), width, height, k, range[0], range[1]);
+                    costVolumeRunningSum<TestNumType>(src1.data(), src2.data(),
+                        volume, width, height, k, range[0], range[1]);
+                    winner_takes_all(output.data(), volume, k);
+                    TEST_ASSERT(output == truth);
+                }
+            }
+        }
+    }
+};
+
+int main() {
+    TestCostVolume().test();
+    return TEST_FAILURES;
+}
@@ -0,0 +1,339 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Alessio Zattoni                                    *
+ *                                                                          *
+ * This file is part of CrossCorrelation.                                   *
+ *                                                                          *
+ *   CrossCorrelation is free software: you can redistribute it and/or      *
+ *   modify it under the terms of the GNU Lesser General Public License as  *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   CrossCorrelation is distributed in the hope that it will be            *
+ *   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+
+/**
+ * @file    test_cross_correlation.cpp
+ * @author  Alessio Zattoni
+ * @date
+ * @brief   Questo file contiene i test delle varianti CPU della cross-correlazione
+ *
+ * ...
+ */
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "stereodepth/cross_correlation.hpp"
+#include "stereodepth/running_sum.hpp"
+
+#include <vector>
+#include <random>
+
+/// Seme del generatore di numeri casuali
+#define SEED    42
+/// Range dei valori delle matrici → da 0 a RANGE - 1
+#define RANGE   50
+
+
+class TestCrossCorrelation {
+public:
+    void test() {
+        TEST_CALL(test_disparity_search_range());
+        TEST_CALL(test_unbounded_disparity());
+        TEST_CALL(test_bounded_disparity());
+        TEST_CALL(test_running_sum());
+        TEST_CALL(test_parallel());
+        TEST_CALL(test_wide_traits());
+        TEST_CALL(test_fixed_kernel());
+        TEST_CALL(test_peak_tracker());
+        TEST_CALL(test_confidence());
+    }
+
+private:
+    // Ricerca esaustiva che scarta i candidati fuori da [min_d, max_d]
+    template <typename Acc = uint8_t, typename Out = uint8_t>
+    static std::vector<Out> reference(const std::vector<uint8_t> &src1,
+                                          const std::vector<uint8_t> &src2,
+                                          std::size_t width, std::size_t height,
+                                          std::size_t kernel_size,
+                                          std::int64_t min_d, std::int64_t max_d)
+    {
+        const std::size_t dst_w = width - (kernel_size - 1);
+        const std::size_t dst_h = height - (kernel_size - 1);
+        std::vector<Out> dst(dst_w * dst_h);
+        for (std::size_t r = 0; r < dst_h; r++) {
+            for (std::size_t x = 0; x < dst_w; x++) {
+                Acc max{0};
+                std::size_t max_idx{0};
+                for (std::size_t j = 0; j + kernel_size <= width; j++) {
+                    const std::int64_t d = static_cast<std::int64_t>(x) - static_cast<std::int64_t>(j);
+                    if (d < min_d || d > max_d) {
+                        continue;
+                    }
+                    Acc tmp = 0;
+                    for (std::size_t a = 0; a < kernel_size; a++) {
+                        for (std::size_t b = 0; b < kernel_size; b++) {
+                            tmp += src1[(r + a) * width + j + b] * src2[(r + a) * width + x + b];
+                        }
+                    }
+                    if (tmp >= max) {
+                        max = tmp;
+                        max_idx = j + (kernel_size / 2) - 1;
+                    }
+                }
+                dst[r * dst_w + x] = static_cast<Out>(max_idx);
+            }
+        }
+        return dst;
+    }
+
+    void test_disparity_search_range() {
+        std::size_t begin, end;
+
+        disparitySearchRange(10, 3, 40, 0, 4, begin, end);
+        TEST_EQUAL(begin, 7);
+        TEST_EQUAL(end, 12);
+
+        disparitySearchRange(2, 3, 40, 0, 4, begin, end);
+        TEST_EQUAL(begin, 1);
+        TEST_EQUAL(end, 4);
+
+        disparitySearchRange(1, 3, 40, 5, 8, begin, end);
+        TEST_EQUAL(begin, end);
+
+        disparitySearchRange(0, 5, 40, DISPARITY_MIN_UNBOUNDED, DISPARITY_MAX_UNBOUNDED, begin, end);
+        TEST_EQUAL(begin, 2);
+        TEST_EQUAL(end, 38);
+    }
+
+    void test_unbounded_disparity() {
+        const std::size_t width = 37, height = 11, kernel_size = 5;
+        const auto src1 = random_matrix(height, width, SEED + height * width, RANGE);
+        const auto src2 = random_matrix(height + 1, width, SEED + (height + 1) * width, RANGE);
+        const std::size_t dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+        std::vector<uint8_t> dst(dst_size), dst_copy(dst_size);
+
+        argMaxCorrMat<uint8_t>(src1.data(), src2.data(), dst.data(), width, height, kernel_size);
+        argMaxCorrMatWithCopy<uint8_t>(src1.data(), src2.data(), dst_copy.data(), width, height, kernel_size);
+
+        const auto truth = reference(src1, src2, width, height, kernel_size,
+                                     DISPARITY_MIN_UNBOUNDED, DISPARITY_MAX_UNBOUNDED);
+        TEST_ASSERT(dst == truth);
+        TEST_ASSERT(dst_copy == truth);
+    }
+
+    void test_bounded_disparity() {
+        const std::size_t width = 41, height = 9, kernel_size = 3;
+        const auto src1 = random_matrix(height, width, SEED + height * width, RANGE);
+        const auto src2 = random_matrix(height + 1, width, SEED + (height + 1) * width, RANGE);
+        const std::size_t dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+        std::vector<uint8_t> dst(dst_size), dst_copy(dst_size);
+
+        const std::int64_t ranges[][2] = {{0, 8}, {2, 5}, {-3, 3}, {0, 0}, {-6, -1}};
+        for (const auto &range : ranges) {
+            argMaxCorrMat<uint8_t>(src1.data(), src2.data(), dst.data(),
+                                   width, height, kernel_size, range[0], range[1]);
+            argMaxCorrMatWithCopy<uint8_t>(src1.data(), src2.data(), dst_copy.data(),
+                                           width, height, kernel_size, range[0], range[1]);
+
+            const auto truth = reference(src1, src2, width, height, kernel_size, range[0], range[1]);
+            TEST_ASSERT(dst == truth);
+            TEST_ASSERT(dst_copy == truth);
+        }
+    }
+
+    void test_running_sum() {
+        const std::size_t width = 45, height = 17;
+        const auto src1 = random_matrix(height, width, SEED + height * width, RANGE);
+        const auto src2 = random_matrix(height + 1, width, SEED + (height + 1) * width, RANGE);
+
+        const std::int64_t ranges[][2] = {
+            {DISPARITY_MIN_UNBOUNDED, DISPARITY_MAX_UNBOUNDED}, {0, 16}, {-4, 7}, {3, 3}, {50, 60}
+        };
+        for (std::size_t kernel_size = 3; kernel_size <= 11; kernel_size += 2) {
+            const std::size_t dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+            std::vector<uint8_t> dst(dst_size), truth(dst_size);
+            for (const auto &range : ranges) {
+                argMaxCorrMat<uint8_t>(src1.data(), src2.data(), truth.data(),
+                                       width, height, kernel_size, range[0], range[1]);
+                argMaxCorrMatRunningSum<uint8_t>(src1.data(), src2.data(), dst.data(),
+                                                 width, height, kernel_size, range[0], range[1]);
+                TEST_ASSERT(dst == truth);
+            }
+        }
+    }
+
+    void test_parallel() {
+        const std::size_t width = 39, height = 23, kernel_size = 5;
+        const auto src1 = random_matrix(height, width, SEED + height * width, RANGE);
+        const auto src2 = random_matrix(height + 1, width, SEED + (height + 1) * width, RANGE);
+        const std::size_t dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+        std::vector<uint8_t> truth(dst_size), dst(dst_size);
+
+        argMaxCorrMat<uint8_t>(src1.data(), src2.data(), truth.data(), width, height, kernel_size, -4, 9);
+        for (std::size_t threads : {0, 1, 2, 3, 5, 8, 32}) {
+            std::fill(dst.begin(), dst.end(), 0);
+            argMaxCorrMatParallel<uint8_t>(src1.data(), src2.data(), dst.data(),
+                                           width, height, kernel_size, threads, -4, 9);
+            TEST_ASSERT(dst == truth);
+        }
+    }
+
+    void test_wide_traits() {
+        using Traits = WideMatchingTraits<uint8_t>;
+
+        const std::size_t width = 300, height = 5, kernel_size = 3;
+        const auto src1 = random_matrix(height, width, SEED + height * width, RANGE);
+        const auto src2 = random_matrix(height + 1, width, SEED + (height + 1) * width, RANGE);
+        const std::size_t dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+        std::vector<uint16_t> dst(dst_size), dst_copy(dst_size), dst_sum(dst_size), dst_par(dst_size);
+
+        argMaxCorrMat<uint8_t, Traits>(src1.data(), src2.data(), dst.data(), width, height, kernel_size);
+        argMaxCorrMatWithCopy<uint8_t, Traits>(src1.data(), src2.data(), dst_copy.data(),
+                                               width, height, kernel_size);
+        argMaxCorrMatRunningSum<uint8_t, Traits>(src1.data(), src2.data(), dst_sum.data(),
+                                                 width, height, kernel_size);
+        argMaxCorrMatParallel<uint8_t, Traits>(src1.data(), src2.data(), dst_par.data(),
+                                               width, height, kernel_size, 3);
+
+        const auto truth = reference<uint32_t, uint16_t>(src1, src2, width, height, kernel_size,
+                                                         DISPARITY_MIN_UNBOUNDED, DISPARITY_MAX_UNBOUNDED);
+        TEST_ASSERT(dst == truth);
+        TEST_ASSERT(dst_copy == truth);
+        TEST_ASSERT(dst_sum == truth);
+        TEST_ASSERT(dst_par == truth);
+        // Con destinazione a 16 bit le colonne oltre 255 sono rappresentabili
+        TEST_ASSERT(*std::max_element(dst.begin(), dst.end()) > 255);
+    }
+
+    void test_fixed_kernel() {
+        const std::size_t width = 43, height = 19;
+        const auto src1 = random_matrix(height, width, SEED + height * width, RANGE);
+        const auto src2 = random_matrix(height + 1, width, SEED + (height + 1) * width, RANGE);
+
+        const std::int64_t ranges[][2] = {
+            {DISPARITY_MIN_UNBOUNDED, DISPARITY_MAX_UNBOUNDED}, {0, 12}, {-5, 6}
+        };
+        // 13 e 15 non hanno una specializzazione e usano la versione generica
+        for (std::size_t kernel_size = 3; kernel_size <= 15; kernel_size += 2) {
+            const std::size_t dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+            std::vector<uint8_t> dst(dst_size), truth(dst_size);
+            std::vector<float> dst_f(dst_size), truth_f(dst_size);
+            const std::vector<float> src1_f(src1.begin(), src1.end()), src2_f(src2.begin(), src2.end());
+            for (const auto &range : ranges) {
+                argMaxCorrMat<uint8_t>(src1.data(), src2.data(), truth.data(),
+                                       width, height, kernel_size, range[0], range[1]);
+                argMaxCorrMatDispatch<uint8_t>(src1.data(), src2.data(), dst.data(),
+                                               width, height, kernel_size, range[0], range[1]);
+                TEST_ASSERT(dst == truth);
+
+                argMaxCorrMat<float>(src1_f.data(), src2_f.data(), truth_f.data(),
+                                     width, height, kernel_size, range[0], range[1]);
+                argMaxCorrMatDispatch<float>(src1_f.data(), src2_f.data(), dst_f.data(),
+                                             width, height, kernel_size, range[0], range[1]);
+                TEST_ASSERT(dst_f == truth_f);
+            }
+        }
+    }
+
+    void test_peak_tracker() {
+        // Il secondo candidato non può essere adiacente al massimo finale
+        PeakTracker<int> peak(0);
+        for (int cost : {1, 8, 9, 10}) peak.update(cost);
+        TEST_EQUAL(peak.best_pos, 3);
+        TEST_ASSERT(peak.hasSecond());
+        TEST_EQUAL(peak.second(), 8);
+        TEST_EQUAL(peak.confidence(), 51);
+        TEST_EQUAL(peak.confidence(25), 0);
+
+        PeakTracker<int> valley(100, false);
+        for (int cost : {7, 3, 4, 9, 6}) valley.update(cost);
+        TEST_EQUAL(valley.best_pos, 1);
+        TEST_EQUAL(valley.second(), 6);
+        TEST_EQUAL(valley.confidence(), 127);
+
+        // Un solo massimo senza altri candidati oltre i vicini
+        PeakTracker<int> single(0);
+        for (int cost : {2, 5, 3}) single.update(cost);
+        TEST_ASSERT(!single.hasSecond());
+        TEST_EQUAL(single.confidence(10), CONFIDENCE_MAX);
+    }
+
+    void test_confidence() {
+        using Traits = WideMatchingTraits<uint8_t>;
+
+        const std::size_t width = 47, height = 9, kernel_size = 5;
+        const std::size_t dst_w = width - (kernel_size - 1), dst_h = height - (kernel_size - 1);
+        const auto src1 = random_matrix(height, width, SEED + height * width, RANGE);
+        const auto src2 = random_matrix(height + 1, width, SEED + (height + 1) * width, RANGE);
+        std::vector<uint16_t> dst(dst_w * dst_h), truth(dst_w * dst_h);
+        std::vector<uint8_t> confidence(dst_w * dst_h);
+
+        for (int ratio : {0, 5}) {
+            argMaxCorrMat<uint8_t, Traits>(src1.data(), src2.data(), truth.data(),
+                                           width, height, kernel_size, -3, 11);
+            argMaxCorrMat<uint8_t, Traits>(src1.data(), src2.data(), dst.data(),
+                                           width, height, kernel_size, -3, 11, confidence.data(), ratio);
+            TEST_ASSERT(dst == truth);
+
+            // Le varianti con kernel a dimensione fissa e parallele tracciano lo stesso picco
+            std::vector<uint16_t> other(dst.size());
+            std::vector<uint8_t> other_confidence(confidence.size());
+            argMaxCorrMatDispatch<uint8_t, Traits>(src1.data(), src2.data(), other.data(), width, height, kernel_size,
+                                                   -3, 11, other_confidence.data(), ratio);
+            TEST_ASSERT(other == truth);
+            TEST_ASSERT(other_confidence == confidence);
+            std::fill(other_confidence.begin(), other_confidence.end(), 0);
+            argMaxCorrMatParallel<uint8_t, Traits>(src1.data(), src2.data(), other.data(), width, height, kernel_size,
+                                                   3, -3, 11, other_confidence.data(), ratio);
+            TEST_ASSERT(other == truth);
+            TEST_ASSERT(other_confidence == confidence);
+
+            // Secondo massimo esaustivo fuori dall'intorno ±1 del massimo
+            bool equal = true;
+            for (std::size_t r = 0; r < dst_h; r++) {
+                for (std::size_t x = 0; x < dst_w; x++) {
+                    std::vector<std::pair<std::size_t, double>> costs;
+                    for (std::size_t j = 0; j + kernel_size <= width; j++) {
+                        const std::int64_t d = std::int64_t(x) - std::int64_t(j);
+                        if (d < -3 || d > 11) continue;
+                        double tmp = 0;
+                        for (std::size_t a = 0; a < kernel_size; a++)
+                            for (std::size_t b = 0; b < kernel_size; b++)
+                                tmp += src1[(r + a) * width + j + b] * src2[(r + a) * width + x + b];
+                        costs.emplace_back(j + kernel_size / 2 - 1, tmp);
+                    }
+                    std::size_t best_idx = 0;
+                    double best = -1;
+                    for (const auto &c : costs)
+                        if (c.second >= best) { best = c.second; best_idx = c.first; }
+                    double second = -1;
+                    for (const auto &c : costs)
+                        if (c.first + 1 < best_idx || c.first > best_idx + 1) second = std::max(second, c.second);
+
+                    uint8_t expected = CONFIDENCE_MAX;
+                    if (second >= 0) {
+                        expected = best > 0 ? uint8_t((best - second) / best * CONFIDENCE_MAX) : 0;
+                        if (ratio > 0 && best <= second * (100.0 + ratio) / 100.0) expected = 0;
+                    }
+                    equal = equal && confidence[r * dst_w + x] == expected;
+                }
+            }
+            TEST_ASSERT(equal);
+        }
+        // Le immagini casuali hanno picchi ambigui: il test di unicità ne scarta una parte
+        TEST_ASSERT(std::count(confidence.begin(), confidence.end(), 0) > 0);
+    }
+};
+
+
+int main() {
+    TestCrossCorrelation().test();
+    return TEST_FAILURES;
+}
@@ -0,0 +1,136 @@
+/***************************************************************************
+ *            test_incremental.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "stereodepth/incremental.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <mutex>
+
+using namespace std;
+using namespace stereodepth;
+
+class TestIncremental {
+public:
+    void test() {
+        TEST_CALL(test_block_sad());
+        TEST_CALL(test_dirty_tiles());
+        TEST_CALL(test_threshold());
+        TEST_CALL(test_errors());
+    }
+
+private:
+    static const SizeType width = 64, height = 24, kernel_size = 5;
+
+    static TileConfig small_tiles()
+    {
+        TileConfig config;
+        config.tile_width = 12;
+        config.tile_height = 5;
+        return config;
+    }
+
+    void test_block_sad() {
+        const std::vector<float> a = {1.0f, 2.0f, 3.0f, 4.0f};
+        const std::vector<float> b = {2.0f, 2.0f, 1.0f, 9.0f};
+        TEST_EQUAL(block_sad(a.data(), b.data(), 2, 2, 2), 8.0);
+        TEST_EQUAL(block_sad(a.data(), b.data(), 2, 2, 1), 3.0);
+        const std::vector<uint8_t> c = {1, 200, 3, 4}, d = {2, 0, 1, 9};
+        TEST_EQUAL(block_sad(c.data(), d.data(), 2, 2, 2), 208.0);
+    }
+
+    void test_dirty_tiles() {
+        using Wide = WideMatchingTraits<uint8_t>;
+        auto src1 = random_matrix(height, width, 1);
+        auto src2 = random_matrix(height, width, 2);
+        const SizeType dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+        std::vector<uint16_t> truth(dst_size), dst(dst_size);
+
+        IncrementalMatcher<uint8_t, Wide> matcher(width, height, kernel_size, -2, 14, small_tiles());
+        const SizeType tiles = matcher.tiled().tiles().size();
+        TEST_ASSERT(tiles > 4);
+
+        // Primo frame: tutti i tile
+        argMaxCorrMat<uint8_t, Wide>(src1.data(), src2.data(), truth.data(), width, height, kernel_size, -2, 14);
+        TEST_ASSERT(matcher.execute(src1.data(), src2.data(), dst.data()) == PlanStatus::OK);
+        TEST_ASSERT(dst == truth);
+        TEST_EQUAL(matcher.recomputed_fraction(), 1.0);
+
+        // Frame identico: nessun tile, la destinazione viene dalla cache
+        std::fill(dst.begin(), dst.end(), 0);
+        TEST_ASSERT(matcher.execute(src1.data(), src2.data(), dst.data()) == PlanStatus::OK);
+        TEST_EQUAL(matcher.recomputed_tiles(), 0);
+        TEST_ASSERT(dst == truth);
+
+        // Un pixel cambiato in ciascuna sorgente: solo i tile che lo leggono
+        ThreadPool pool(3);
+        std::mutex mutex;
+        SizeType callbacks = 0;
+        for (int frame = 0; frame < 3; ++frame) {
+            src1[(3 + frame) * width + 40] ^= 0x3F;
+            src2[(17 - frame) * width + 9] ^= 0x3F;
+            argMaxCorrMat<uint8_t, Wide>(src1.data(), src2.data(), truth.data(), width, height, kernel_size, -2, 14);
+            callbacks = 0;
+            TEST_ASSERT(matcher.execute(src1.data(), src2.data(), dst.data(), pool,
+                                        [&](const Tile&) { std::lock_guard<std::mutex> lock(mutex); ++callbacks; })
+                        == PlanStatus::OK);
+            TEST_ASSERT(dst == truth);
+            TEST_ASSERT(matcher.recomputed_tiles() > 0);
+            TEST_ASSERT(matcher.recomputed_fraction() < 0.5);
+            TEST_EQUAL(callbacks, matcher.recomputed_tiles());
+        }
+
+        matcher.reset();
+        TEST_ASSERT(matcher.execute(src1.data(), src2.data(), dst.data()) == PlanStatus::OK);
+        TEST_EQUAL(matcher.recomputed_tiles(), tiles);
+    }
+
+    void test_threshold() {
+        auto src1 = random_matrix(height, width, 3);
+        auto src2 = random_matrix(height, width, 4);
+        const SizeType dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+        std::vector<uint8_t> first(dst_size), dst(dst_size);
+
+        IncrementalMatcher<uint8_t> matcher(width, height, kernel_size, 0, 20, small_tiles(), 1.5);
+        TEST_ASSERT(matcher.execute(src1.data(), src2.data(), first.data()) == PlanStatus::OK);
+
+        // Rumore di un livello su ogni pixel: sotto la soglia, mappa invariata
+        for (auto &v : src1) ++v;
+        for (auto &v : src2) ++v;
+        TEST_ASSERT(matcher.execute(src1.data(), src2.data(), dst.data()) == PlanStatus::OK);
+        TEST_EQUAL(matcher.recomputed_tiles(), 0);
+        TEST_ASSERT(dst == first);
+
+        // Un cambiamento forte supera la soglia
+        for (auto &v : src2) v = static_cast<uint8_t>(v + 40);
+        TEST_ASSERT(matcher.execute(src1.data(), src2.data(), dst.data()) == PlanStatus::OK);
+        TEST_EQUAL(matcher.recomputed_fraction(), 1.0);
+    }
+
+    void test_errors() {
+        const auto src = random_matrix(height, width, 5);
+        std::vector<uint8_t> dst(10, 7);
+
+        IncrementalMatcher<uint8_t> bad(width, height, 2);
+        TEST_ASSERT(bad.status() == PlanStatus::INVALID_KERNEL_SIZE);
+        TEST_ASSERT(bad.execute(src.data(), src.data(), dst.data()) == PlanStatus::INVALID_PLAN);
+        TEST_EQUAL(bad.recomputed_fraction(), 0.0);
+
+        IncrementalMatcher<uint8_t> matcher(width, height, kernel_size);
+        TEST_ASSERT(matcher.execute(src.data(), src.data(), nullptr) == PlanStatus::NULL_POINTER);
+        TEST_ASSERT(!matcher.has_history());
+        for (uint8_t v : dst) TEST_EQUAL(v, 7);
+    }
+};
+
+int main() {
+    TestIncremental().test();
+    return TEST_FAILURES;
+}
@@ -52,6 +52,9 @@ public:
         TEST_CALL(test_squared_diff_with_channels_offset());
         TEST_CALL(test_absolute_diff_without_channels_offset());
         TEST_CALL(test_absolute_diff_with_channels_offset());
+        TEST_CALL(test_kernel_slide_parallel());
+        TEST_CALL(test_kernel_slide_functor());
+        TEST_CALL(test_kernel_slide_interior());
     }
 
 private:
@@ -93,6 +96,15 @@ private:
         TEST_EQUAL(shape_3d[2], c);
         TEST_FAIL((void) shape_3d.at(3));
         TEST_THROWS((void) shape_3d.at(3), std::out_of_range);
+
+        // Le shape sono utilizzabili a tempo di compilazione
+        constexpr Math::Shape2d const_2d(4, 5);
+        constexpr Math::Shape3d const_3d(const_2d);
+        static_assert(const_2d.size() == 20, "Shape2d constexpr size");
+        static_assert(const_3d.channels() == 1, "Shape3d constexpr channels");
+        static_assert(Math::Shape3d(2, 3, 4).size() == 24, "Shape3d constexpr size");
+        static_assert(sizeof(Math::Shape3d) == 3 * sizeof(SizeType),
+                      "Shape3d stored inline");
     }
 
     void test_argmax() {
@@ -2267,6 +2279,185 @@ private:
             }
         }
     }
+
+    void test_kernel_slide_parallel() {
+        SizeType input_width = 23;
+        SizeType input_height = 17;
+        SizeType input_channels = 2;
+        SizeType f = 3;
+        std::mt19937 gen(7);
+        std::uniform_real_distribution<TestNumType> dist(-1.0, 1.0);
+        std::vector<TestNumType> test_img(
+            input_width * input_height * input_channels);
+        std::vector<TestNumType> test_k(f * f * input_channels);
+        for (auto& v : test_img) v = dist(gen);
+        for (auto& v : test_k) v = dist(gen);
+
+        SizeType output_width = input_width - f + 3;
+        SizeType output_height = input_height - f + 3;
+        std::vector<TestNumType> truth(output_width * output_height);
+        std::vector<TestNumType> parallel_result(truth.size());
+
+        for (SizeType threads : {0, 2, 3, 7})
+        {
+            Math::cross_correlation<TestNumType>(
+                truth.data(), test_img.data(),
+                {input_height, input_width, input_channels},
+                test_k.data(), {f, f}, {1, 1}, {1, 1});
+            Math::cross_correlation<TestNumType>(
+                parallel_result.data(), test_img.data(),
+                {input_height, input_width, input_channels},
+                test_k.data(), {f, f}, {1, 1}, {1, 1}, threads);
+            TEST_ASSERT(truth == parallel_result);
+
+            Math::squared_diff<TestNumType>(
+                truth.data(), test_img.data(),
+                {input_height, input_width, input_channels},
+                test_k.data(), {f, f}, {1, 1}, {1, 1});
+            Math::squared_diff<TestNumType>(
+                parallel_result.data(), test_img.data(),
+                {input_height, input_width, input_channels},
+                test_k.data(), {f, f}, {1, 1}, {1, 1}, threads);
+            TEST_ASSERT(truth == parallel_result);
+
+            Math::absolute_diff_offset<TestNumType>(
+                truth.data(), test_img.data(),
+                {input_height, input_width, input_channels},
+                test_img.data(), {input_height, input_width}, {f, f}, {4, 5},
+                {1, 1}, {1, 1});
+            Math::absolute_diff_offset<TestNumType>(
+                parallel_result.data(), test_img.data(),
+                {input_height, input_width, input_channels},
+                test_img.data(), {input_height, input_width}, {f, f}, {4, 5},
+                {1, 1}, {1, 1}, threads);
+            TEST_ASSERT(truth == parallel_result);
+        }
+    }
+    void test_kernel_slide_functor() {
+        using Operation = std::function<void(
+            TestNumType*, Math::Shape2d, Math::Coord2d,
+            const TestNumType*, Math::Shape3d,
+            const TestNumType*, Math::Shape2d, Math::Shape2d, Math::Shape2d,
+            int64_t, int64_t)>;
+        SizeType input_width = 19;
+        SizeType input_height = 13;
+        SizeType input_channels = 3;
+        SizeType f = 3;
+        std::mt19937 gen(11);
+        std::uniform_real_distribution<TestNumType> dist(-1.0, 1.0);
+        std::vector<TestNumType> test_img(
+            input_width * input_height * input_channels);
+        std::vector<TestNumType> test_k(f * f * input_channels);
+        for (auto& v : test_img) v = dist(gen);
+        for (auto& v : test_k) v = dist(gen);
+
+        SizeType output_width = (input_width - f + 2) / 2 + 1;
+        SizeType output_height = (input_height - f + 2) / 2 + 1;
+        std::vector<TestNumType> truth(output_width * output_height);
+        std::vector<TestNumType> functor_result(truth.size());
+        ThreadPool pool(3);
+
+        // La versione std::function e quella a funtore coincidono
+        Math::kernel_slide<TestNumType>(
+            Operation(Math::SquaredDiffOp()), truth.data(), test_img.data(),
+            {input_height, input_width, input_channels},
+            test_k.data(), {f, f}, {f, f}, {0, 0}, {2, 2}, {1, 1});
+        Math::kernel_slide<TestNumType>(
+            Math::SquaredDiffOp(), functor_result.data(), test_img.data(),
+            {input_height, input_width, input_channels},
+            test_k.data(), {f, f}, {f, f}, {0, 0}, {2, 2}, {1, 1});
+        TEST_ASSERT(truth == functor_result);
+
+        std::fill(functor_result.begin(), functor_result.end(), 0);
+        Math::kernel_slide_parallel<TestNumType>(
+            2, Math::SquaredDiffOp(), functor_result.data(), test_img.data(),
+            {input_height, input_width, input_channels},
+            test_k.data(), {f, f}, {f, f}, {0, 0}, {2, 2}, {1, 1});
+        TEST_ASSERT(truth == functor_result);
+
+        std::fill(functor_result.begin(), functor_result.end(), 0);
+        Math::kernel_slide_parallel<TestNumType>(
+            pool, Operation(Math::SquaredDiffOp()), functor_result.data(),
+            test_img.data(), {input_height, input_width, input_channels},
+            test_k.data(), {f, f}, {f, f}, {0, 0}, {2, 2}, {1, 1});
+        TEST_ASSERT(truth == functor_result);
+
+        // Anche una lambda passa per la versione a template
+        SizeType calls = 0;
+        Math::kernel_slide<TestNumType>(
+            [&calls](TestNumType* dst, const Math::Shape2d& dst_shape,
+                     Math::Coord2d dst_coord, const TestNumType*,
+                     const Math::Shape3d&, const TestNumType*,
+                     const Math::Shape2d&, const Math::Shape2d&,
+                     const Math::Shape2d&, int64_t, int64_t) {
+                dst[dst_coord.row * dst_shape.width() + dst_coord.col] = 1;
+                ++calls;
+            },
+            functor_result.data(), test_img.data(),
+            {input_height, input_width, input_channels},
+            test_k.data(), {f, f}, {f, f}, {0, 0}, {2, 2}, {1, 1});
+        TEST_EQUAL(calls, truth.size());
+        TEST_EQUAL(functor_result.front(), 1);
+    }
+    void test_kernel_slide_interior() {
+        using Operation = std::function<void(
+            TestNumType*, Math::Shape2d, Math::Coord2d,
+            const TestNumType*, Math::Shape3d,
+            const TestNumType*, Math::Shape2d, Math::Shape2d, Math::Shape2d,
+            int64_t, int64_t)>;
+        SizeType input_width = 21;
+        SizeType input_height = 16;
+        std::mt19937 gen(13);
+        std::uniform_real_distribution<TestNumType> dist(-1.0, 1.0);
+        std::vector<TestNumType> test_img(input_width * input_height * 3);
+        for (auto& v : test_img) v = dist(gen);
+
+        // Con std::function non c'è divisione interno/bordo: deve coincidere
+        // bit a bit con la versione a funtore che la usa
+        for (SizeType c : {1, 3})
+        for (SizeType f : {1, 3, 4})
+        for (SizeType stride : {1, 2, 3})
+        for (SizeType pad : {0, 1, 2, 5})
+        {
+            Math::Shape3d src_shape(input_height, input_width, c);
+            Math::Shape2d k_real_shape(input_height, input_width);
+            Math::Shape2d k_offset(2, 3);
+            SizeType output_width = (input_width - f + 2 * pad) / stride + 1;
+            SizeType output_height = (input_height - f + 2 * pad) / stride + 1;
+            std::vector<TestNumType> truth(output_width * output_height);
+            std::vector<TestNumType> split(truth.size());
+
+            Math::kernel_slide<TestNumType>(
+                Operation(Math::CrossCorrelationOp()), truth.data(),
+                test_img.data(), src_shape, test_img.data(), k_real_shape,
+                {f, f}, k_offset, {stride, stride}, {pad, pad});
+            Math::kernel_slide<TestNumType>(
+                Math::CrossCorrelationOp(), split.data(),
+                test_img.data(), src_shape, test_img.data(), k_real_shape,
+                {f, f}, k_offset, {stride, stride}, {pad, pad});
+            TEST_ASSERT(truth == split);
+
+            Math::kernel_slide<TestNumType>(
+                Operation(Math::SquaredDiffOp()), truth.data(),
+                test_img.data(), src_shape, test_img.data(), k_real_shape,
+                {f, f}, k_offset, {stride, stride}, {pad, pad});
+            Math::kernel_slide<TestNumType>(
+                Math::SquaredDiffOp(), split.data(),
+                test_img.data(), src_shape, test_img.data(), k_real_shape,
+                {f, f}, k_offset, {stride, stride}, {pad, pad});
+            TEST_ASSERT(truth == split);
+
+            Math::kernel_slide<TestNumType>(
+                Operation(Math::AbsoluteDiffOp()), truth.data(),
+                test_img.data(), src_shape, test_img.data(), k_real_shape,
+                {f, f}, k_offset, {stride, stride}, {pad, pad});
+            Math::kernel_slide<TestNumType>(
+                Math::AbsoluteDiffOp(), split.data(),
+                test_img.data(), src_shape, test_img.data(), k_real_shape,
+                {f, f}, k_offset, {stride, stride}, {pad, pad});
+            TEST_ASSERT(truth == split);
+        }
+    }
 };
 
 int main() {
@@ -0,0 +1,146 @@
+/***************************************************************************
+ *            test_plan.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "stereodepth/plan.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+using namespace stereodepth;
+
+class TestPlan {
+public:
+    void test() {
+        TEST_CALL(test_validation());
+        TEST_CALL(test_execute());
+        TEST_CALL(test_errors());
+        TEST_CALL(test_batch());
+    }
+
+private:
+    void test_validation() {
+        TEST_ASSERT(StereoMatcherPlan<uint8_t>(20, 10, 3).valid());
+        TEST_ASSERT(StereoMatcherPlan<uint8_t>(20, 10, 4).status() == PlanStatus::INVALID_KERNEL_SIZE);
+        TEST_ASSERT(StereoMatcherPlan<uint8_t>(20, 10, 1).status() == PlanStatus::INVALID_KERNEL_SIZE);
+        TEST_ASSERT(StereoMatcherPlan<uint8_t>(20, 4, 5).status() == PlanStatus::INVALID_SHAPE);
+        TEST_ASSERT(StereoMatcherPlan<uint8_t>(4, 20, 5).status() == PlanStatus::INVALID_SHAPE);
+        TEST_ASSERT(StereoMatcherPlan<uint8_t>(20, 10, 3, 5, 2).status() == PlanStatus::INVALID_DISPARITY_RANGE);
+        TEST_ASSERT(std::strlen(plan_status_string(PlanStatus::INVALID_SHAPE)) > 0);
+    }
+
+    void test_execute() {
+        using Wide = WideMatchingTraits<uint8_t>;
+        const SizeType width = 45, height = 17;
+        const auto src1 = random_matrix(height, width, 1);
+        const auto src2 = random_matrix(height, width, 2);
+
+        // 13 non ha una specializzazione e usa il kernel generico
+        for (SizeType kernel_size : {3, 7, 11, 13}) {
+            const SizeType dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+            std::vector<uint8_t> truth(dst_size), dst(dst_size);
+            argMaxCorrMat<uint8_t>(src1.data(), src2.data(), truth.data(),
+                                   width, height, kernel_size, -3, 9);
+            StereoMatcherPlan<uint8_t> plan(width, height, kernel_size, -3, 9);
+            TEST_ASSERT(plan.execute(src1.data(), src2.data(), dst.data()) == PlanStatus::OK);
+            TEST_ASSERT(dst == truth);
+
+            std::vector<uint16_t> truth_wide(dst_size), dst_wide(dst_size);
+            argMaxCorrMat<uint8_t, Wide>(src1.data(), src2.data(), truth_wide.data(),
+                                         width, height, kernel_size);
+            StereoMatcherPlan<uint8_t, Wide> wide(width, height, kernel_size);
+            // Due metà di righe eseguite separatamente
+            const SizeType half = wide.output_height() / 2;
+            TEST_ASSERT(wide.execute_rows(src1.data(), src2.data(), dst_wide.data(), half, wide.output_height()) == PlanStatus::OK);
+            TEST_ASSERT(wide.execute_rows(src1.data(), src2.data(), dst_wide.data(), 0, half) == PlanStatus::OK);
+            TEST_ASSERT(dst_wide == truth_wide);
+
+            // La confidenza viene dallo stesso kernel di riga
+            std::vector<uint8_t> truth_conf(dst_size), conf(dst_size);
+            argMaxCorrMat<uint8_t, Wide>(src1.data(), src2.data(), truth_wide.data(),
+                                         width, height, kernel_size, -3, 9, truth_conf.data(), 5);
+            StereoMatcherPlan<uint8_t, Wide> ranged(width, height, kernel_size, -3, 9);
+            TEST_ASSERT(ranged.execute(src1.data(), src2.data(), dst_wide.data(), conf.data(), 5) == PlanStatus::OK);
+            TEST_ASSERT(dst_wide == truth_wide);
+            TEST_ASSERT(conf == truth_conf);
+        }
+    }
+
+    void test_errors() {
+        const SizeType width = 20, height = 8;
+        const auto src = random_matrix(height, width, 3);
+        std::vector<uint8_t> dst(18 * 6, 7);
+
+        // Un piano non valido non tocca la destinazione e non termina il processo
+        StereoMatcherPlan<uint8_t> bad(width, height, 6);
+        TEST_ASSERT(bad.execute(src.data(), src.data(), dst.data()) == PlanStatus::INVALID_PLAN);
+        TEST_ASSERT(std::all_of(dst.begin(), dst.end(), [](uint8_t v) { return v == 7; }));
+
+        StereoMatcherPlan<uint8_t> plan(width, height, 3);
+        TEST_ASSERT(plan.execute(nullptr, src.data(), dst.data()) == PlanStatus::NULL_POINTER);
+        TEST_ASSERT(plan.execute(src.data(), src.data(), nullptr) == PlanStatus::NULL_POINTER);
+        TEST_ASSERT(plan.execute_rows(src.data(), src.data(), dst.data(), 2, 7) == PlanStatus::INVALID_ROWS);
+        TEST_ASSERT(plan.execute_rows(src.data(), src.data(), dst.data(), 3, 2) == PlanStatus::INVALID_ROWS);
+        TEST_ASSERT(std::all_of(dst.begin(), dst.end(), [](uint8_t v) { return v == 7; }));
+    }
+
+    void test_batch() {
+        using Wide = WideMatchingTraits<uint8_t>;
+        const SizeType width = 41, height = 15, kernel_size = 5, pairs = 7;
+        const SizeType dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+
+        std::vector<std::vector<uint8_t>> left, right;
+        std::vector<std::vector<uint16_t>> truth, out;
+        std::vector<const uint8_t*> src1, src2;
+        std::vector<uint16_t*> dst;
+        for (SizeType i = 0; i < pairs; ++i) {
+            left.push_back(random_matrix(height, width, 100 + i));
+            right.push_back(random_matrix(height, width, 200 + i));
+            truth.emplace_back(dst_size);
+            out.emplace_back(dst_size, 0);
+            argMaxCorrMat<uint8_t, Wide>(left[i].data(), right[i].data(), truth[i].data(),
+                                         width, height, kernel_size, -2, 11);
+        }
+        for (SizeType i = 0; i < pairs; ++i) {
+            src1.push_back(left[i].data());
+            src2.push_back(right[i].data());
+            dst.push_back(out[i].data());
+        }
+
+        // Chunk di ogni dimensione, anche a cavallo di due coppie
+        for (SizeType threads : {1, 3, 8}) {
+            ThreadPool pool(threads);
+            for (auto &o : out) std::fill(o.begin(), o.end(), 0);
+            const PlanStatus status = argMaxCorrMatBatch<uint8_t, Wide>(
+                src1.data(), src2.data(), dst.data(), pairs,
+                width, height, kernel_size, -2, 11, pool);
+            TEST_ASSERT(status == PlanStatus::OK);
+            TEST_ASSERT(out == truth);
+        }
+
+        StereoMatcherPlan<uint8_t, Wide> plan(width, height, kernel_size, -2, 11);
+        TEST_ASSERT(plan.execute_batch(src1.data(), src2.data(), dst.data(), 0) == PlanStatus::OK);
+        // Una sola destinazione nulla blocca l'intero batch
+        for (auto &o : out) std::fill(o.begin(), o.end(), 0);
+        dst[5] = nullptr;
+        TEST_ASSERT(plan.execute_batch(src1.data(), src2.data(), dst.data(), pairs) == PlanStatus::NULL_POINTER);
+        for (const auto &o : out)
+            TEST_ASSERT(std::all_of(o.begin(), o.end(), [](uint16_t v) { return v == 0; }));
+        TEST_ASSERT(argMaxCorrMatBatch<uint8_t>(src1.data(), src1.data(), nullptr, pairs,
+                                                width, height, 4) == PlanStatus::INVALID_KERNEL_SIZE);
+    }
+};
+
+int main() {
+    TestPlan().test();
+    return TEST_FAILURES;
+}
@@ -0,0 +1,150 @@
+/****************************************************************************
+ * Copyright (C) 2022 by Alessio Zattoni                                    *
+ *                                                                          *
+ * This file is part of CrossCorrelation.                                   *
+ *                                                                          *
+ *   CrossCorrelation is free software: you can redistribute it and/or      *
+ *   modify it under the terms of the GNU Lesser General Public License as  *
+ *   published by the Free Software Foundation, either version 3 of the     *
+ *   License, or (at your option) any later version.                        *
+ *                                                                          *
+ *   CrossCorrelation is distributed in the hope that it will be            *
+ *   useful, but WITHOUT ANY WARRANTY; without even the implied warranty of *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the          *
+ *   GNU Lesser General Public License for more details.                    *
+ *                                                                          *
+ *   You should have received a copy of the GNU Lesser General Public       *
+ *   License along with Box.  If not, see <http://www.gnu.org/licenses/>.   *
+ ****************************************************************************/
+
+
+/**
+ * @file    test_pyramid.cpp
+ * @author  Alessio Zattoni
+ * @date
+ * @brief   Questo file contiene i test della cross-correlazione coarse-to-fine
+ *
+ * ...
+ */
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "stereodepth/pyramid.hpp"
+
+#include <vector>
+#include <random>
+
+/// Seme del generatore di numeri casuali
+#define SEED    17
+/// Range dei valori delle matrici → da 0 a RANGE - 1
+#define RANGE   50
+
+
+class TestPyramid {
+public:
+    void test() {
+        TEST_CALL(test_pyramid_down());
+        TEST_CALL(test_pyramid_disparity());
+        TEST_CALL(test_no_levels());
+        TEST_CALL(test_full_radius());
+        TEST_CALL(test_small_radius());
+    }
+
+private:
+    void test_pyramid_down() {
+        const std::vector<uint8_t> src = { 1,   2,   3,   4,   9,
+                                           3,   4,   5,   5,   9,
+                                         255, 255,   0,   1,   9 };
+        std::vector<uint8_t> dst(2);
+        pyramidDown(src.data(), dst.data(), 5, 3);
+        // (1 + 2 + 3 + 4 + 2) / 4 = 3, (3 + 4 + 5 + 5 + 2) / 4 = 4: l'ultima riga e colonna sono scartate
+        TEST_EQUAL(int(dst[0]), 3);
+        TEST_EQUAL(int(dst[1]), 4);
+
+        const std::vector<float> src_f = {1.f, 2.f, 3.f, 5.f};
+        float dst_f;
+        pyramidDown(src_f.data(), &dst_f, 2, 2);
+        TEST_EQUAL(dst_f, 2.75f);
+    }
+
+    void test_pyramid_disparity() {
+        TEST_EQUAL(pyramidDisparity(7, true), 4);
+        TEST_EQUAL(pyramidDisparity(7, false), 3);
+        TEST_EQUAL(pyramidDisparity(-3, false), -2);
+        TEST_EQUAL(pyramidDisparity(-3, true), -1);
+        TEST_EQUAL(pyramidDisparity(8, true), 4);
+        TEST_ASSERT(pyramidDisparity(DISPARITY_MIN_UNBOUNDED, false) == DISPARITY_MIN_UNBOUNDED);
+        TEST_ASSERT(pyramidDisparity(DISPARITY_MAX_UNBOUNDED, true) == DISPARITY_MAX_UNBOUNDED);
+    }
+
+    void test_no_levels() {
+        const std::size_t width = 40, height = 12, kernel_size = 5;
+        const auto src1 = random_matrix(height, width, SEED + height * width, RANGE);
+        const auto src2 = random_matrix(height + 1, width, SEED + (height + 1) * width, RANGE);
+        const std::size_t dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+        std::vector<uint8_t> dst(dst_size), truth(dst_size);
+
+        argMaxCorrMat<uint8_t>(src1.data(), src2.data(), truth.data(), width, height, kernel_size, -2, 9);
+        argMaxCorrMatPyramid<uint8_t>(src1.data(), src2.data(), dst.data(), width, height, kernel_size, 0, 2, -2, 9);
+        TEST_ASSERT(dst == truth);
+
+        // Matrici troppo piccole per un livello: nessun livello costruito
+        argMaxCorrMatPyramid<uint8_t>(src1.data(), src2.data(), dst.data(), width, 9, kernel_size, 3, 2, -2, 9);
+        argMaxCorrMat<uint8_t>(src1.data(), src2.data(), truth.data(), width, 9, kernel_size, -2, 9);
+        TEST_ASSERT(std::equal(truth.begin(), truth.begin() + (width - 4) * 5, dst.begin()));
+    }
+
+    void test_full_radius() {
+        using Traits = WideMatchingTraits<uint8_t>;
+
+        const std::size_t width = 61, height = 29, kernel_size = 3;
+        const auto src1 = random_matrix(height, width, SEED + height * width, RANGE);
+        const auto src2 = random_matrix(height + 1, width, SEED + (height + 1) * width, RANGE);
+        const std::size_t dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+        std::vector<uint16_t> dst(dst_size), truth(dst_size);
+
+        // Un raggio che copre l'intero intervallo rende la ricerca identica a quella piatta
+        const std::int64_t ranges[][2] = {
+            {DISPARITY_MIN_UNBOUNDED, DISPARITY_MAX_UNBOUNDED}, {0, 20}, {-7, 5}
+        };
+        for (const auto &range : ranges) {
+            argMaxCorrMat<uint8_t, Traits>(src1.data(), src2.data(), truth.data(),
+                                           width, height, kernel_size, range[0], range[1]);
+            for (std::size_t levels : {1, 2, 3}) {
+                argMaxCorrMatPyramid<uint8_t, Traits>(src1.data(), src2.data(), dst.data(),
+                                                      width, height, kernel_size, levels, 2 * width,
+                                                      range[0], range[1]);
+                TEST_ASSERT(dst == truth);
+            }
+        }
+    }
+
+    void test_small_radius() {
+        using Traits = WideMatchingTraits<uint8_t>;
+
+        const std::size_t width = 64, height = 24, kernel_size = 3, radius = 1;
+        const std::int64_t min_d = 0, max_d = 15;
+        const auto src1 = random_matrix(height, width, SEED + height * width, RANGE);
+        const auto src2 = random_matrix(height + 1, width, SEED + (height + 1) * width, RANGE);
+        const std::size_t dst_w = width - (kernel_size - 1), dst_h = height - (kernel_size - 1);
+        std::vector<uint16_t> dst(dst_w * dst_h);
+
+        argMaxCorrMatPyramid<uint8_t, Traits>(src1.data(), src2.data(), dst.data(),
+                                              width, height, kernel_size, 2, radius, min_d, max_d);
+
+        // Ogni disparità resta nell'intervallo richiesto
+        bool in_range = true;
+        for (std::size_t i = 0; i < dst.size(); i++) {
+            const std::int64_t x = static_cast<std::int64_t>(i % dst_w);
+            const std::int64_t d = x - (static_cast<std::int64_t>(dst[i]) + 1 - std::int64_t(kernel_size / 2));
+            in_range = in_range && ((d >= min_d && d <= max_d) || dst[i] == 0);
+        }
+        TEST_ASSERT(in_range);
+    }
+};
+
+
+int main() {
+    TestPyramid().test();
+    return TEST_FAILURES;
+}
@@ -0,0 +1,45 @@
+/***************************************************************************
+ *            test_random.hpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+/*!\file test_random.hpp
+ * \brief Matrici casuali riproducibili per i test.
+ */
+
+#ifndef TEST_RANDOM_HPP
+#define TEST_RANDOM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <random>
+#include <type_traits>
+#include <vector>
+
+/**
+ * \brief Matrice rows x cols con valori uniformi in [0, range - 1], interi
+ * o reali secondo \p T.
+ * \tparam T    Tipo degli elementi.
+ * \param rows  Numero di righe.
+ * \param cols  Numero di colonne.
+ * \param seed  Seme del generatore, la stessa matrice per lo stesso seme.
+ * \param range Numero di valori distinti.
+ * \return La matrice, per righe.
+ */
+template <typename T = std::uint8_t>
+std::vector<T> random_matrix(std::size_t rows, std::size_t cols,
+                             std::mt19937::result_type seed, int range = 50)
+{
+    using Distribution = typename std::conditional<std::is_floating_point<T>::value,
+                                                   std::uniform_real_distribution<T>,
+                                                   std::uniform_int_distribution<int>>::type;
+    std::mt19937 gen(seed);
+    Distribution dist(0, range - 1);
+    std::vector<T> m(rows * cols);
+    for (auto &v : m) v = static_cast<T>(dist(gen));
+    return m;
+}
+
+#endif // TEST_RANDOM_HPP
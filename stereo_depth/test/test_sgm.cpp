@@ -0,0 +1,145 @@
+/***************************************************************************
+ *            test_sgm.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "test_simd_levels.hpp"
+#include "stereodepth/sgm.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <algorithm>
+
+using namespace std;
+using namespace stereodepth;
+
+class TestSgm {
+public:
+    using TestNumType = uint8_t;
+    using Volume = CostVolume<uint16_t>;
+
+    void test() {
+        TEST_CALL(test_invalid_arguments());
+        TEST_CALL(test_reference());
+        TEST_CALL(test_no_penalty());
+    }
+
+private:
+    // Aggregazione SGM diretta, una direzione alla volta
+    static std::vector<uint32_t> reference(const Volume& costs, SizeType paths,
+                                           uint32_t p1, uint32_t p2)
+    {
+        const int dirs[8][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1},
+                                {1, 1}, {-1, 1}, {1, -1}, {-1, -1}};
+        const int h = int(costs.height()), w = int(costs.width());
+        const int nd = int(costs.disparities());
+        std::vector<uint32_t> sum(costs.size(), 0), l(costs.size());
+
+        for (SizeType p = 0; p < paths; ++p) {
+            const int dx = dirs[p][0], dy = dirs[p][1];
+            for (int i = 0; i < h; ++i) {
+                const int r = dy >= 0 ? i : h - 1 - i;
+                for (int j = 0; j < w; ++j) {
+                    const int c = dx >= 0 ? j : w - 1 - j;
+                    const int pr = r - dy, pc = c - dx;
+                    const bool has_prev = pr >= 0 && pr < h && pc >= 0 && pc < w;
+                    uint32_t min_prev = ~0u;
+                    if (has_prev)
+                        for (int d = 0; d < nd; ++d)
+                            min_prev = std::min(min_prev, l[costs.index(pr, pc, d)]);
+                    for (int d = 0; d < nd; ++d) {
+                        uint32_t value = costs(r, c, d);
+                        if (has_prev) {
+                            uint32_t m = std::min(l[costs.index(pr, pc, d)], min_prev + p2);
+                            if (d > 0) m = std::min(m, l[costs.index(pr, pc, d - 1)] + p1);
+                            if (d + 1 < nd) m = std::min(m, l[costs.index(pr, pc, d + 1)] + p1);
+                            value += m - min_prev;
+                        }
+                        l[costs.index(r, c, d)] = value;
+                        sum[costs.index(r, c, d)] += value;
+                    }
+                }
+            }
+        }
+        return sum;
+    }
+
+    void test_invalid_arguments() {
+        Volume costs(3, 4, 0, 5), aggregated;
+        costs.fill(10);
+        SgmParameters params;
+        params.paths = 6;
+        TEST_THROWS(sgm_aggregate(costs, aggregated, params), std::invalid_argument);
+        params.paths = 4;
+        params.p2 = 20000;
+        TEST_THROWS(sgm_aggregate(costs, aggregated, params), std::invalid_argument);
+        Volume dhw(Volume::Layout::DHW);
+        TEST_THROWS(sgm_aggregate(costs, dhw), std::invalid_argument);
+    }
+
+    void test_reference() {
+        for (SizeType nd : {5, 19, 37}) {
+            Volume costs(9, 23, -3, std::int64_t(nd) - 4), aggregated;
+            const auto values = random_matrix<uint16_t>(1, costs.size(), 7 + nd, CENSUS_MAX_COST + 1);
+            std::copy(values.begin(), values.end(), costs.data());
+
+            for (SizeType paths : {4, 8}) {
+                SgmParameters params;
+                params.paths = paths;
+                params.p1 = 5;
+                params.p2 = 40;
+                const auto truth = reference(costs, paths, params.p1, params.p2);
+                for (auto level : supported_levels())
+                    for (SizeType threads : {1, 3}) {
+                        params.num_threads = threads;
+                        sgm_aggregate(costs, aggregated, params, level);
+                        TEST_EQUAL(aggregated.size(), costs.size());
+                        TEST_ASSERT(std::equal(truth.begin(), truth.end(),
+                                               aggregated.data()));
+                    }
+            }
+        }
+    }
+
+    void test_no_penalty() {
+        const SizeType width = 48, height = 16, kernel_size = 3;
+        const auto src1 = random_matrix<TestNumType>(height, width, 1, 200);
+        const auto src2 = random_matrix<TestNumType>(height, width, 2, 200);
+        const SizeType dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+        std::vector<TestNumType> truth(dst_size), output(dst_size);
+
+        argMinCensusMat<TestNumType>(src1.data(), src2.data(), truth.data(),
+                                     width, height, kernel_size, -2, 12);
+
+        // Senza penalità ogni direzione riproduce il costo del pixel
+        SgmParameters params;
+        params.p1 = 0;
+        params.p2 = 0;
+        for (SizeType paths : {4, 8}) {
+            params.paths = paths;
+            sgm_census_disparity(src1.data(), src2.data(), output.data(),
+                                 width, height, kernel_size, -2, 12, params);
+            TEST_ASSERT(output == truth);
+        }
+
+        // winner_takes_min sul volume census riproduce argMinHammingMat
+        std::vector<uint64_t> census1(width * height), census2(width * height);
+        censusTransform(src1.data(), census1.data(), width, height);
+        censusTransform(src2.data(), census2.data(), width, height);
+        Volume costs;
+        costVolumeCensus(census1.data(), census2.data(), costs, width, height, kernel_size);
+        argMinHammingMat(census1.data(), census2.data(), truth.data(), width, height, kernel_size);
+        winner_takes_min(output.data(), costs, kernel_size);
+        TEST_ASSERT(output == truth);
+    }
+};
+
+int main() {
+    TestSgm().test();
+    return TEST_FAILURES;
+}
@@ -0,0 +1,152 @@
+/***************************************************************************
+ *            test_simd.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "test_simd_levels.hpp"
+#include "stereodepth/simd.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+
+using namespace std;
+
+class TestSimd {
+public:
+    using TestNumType = uint8_t;
+    using SizeType = std::size_t;
+
+    void test() {
+        TEST_CALL(test_window_costs());
+        TEST_CALL(test_arg_max_corr_mat());
+        TEST_CALL(test_block_sad());
+    }
+
+private:
+    static uint32_t brute_force(CostFunction cost, const TestNumType *src1,
+                                const TestNumType *src2, SizeType width,
+                                SizeType k, std::int64_t d, SizeType x)
+    {
+        uint32_t sum = 0;
+        for (SizeType r = 0; r < k; ++r)
+            for (SizeType c = 0; c < k; ++c) {
+                const int a = src1[r * width + x - d + c];
+                const int b = src2[r * width + x + c];
+                const int diff = a - b;
+                switch (cost) {
+                    case CostFunction::PRODUCT_SUM: sum += a * b; break;
+                    case CostFunction::SAD: sum += diff < 0 ? -diff : diff; break;
+                    case CostFunction::SSD: sum += diff * diff; break;
+                }
+            }
+        return sum;
+    }
+
+    void test_window_costs() {
+        const SizeType width = 77, height = 19;
+        const auto src1 = random_matrix<TestNumType>(height, width, 1, 256);
+        const auto src2 = random_matrix<TestNumType>(height, width, 2, 256);
+
+        for (auto level : supported_levels())
+            for (auto cost : {CostFunction::PRODUCT_SUM, CostFunction::SAD,
+                              CostFunction::SSD})
+                for (SizeType k = 3; k <= 19; k += 2)
+                    for (std::int64_t d : {-7, 0, 5})
+                    {
+                        const SizeType x_begin = d > 0 ? d : 0;
+                        const SizeType x_end = width - k + 1 + (d < 0 ? d : 0);
+                        std::vector<uint32_t> costs(x_end - x_begin);
+                        std::vector<uint32_t> scratch(x_end - x_begin + k - 1);
+
+                        windowCostsU8(cost, src1.data(), src2.data(), width, k, d,
+                                      x_begin, x_end, costs.data(), scratch.data(),
+                                      level);
+
+                        bool equal = true;
+                        for (SizeType x = x_begin; x < x_end; ++x)
+                            equal = equal && costs[x - x_begin] == brute_force(cost,
+                                src1.data(), src2.data(), width, k, d, x);
+                        TEST_ASSERT(equal);
+                    }
+    }
+
+    void test_arg_max_corr_mat() {
+        const SizeType width = 70, height = 16;
+        const auto src1 = random_matrix<TestNumType>(height, width, 3, 50);
+        const auto src2 = random_matrix<TestNumType>(height, width, 4, 50);
+
+        const std::int64_t ranges[][2] = {
+            {DISPARITY_MIN_UNBOUNDED, DISPARITY_MAX_UNBOUNDED},
+            {0, 16}, {-9, 4}, {80, 90}
+        };
+        for (auto level : supported_levels())
+            for (SizeType k = 3; k <= 11; k += 2)
+            {
+                const SizeType dst_size = (width - (k - 1)) * (height - (k - 1));
+                std::vector<TestNumType> truth(dst_size), output(dst_size);
+                for (const auto& range : ranges)
+                {
+                    argMaxCorrMat<TestNumType>(src1.data(), src2.data(),
+                        truth.data(), width, height, k, range[0], range[1]);
+                    argMaxCorrMatSimd(src1.data(), src2.data(), output.data(),
+                        width, height, k, range[0], range[1], level);
+                    TEST_ASSERT(output == truth);
+                }
+            }
+
+        // Accumulatore esatto e indici a 16 bit
+        using Traits = WideMatchingTraits<TestNumType>;
+        const SizeType dst_size = (width - 4) * (height - 4);
+        std::vector<uint16_t> truth(dst_size), output(dst_size);
+        std::vector<uint8_t> truth_conf(dst_size), conf(dst_size);
+        argMaxCorrMat<TestNumType, Traits>(src1.data(), src2.data(), truth.data(),
+                                           width, height, 5, -9, 30, truth_conf.data(), 5);
+        for (auto level : supported_levels())
+        {
+            argMaxCorrMatSimd<Traits>(src1.data(), src2.data(), output.data(),
+                                      width, height, 5, -9, 30, level);
+            TEST_ASSERT(output == truth);
+
+            // Stessi candidati nello stesso ordine: anche la confidenza coincide
+            std::fill(conf.begin(), conf.end(), 0);
+            argMaxCorrMatSimd<Traits>(src1.data(), src2.data(), output.data(),
+                                      width, height, 5, -9, 30, level, conf.data(), 5);
+            TEST_ASSERT(output == truth);
+            TEST_ASSERT(conf == truth_conf);
+        }
+    }
+
+    void test_block_sad() {
+        const SizeType width = 101, height = 9;
+        const auto a = random_matrix<TestNumType>(height, width, 3, 256);
+        const auto b = random_matrix<TestNumType>(height, width, 4, 256);
+
+        // Blocchi con e senza coda scalare, a partire da colonne non allineate
+        for (auto level : supported_levels())
+            for (SizeType col : {0, 3})
+                for (SizeType cols : {0, 1, 15, 16, 33, 64, 98})
+                {
+                    const SizeType rows = 7;
+                    uint64_t truth = 0;
+                    for (SizeType r = 0; r < rows; ++r)
+                        for (SizeType c = col; c < col + cols; ++c) {
+                            const int diff = a[r * width + c] - b[r * width + c];
+                            truth += diff < 0 ? -diff : diff;
+                        }
+                    TEST_EQUAL(blockSadU8(a.data() + col, b.data() + col, width,
+                                          rows, cols, level), truth);
+                }
+        TEST_EQUAL(blockSadU8(a.data(), a.data(), width, height, width), 0);
+    }
+};
+
+int main() {
+    std::cout << "SIMD level: " << simdLevelName(simdLevel()) << std::endl;
+    TestSimd().test();
+    return TEST_FAILURES;
+}
@@ -0,0 +1,32 @@
+/***************************************************************************
+ *            test_simd_levels.hpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+/*!\file test_simd_levels.hpp
+ * \brief Livelli SIMD su cui i test confrontano i kernel.
+ */
+
+#ifndef TEST_SIMD_LEVELS_HPP
+#define TEST_SIMD_LEVELS_HPP
+
+#include "stereodepth/simd.hpp"
+
+#include <vector>
+
+/**
+ * \brief Livelli SIMD supportati dalla CPU corrente, dal più semplice.
+ * \return SCALAR seguito da SSE4 e AVX2 se disponibili.
+ */
+inline std::vector<SimdLevel> supported_levels()
+{
+    std::vector<SimdLevel> levels;
+    for (auto level : {SimdLevel::SCALAR, SimdLevel::SSE4, SimdLevel::AVX2})
+        if (simdLevelSupported(level))
+            levels.push_back(level);
+    return levels;
+}
+
+#endif // TEST_SIMD_LEVELS_HPP
@@ -0,0 +1,137 @@
+/***************************************************************************
+ *            test_sparse.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "stereodepth/sparse.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace stereodepth;
+
+class TestSparse {
+public:
+    void test() {
+        TEST_CALL(test_points());
+        TEST_CALL(test_regions());
+        TEST_CALL(test_errors());
+    }
+
+private:
+    static const SizeType width = 90, height = 50, kernel_size = 5;
+    static const SizeType dst_width = width - (kernel_size - 1);
+    static const SizeType dst_height = height - (kernel_size - 1);
+
+    void test_points() {
+        using Wide = WideMatchingTraits<uint8_t>;
+        const auto src1 = random_matrix(height, width, 1);
+        const auto src2 = random_matrix(height, width, 2);
+        std::vector<uint16_t> truth(dst_width * dst_height);
+        argMaxCorrMat<uint8_t, Wide>(src1.data(), src2.data(), truth.data(),
+                                     width, height, kernel_size, -4, 30);
+
+        SparseMatcher<uint8_t, Wide> matcher(width, height, kernel_size, -4, 30);
+        const SizeType tiles = matcher.tiled().tiles().size();
+        TEST_EQUAL(matcher.tiled().tile_width(), SPARSE_TILE_SIZE);
+        TEST_ASSERT(matcher.begin_frame(src1.data(), src2.data()) == PlanStatus::OK);
+
+        uint16_t value = 0;
+        TEST_ASSERT(matcher.query_point(20, 33, value) == PlanStatus::OK);
+        TEST_EQUAL(value, truth[20 * dst_width + 33]);
+        TEST_EQUAL(matcher.computed_tiles(), 1);
+
+        // Punti nello stesso tile riusano il risultato
+        const std::vector<PointQuery> near = {{17, 32}, {31, 47}, {20, 33}};
+        std::vector<uint16_t> values(near.size());
+        TEST_ASSERT(matcher.query_points(near.data(), near.size(), values.data()) == PlanStatus::OK);
+        for (SizeType i = 0; i < near.size(); ++i)
+            TEST_EQUAL(values[i], truth[near[i].row * dst_width + near[i].col]);
+        TEST_EQUAL(matcher.computed_tiles(), 1);
+
+        // Bordi destro e inferiore, in tile più piccoli
+        TEST_ASSERT(matcher.query_point(dst_height - 1, dst_width - 1, value) == PlanStatus::OK);
+        TEST_EQUAL(value, truth.back());
+        TEST_EQUAL(matcher.computed_tiles(), 2);
+        TEST_ASSERT(matcher.computed_tiles() < tiles);
+
+        // Un nuovo frame invalida la cache
+        const auto other = random_matrix(height, width, 3);
+        argMaxCorrMat<uint8_t, Wide>(other.data(), src2.data(), truth.data(),
+                                     width, height, kernel_size, -4, 30);
+        TEST_ASSERT(matcher.begin_frame(other.data(), src2.data()) == PlanStatus::OK);
+        TEST_EQUAL(matcher.computed_tiles(), 0);
+        TEST_ASSERT(matcher.query_point(20, 33, value) == PlanStatus::OK);
+        TEST_EQUAL(value, truth[20 * dst_width + 33]);
+    }
+
+    void test_regions() {
+        const auto src1 = random_matrix(height, width, 4);
+        const auto src2 = random_matrix(height, width, 5);
+        std::vector<uint8_t> truth(dst_width * dst_height);
+        argMaxCorrMat<uint8_t>(src1.data(), src2.data(), truth.data(),
+                               width, height, kernel_size, 0, 25);
+
+        TileConfig config;
+        config.tile_width = 10;
+        config.tile_height = 7;
+        SparseMatcher<uint8_t> matcher(width, height, kernel_size, 0, 25, config);
+        TEST_ASSERT(matcher.begin_frame(src1.data(), src2.data()) == PlanStatus::OK);
+
+        // Riquadro 12 x 15 in uno stride più largo: tocca 3 x 3 tile
+        const SizeType stride = 20;
+        std::vector<uint8_t> box(12 * stride, 0xEE);
+        TEST_ASSERT(matcher.query_region(5, 17, 8, 23, box.data(), stride) == PlanStatus::OK);
+        for (SizeType r = 0; r < 12; ++r) {
+            for (SizeType c = 0; c < 15; ++c)
+                TEST_EQUAL(box[r * stride + c], truth[(r + 5) * dst_width + c + 8]);
+            TEST_EQUAL(box[r * stride + 15], 0xEE);
+        }
+        TEST_EQUAL(matcher.computed_tiles(), 9);
+
+        // Riquadro sovrapposto: solo i tile nuovi
+        std::vector<uint8_t> overlap(4 * 4);
+        TEST_ASSERT(matcher.query_region(14, 18, 27, 31, overlap.data(), 4) == PlanStatus::OK);
+        TEST_EQUAL(matcher.computed_tiles(), 10);
+        TEST_EQUAL(overlap[3 * 4 + 3], truth[17 * dst_width + 30]);
+
+        // L'intera destinazione coincide con la versione densa
+        std::vector<uint8_t> full(truth.size());
+        TEST_ASSERT(matcher.query_region(0, dst_height, 0, dst_width, full.data(), dst_width) == PlanStatus::OK);
+        TEST_ASSERT(full == truth);
+        TEST_EQUAL(matcher.computed_tiles(), matcher.tiled().tiles().size());
+    }
+
+    void test_errors() {
+        const auto src = random_matrix(height, width, 6);
+        uint8_t value = 7;
+
+        SparseMatcher<uint8_t> bad(width, height, 8);
+        TEST_ASSERT(bad.begin_frame(src.data(), src.data()) == PlanStatus::INVALID_PLAN);
+        TEST_ASSERT(bad.query_point(0, 0, value) == PlanStatus::INVALID_PLAN);
+
+        SparseMatcher<uint8_t> matcher(width, height, kernel_size);
+        // Nessun frame ancora
+        TEST_ASSERT(matcher.query_point(0, 0, value) == PlanStatus::NULL_POINTER);
+        TEST_ASSERT(matcher.begin_frame(src.data(), nullptr) == PlanStatus::NULL_POINTER);
+        TEST_ASSERT(matcher.begin_frame(src.data(), src.data()) == PlanStatus::OK);
+        TEST_ASSERT(matcher.query_point(dst_height, 0, value) == PlanStatus::INVALID_QUERY);
+        TEST_ASSERT(matcher.query_region(3, 2, 0, 1, &value, 1) == PlanStatus::INVALID_QUERY);
+        TEST_ASSERT(matcher.query_region(0, 2, 0, 4, &value, 3) == PlanStatus::INVALID_QUERY);
+        const PointQuery points[2] = {{1, 1}, {0, dst_width}};
+        TEST_ASSERT(matcher.query_points(points, 2, &value) == PlanStatus::INVALID_QUERY);
+        TEST_EQUAL(value, 7);
+        TEST_EQUAL(matcher.computed_tiles(), 0);
+    }
+};
+
+int main() {
+    TestSparse().test();
+    return TEST_FAILURES;
+}
@@ -0,0 +1,101 @@
+/***************************************************************************
+ *            test_streaming.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "stereodepth/streaming.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace stereodepth;
+
+class TestStreaming {
+public:
+    void test() {
+        TEST_CALL(test_invalid_arguments());
+        TEST_CALL(test_equal_to_mat());
+        TEST_CALL(test_reset());
+    }
+
+private:
+    // Spinge tutte le righe e concatena le righe emesse
+    template <typename Traits>
+    static std::vector<typename Traits::output_type>
+    stream(StreamingMatcher<uint8_t, Traits>& matcher, const std::vector<uint8_t>& src1,
+           const std::vector<uint8_t>& src2, SizeType height)
+    {
+        const SizeType width = matcher.width();
+        std::vector<typename Traits::output_type> out, row(matcher.output_width());
+        for (SizeType r = 0; r < height; ++r)
+            if (matcher.push(src1.data() + r * width, src2.data() + r * width, row.data()))
+                out.insert(out.end(), row.begin(), row.end());
+        return out;
+    }
+
+    void test_invalid_arguments() {
+        TEST_THROWS(StreamingMatcher<uint8_t>(10, 4), std::invalid_argument);
+        TEST_THROWS(StreamingMatcher<uint8_t>(10, 1), std::invalid_argument);
+        TEST_THROWS(StreamingMatcher<uint8_t>(4, 5), std::invalid_argument);
+        TEST_THROWS(StreamingMatcher<uint8_t>(10, 3, 4, 2), std::invalid_argument);
+        StreamingMatcher<uint8_t> matcher(10, 3);
+        std::vector<uint8_t> row(10), dst(8);
+        TEST_THROWS(matcher.push(nullptr, row.data(), dst.data()), std::invalid_argument);
+    }
+
+    void test_equal_to_mat() {
+        using Wide = WideMatchingTraits<uint8_t>;
+        const SizeType width = 53, height = 21;
+        const auto src1 = random_matrix(height, width, 1);
+        const auto src2 = random_matrix(height, width, 2);
+
+        // 13 non ha una specializzazione e usa argMaxCorrVector
+        for (SizeType kernel_size : {3, 5, 7, 13}) {
+            const SizeType dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+            std::vector<uint8_t> truth(dst_size);
+            std::vector<uint16_t> truth_wide(dst_size);
+            argMaxCorrMat<uint8_t>(src1.data(), src2.data(), truth.data(),
+                                   width, height, kernel_size, -3, 10);
+            argMaxCorrMat<uint8_t, Wide>(src1.data(), src2.data(), truth_wide.data(),
+                                         width, height, kernel_size);
+
+            StreamingMatcher<uint8_t> matcher(width, kernel_size, -3, 10);
+            TEST_ASSERT(stream(matcher, src1, src2, height) == truth);
+            TEST_EQUAL(matcher.rows_emitted(), height - (kernel_size - 1));
+
+            StreamingMatcher<uint8_t, Wide> wide(width, kernel_size);
+            TEST_ASSERT(stream(wide, src1, src2, height) == truth_wide);
+        }
+    }
+
+    void test_reset() {
+        const SizeType width = 30, height = 9, kernel_size = 5;
+        const auto src1 = random_matrix(height, width, 3);
+        const auto src2 = random_matrix(height, width, 4);
+        const auto other = random_matrix(height, width, 5);
+
+        StreamingMatcher<uint8_t> matcher(width, kernel_size);
+        std::vector<uint8_t> row(matcher.output_width());
+        // Le prime K - 1 righe non producono uscita
+        for (SizeType r = 0; r + 1 < kernel_size; ++r)
+            TEST_ASSERT(!matcher.push(other.data() + r * width, other.data() + r * width, row.data()));
+
+        // Un nuovo frame non vede le righe del precedente
+        matcher.reset();
+        TEST_EQUAL(matcher.rows_emitted(), 0);
+        std::vector<uint8_t> truth((width - (kernel_size - 1)) * (height - (kernel_size - 1)));
+        argMaxCorrMat<uint8_t>(src1.data(), src2.data(), truth.data(), width, height, kernel_size);
+        TEST_ASSERT(stream(matcher, src1, src2, height) == truth);
+    }
+};
+
+int main() {
+    TestStreaming().test();
+    return TEST_FAILURES;
+}
@@ -0,0 +1,170 @@
+/***************************************************************************
+ *            test_subpixel.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "stereodepth/subpixel.hpp"
+#include "stereodepth/census.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+using namespace stereodepth;
+
+class TestSubpixel {
+public:
+    void test() {
+        TEST_CALL(test_offset());
+        TEST_CALL(test_parabola());
+        TEST_CALL(test_equiangular());
+        TEST_CALL(test_integer());
+        TEST_CALL(test_confidence());
+        TEST_CALL(test_wide_range());
+    }
+
+private:
+    // Volume 1 x width con costi f(d - true_d) per ogni pixel
+    template <typename F>
+    static CostVolume<double> synthetic(SizeType width, std::int64_t min_d,
+                                        std::int64_t max_d, F f)
+    {
+        CostVolume<double> volume(1, width, min_d, max_d);
+        for (SizeType c = 0; c < width; ++c)
+            for (SizeType n = 0; n < volume.disparities(); ++n)
+                volume(0, c, n) = f(double(volume.disparity(n)));
+        return volume;
+    }
+
+    void test_offset() {
+        TEST_EQUAL(subpixel_offset(4, 1, 4, CostOrder::MINIMIZE, SubpixelFit::PARABOLA), 0.0);
+        TEST_EQUAL(subpixel_offset(5, 5, 5, CostOrder::MINIMIZE, SubpixelFit::PARABOLA), 0.0);
+        TEST_EQUAL(subpixel_offset(1, 3, 2, CostOrder::MAXIMIZE, SubpixelFit::PARABOLA), 1.0 / 6.0);
+        TEST_EQUAL(subpixel_offset(4, 1, 2, CostOrder::MINIMIZE, SubpixelFit::EQUIANGULAR), 1.0 / 3.0);
+        TEST_EQUAL(subpixel_offset(2, 4, 1, CostOrder::MAXIMIZE, SubpixelFit::EQUIANGULAR), -1.0 / 6.0);
+        TEST_EQUAL(subpixel_offset(1, 1, 9, CostOrder::MINIMIZE, SubpixelFit::EQUIANGULAR), -0.5);
+    }
+
+    void test_parabola() {
+        const SizeType width = 12;
+        auto volume = synthetic(width, 0, 7, [](double d) { return (d - 3.25) * (d - 3.25); });
+        std::vector<std::int16_t> dst(width);
+        subpixel_disparity(dst.data(), volume, CostOrder::MINIMIZE);
+        // Pixel con tutti i candidati 2, 3, 4 validi: x >= 4
+        for (SizeType x = 4; x < width; ++x) TEST_EQUAL(dst[x], 52);
+        // Pixel 0: solo la disparità 0 è valida, nessun raffinamento
+        TEST_EQUAL(dst[0], 0);
+
+        auto similarity = synthetic(width, 0, 7, [](double d) { return 100 - (d - 5.5625) * (d - 5.5625); });
+        subpixel_disparity(dst.data(), similarity, CostOrder::MAXIMIZE);
+        for (SizeType x = 7; x < width; ++x) TEST_EQUAL(dst[x], 89);
+    }
+
+    void test_equiangular() {
+        const SizeType width = 12;
+        auto volume = synthetic(width, -2, 6, [](double d) { return std::fabs(d - 1.75) * 10; });
+        std::vector<std::int16_t> dst(width);
+        subpixel_disparity(dst.data(), volume, CostOrder::MINIMIZE, SubpixelFit::EQUIANGULAR);
+        for (SizeType x = 3; x < width - 3; ++x) TEST_EQUAL(dst[x], 28);
+    }
+
+    void test_integer() {
+        const SizeType width = 40, height = 12, kernel_size = 3;
+        const auto src1 = random_matrix(height, width, 5, 200);
+        const auto src2 = random_matrix(height, width, 6, 200);
+
+        std::vector<uint64_t> census1(width * height), census2(width * height);
+        censusTransform(src1.data(), census1.data(), width, height);
+        censusTransform(src2.data(), census2.data(), width, height);
+        CostVolume<uint16_t> volume;
+        costVolumeCensus(census1.data(), census2.data(), volume, width, height,
+                         kernel_size, 2, 9);
+
+        const SizeType size = volume.height() * volume.width();
+        std::vector<uint8_t> index(size);
+        std::vector<std::int16_t> dst(size);
+        winner_takes_min(index.data(), volume, kernel_size);
+        subpixel_disparity(dst.data(), volume, CostOrder::MINIMIZE, SubpixelFit::NONE);
+
+        // Disparità intera: d = x + pos - 1 - indice; pixel senza candidati invalidi
+        bool equal = true;
+        for (SizeType r = 0; r < volume.height(); ++r)
+            for (SizeType x = 0; x < volume.width(); ++x) {
+                const SizeType i = r * volume.width() + x;
+                const std::int16_t expected = x < 2 ? invalid_disparity(volume)
+                    : std::int16_t((std::int64_t(x) + 1 - 1 - index[i]) * DISPARITY_SCALE);
+                equal = equal && dst[i] == expected;
+            }
+        TEST_ASSERT(equal);
+        TEST_EQUAL(invalid_disparity(volume), 16);
+    }
+
+    void test_wide_range() {
+        const SizeType width = 2100;
+        std::vector<std::int16_t> dst(width);
+
+        // Estremi dell'intervallo rappresentabile in virgola fissa
+        CostVolume<uint16_t> positive(1, width, 0, DISPARITY_FIXED_MAX);
+        for (SizeType c = 0; c < width; ++c)
+            for (SizeType n = 0; n < positive.disparities(); ++n)
+                positive(0, c, n) = uint16_t(std::llabs(positive.disparity(n) - DISPARITY_FIXED_MAX));
+        subpixel_disparity(dst.data(), positive, CostOrder::MINIMIZE, SubpixelFit::EQUIANGULAR);
+        TEST_EQUAL(dst[width - 1], DISPARITY_FIXED_MAX * DISPARITY_SCALE);
+        TEST_EQUAL(dst[0], 0);
+
+        CostVolume<uint16_t> negative(1, width, -DISPARITY_FIXED_MAX, 0);
+        for (SizeType c = 0; c < width; ++c)
+            for (SizeType n = 0; n < negative.disparities(); ++n)
+                negative(0, c, n) = uint16_t(std::llabs(negative.disparity(n) + DISPARITY_FIXED_MAX));
+        subpixel_disparity(dst.data(), negative, CostOrder::MINIMIZE, SubpixelFit::EQUIANGULAR);
+        TEST_EQUAL(dst[0], -DISPARITY_FIXED_MAX * DISPARITY_SCALE);
+
+        // Oltre, il risultato andrebbe in overflow: rifiutato
+        CostVolume<uint16_t> wide(1, width, 0, DISPARITY_FIXED_MAX + 1);
+        wide.fill(0);
+        dst[0] = 7;
+        TEST_THROWS(subpixel_disparity(dst.data(), wide, CostOrder::MINIMIZE), std::invalid_argument);
+        TEST_EQUAL(dst[0], 7);
+        CostVolume<uint16_t> wide_negative(1, width, -DISPARITY_FIXED_MAX - 1, 0);
+        wide_negative.fill(0);
+        TEST_THROWS(subpixel_disparity(dst.data(), wide_negative, CostOrder::MINIMIZE), std::invalid_argument);
+    }
+
+    void test_confidence() {
+        const SizeType width = 12;
+        auto volume = synthetic(width, 0, 7, [](double d) { return 10 + std::fabs(d - 3) * 10; });
+        // Secondo minimo isolato in d = 6
+        for (SizeType c = 0; c < width; ++c) volume(0, c, 6) = 12;
+        std::vector<std::int16_t> dst(width), plain(width);
+        std::vector<std::uint8_t> confidence(width);
+
+        subpixel_disparity(plain.data(), volume, CostOrder::MINIMIZE, SubpixelFit::EQUIANGULAR);
+        subpixel_disparity(dst.data(), volume, CostOrder::MINIMIZE, SubpixelFit::EQUIANGULAR,
+                           confidence.data());
+        TEST_ASSERT(dst == plain);
+        // Pixel con tutti i candidati validi: secondo = 12, migliore = 10
+        for (SizeType x = 7; x < width; ++x) TEST_EQUAL(confidence[x], 42);
+        // Pixel 3: candidati 0..3, il secondo fuori da ±1 è d = 0 o 1 → 30
+        TEST_EQUAL(confidence[3], 170);
+        // Pixel 0: un solo candidato
+        TEST_EQUAL(confidence[0], CONFIDENCE_MAX);
+
+        subpixel_disparity(dst.data(), volume, CostOrder::MINIMIZE, SubpixelFit::EQUIANGULAR,
+                           confidence.data(), 25);
+        TEST_ASSERT(dst == plain);
+        for (SizeType x = 7; x < width; ++x) TEST_EQUAL(confidence[x], 0);
+        TEST_EQUAL(confidence[3], 170);
+    }
+};
+
+int main() {
+    TestSubpixel().test();
+    return TEST_FAILURES;
+}
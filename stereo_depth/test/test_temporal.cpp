@@ -0,0 +1,120 @@
+/***************************************************************************
+ *            test_temporal.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "stereodepth/temporal.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace stereodepth;
+
+class TestTemporal {
+public:
+    void test() {
+        TEST_CALL(test_first_frame());
+        TEST_CALL(test_static_scene());
+        TEST_CALL(test_changed_scene());
+        TEST_CALL(test_errors());
+    }
+
+private:
+    static const SizeType width = 48, height = 14, kernel_size = 5;
+
+    void test_first_frame() {
+        using Wide = WideMatchingTraits<uint8_t>;
+        const auto src1 = random_matrix(height, width, 1);
+        const auto src2 = random_matrix(height, width, 2);
+        const SizeType dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+
+        std::vector<uint16_t> truth(dst_size), dst(dst_size);
+        std::vector<uint8_t> truth_conf(dst_size), conf(dst_size);
+        argMaxCorrMat<uint8_t, Wide>(src1.data(), src2.data(), truth.data(),
+                                     width, height, kernel_size, -3, 20, truth_conf.data());
+
+        // Il primo frame cerca sull'intero intervallo
+        TemporalMatcher<uint8_t, Wide> matcher(width, height, kernel_size, -3, 20);
+        TEST_ASSERT(!matcher.has_history());
+        TEST_ASSERT(matcher.execute(src1.data(), src2.data(), dst.data(), conf.data()) == PlanStatus::OK);
+        TEST_ASSERT(dst == truth);
+        TEST_ASSERT(conf == truth_conf);
+        TEST_ASSERT(matcher.has_history());
+        TEST_EQUAL(matcher.seeded_pixels(), 0);
+    }
+
+    void test_static_scene() {
+        using Wide = WideMatchingTraits<uint8_t>;
+        const auto src1 = random_matrix(height, width, 3);
+        const auto src2 = random_matrix(height, width, 4);
+        const SizeType dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+
+        std::vector<uint16_t> truth(dst_size), dst(dst_size);
+        std::vector<uint8_t> truth_conf(dst_size);
+        argMaxCorrMat<uint8_t, Wide>(src1.data(), src2.data(), truth.data(),
+                                     width, height, kernel_size, DISPARITY_MIN_UNBOUNDED,
+                                     DISPARITY_MAX_UNBOUNDED, truth_conf.data());
+
+        TemporalConfig config;
+        config.min_confidence = 1;
+        TemporalMatcher<uint8_t, Wide> matcher(width, height, kernel_size,
+                                               DISPARITY_MIN_UNBOUNDED, DISPARITY_MAX_UNBOUNDED, config);
+        ThreadPool pool(3);
+        for (int frame = 0; frame < 3; ++frame) {
+            // Scena ferma: il picco resta dentro la finestra ridotta
+            TEST_ASSERT(matcher.execute(src1.data(), src2.data(), dst.data(), nullptr, pool) == PlanStatus::OK);
+            TEST_ASSERT(dst == truth);
+        }
+        TEST_ASSERT(matcher.seeded_pixels() > dst_size / 2);
+
+        matcher.reset();
+        TEST_ASSERT(matcher.execute(src1.data(), src2.data(), dst.data()) == PlanStatus::OK);
+        TEST_EQUAL(matcher.seeded_pixels(), 0);
+        TEST_ASSERT(dst == truth);
+    }
+
+    void test_changed_scene() {
+        const auto before1 = random_matrix(height, width, 5);
+        const auto before2 = random_matrix(height, width, 6);
+        const auto after1 = random_matrix(height, width, 7);
+        const auto after2 = random_matrix(height, width, 8);
+        const SizeType dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+
+        std::vector<uint16_t> truth(dst_size), dst(dst_size);
+        argMaxCorrMat<uint8_t, WideMatchingTraits<uint8_t>>(after1.data(), after2.data(), truth.data(),
+                                                            width, height, kernel_size, 0, 30);
+
+        // Configurazione di default: la soglia di confidenza è significativa
+        TemporalMatcher<uint8_t> matcher(width, height, kernel_size, 0, 30);
+        TEST_ASSERT(matcher.execute(before1.data(), before2.data(), dst.data()) == PlanStatus::OK);
+        // Ogni finestra è cambiata: nessun pixel usa il frame precedente
+        TEST_ASSERT(matcher.execute(after1.data(), after2.data(), dst.data()) == PlanStatus::OK);
+        TEST_EQUAL(matcher.seeded_pixels(), 0);
+        TEST_ASSERT(dst == truth);
+    }
+
+    void test_errors() {
+        const auto src = random_matrix(height, width, 9);
+        std::vector<uint16_t> dst(10, 7);
+
+        TemporalMatcher<uint8_t> bad(width, height, 6);
+        TEST_ASSERT(bad.status() == PlanStatus::INVALID_KERNEL_SIZE);
+        TEST_ASSERT(bad.execute(src.data(), src.data(), dst.data()) == PlanStatus::INVALID_PLAN);
+
+        TemporalMatcher<uint8_t> matcher(width, height, kernel_size);
+        TEST_ASSERT(matcher.execute(src.data(), nullptr, dst.data()) == PlanStatus::NULL_POINTER);
+        TEST_ASSERT(!matcher.has_history());
+        for (uint16_t v : dst) TEST_EQUAL(v, 7);
+    }
+};
+
+int main() {
+    TestTemporal().test();
+    return TEST_FAILURES;
+}
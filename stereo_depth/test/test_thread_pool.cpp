@@ -0,0 +1,132 @@
+/***************************************************************************
+ *            test_thread_pool.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "stereodepth/thread_pool.hpp"
+#include "stereodepth/tiled.hpp"
+#include "stereodepth/math.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <atomic>
+#include <stdexcept>
+
+using namespace std;
+using namespace stereodepth;
+
+class TestThreadPool {
+public:
+    void test() {
+        TEST_CALL(test_parallel_for());
+        TEST_CALL(test_exception());
+        TEST_CALL(test_nested());
+        TEST_CALL(test_matchers());
+        TEST_CALL(test_kernel_slide());
+    }
+
+private:
+    void test_parallel_for() {
+        ThreadPool pool(4);
+        TEST_EQUAL(pool.num_threads(), 4);
+
+        // Ogni indice viene visitato una sola volta, per qualsiasi grana
+        for (SizeType grain : {0, 1, 3, 1000}) {
+            std::vector<std::atomic<int>> hits(517);
+            for (auto &h : hits) h = 0;
+            pool.parallel_for(5, hits.size(), grain, [&](SizeType begin, SizeType end) {
+                for (SizeType i = begin; i < end; ++i) ++hits[i];
+            });
+            for (SizeType i = 0; i < hits.size(); ++i) TEST_EQUAL(hits[i].load(), i < 5 ? 0 : 1);
+        }
+
+        // Il pool sopravvive a molti frame
+        std::atomic<SizeType> total(0);
+        for (int frame = 0; frame < 200; ++frame)
+            pool.parallel_for(0, 64, 1, [&](SizeType begin, SizeType end) { total += end - begin; });
+        TEST_EQUAL(total.load(), 200 * 64);
+
+        bool called = false;
+        pool.parallel_for(3, 3, 1, [&](SizeType, SizeType) { called = true; });
+        TEST_ASSERT(!called);
+        TEST_ASSERT(ThreadPool::global().num_threads() >= 1);
+    }
+
+    void test_exception() {
+        ThreadPool pool(3);
+        std::atomic<int> done(0);
+        TEST_THROWS(pool.parallel_for(0, 30, 1, [&](SizeType begin, SizeType) {
+            if (begin == 17) throw std::runtime_error("chunk");
+            ++done;
+        }), std::runtime_error);
+        // Gli altri chunk sono comunque completati
+        TEST_EQUAL(done.load(), 29);
+    }
+
+    void test_nested() {
+        ThreadPool pool(3);
+        std::atomic<SizeType> total(0);
+        pool.parallel_for(0, 8, 1, [&](SizeType, SizeType) {
+            pool.parallel_for(0, 10, 1, [&](SizeType begin, SizeType end) { total += end - begin; });
+        });
+        TEST_EQUAL(total.load(), 80);
+    }
+
+    void test_matchers() {
+        const SizeType width = 67, height = 31, kernel_size = 5;
+        const auto src1 = random_matrix(height, width, 1);
+        const auto src2 = random_matrix(height, width, 2);
+        const SizeType dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+        std::vector<uint8_t> truth(dst_size), rows(dst_size), tiles(dst_size);
+        argMaxCorrMat<uint8_t>(src1.data(), src2.data(), truth.data(),
+                               width, height, kernel_size, -3, 16);
+
+        ThreadPool pool(3);
+        StereoMatcherPlan<uint8_t> plan(width, height, kernel_size, -3, 16);
+        TEST_ASSERT(plan.execute(src1.data(), src2.data(), rows.data(), pool) == PlanStatus::OK);
+        TEST_ASSERT(rows == truth);
+
+        TileConfig config;
+        config.tile_width = 9;
+        config.tile_height = 4;
+        TiledMatcher<uint8_t> tiled(width, height, kernel_size, -3, 16, config);
+        TEST_ASSERT(tiled.execute(src1.data(), src2.data(), tiles.data(), pool) == PlanStatus::OK);
+        TEST_ASSERT(tiles == truth);
+        TEST_ASSERT(tiled.execute(nullptr, src2.data(), tiles.data(), pool) == PlanStatus::NULL_POINTER);
+    }
+
+    void test_kernel_slide() {
+        using Op = std::function<void(float*, Math::Shape2d, Math::Coord2d,
+                                      const float*, Math::Shape3d,
+                                      const float*, Math::Shape2d, Math::Shape2d,
+                                      Math::Shape2d, int64_t, int64_t)>;
+        const SizeType width = 19, height = 13;
+        std::vector<float> src(width * height), truth(width * height), dst(width * height);
+        for (SizeType i = 0; i < src.size(); ++i) src[i] = static_cast<float>(i % 7);
+
+        // Ogni elemento dipende dalla propria posizione nella sorgente
+        Op op = [](float* out, Math::Shape2d shape, Math::Coord2d pos, const float* in,
+                   Math::Shape3d in_shape, const float*, Math::Shape2d, Math::Shape2d,
+                   Math::Shape2d, int64_t row, int64_t col) {
+            out[pos.row * shape.width() + pos.col] =
+                in[row * static_cast<int64_t>(in_shape.width()) + col]
+                + static_cast<float>(row - col);
+        };
+        Math::kernel_slide<float>(op, truth.data(), src.data(), {height, width, 1},
+                                  nullptr, {1, 1}, {1, 1}, {0, 0});
+        ThreadPool pool(4);
+        Math::kernel_slide_parallel<float>(pool, op, dst.data(), src.data(), {height, width, 1},
+                                           nullptr, {1, 1}, {1, 1}, {0, 0});
+        TEST_ASSERT(dst == truth);
+    }
+};
+
+int main() {
+    TestThreadPool().test();
+    return TEST_FAILURES;
+}
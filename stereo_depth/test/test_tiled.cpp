@@ -0,0 +1,118 @@
+/***************************************************************************
+ *            test_tiled.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "stereodepth/tiled.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+
+using namespace std;
+using namespace stereodepth;
+
+class TestTiled {
+public:
+    void test() {
+        TEST_CALL(test_make_tiles());
+        TEST_CALL(test_derived_shape());
+        TEST_CALL(test_equal_to_mat());
+        TEST_CALL(test_errors());
+    }
+
+private:
+    void test_make_tiles() {
+        const SizeType width = 23, height = 10;
+        const auto tiles = make_tiles(width, height, 8, 4);
+        TEST_EQUAL(tiles.size(), 9);
+
+        // Ogni pixel della destinazione appartiene a un solo tile
+        std::vector<int> hits(width * height, 0);
+        for (const auto &tile : tiles)
+            for (SizeType r = tile.row_begin; r < tile.row_end; ++r)
+                for (SizeType c = tile.col_begin; c < tile.col_end; ++c)
+                    ++hits[r * width + c];
+        for (int h : hits) TEST_EQUAL(h, 1);
+
+        TEST_ASSERT(make_tiles(0, 5, 4, 4).empty());
+    }
+
+    void test_derived_shape() {
+        const SizeType kernel_size = 9, span = 128, cache = 64 * 1024;
+        SizeType tile_width, tile_height;
+        derive_tile_shape(4408, 1234, kernel_size, span, 1, cache, tile_width, tile_height);
+        TEST_EQUAL(tile_width, span);
+        TEST_ASSERT(tile_height > 1);
+        TEST_ASSERT(tile_working_set(tile_width, tile_height, kernel_size, span, 1) <= cache);
+        TEST_ASSERT(tile_working_set(tile_width, tile_height + 1, kernel_size, span, 1) > cache);
+
+        // Con una cache minuscola il tile si restringe ma resta valido
+        derive_tile_shape(4408, 1234, kernel_size, span, 1, 512, tile_width, tile_height);
+        TEST_ASSERT(tile_width >= 1 && tile_width < span);
+        TEST_EQUAL(tile_height, 1);
+    }
+
+    void test_equal_to_mat() {
+        using Wide = WideMatchingTraits<uint8_t>;
+        const SizeType width = 71, height = 29;
+        const auto src1 = random_matrix(height, width, 1);
+        const auto src2 = random_matrix(height, width, 2);
+
+        for (SizeType kernel_size : {3, 5, 13}) {
+            const SizeType dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+            std::vector<uint8_t> truth(dst_size);
+            argMaxCorrMat<uint8_t>(src1.data(), src2.data(), truth.data(),
+                                   width, height, kernel_size, -4, 20);
+            std::vector<uint16_t> truth_wide(dst_size);
+            argMaxCorrMat<uint8_t, Wide>(src1.data(), src2.data(), truth_wide.data(),
+                                         width, height, kernel_size);
+
+            TileConfig configs[4];
+            configs[1].tile_width = 7; configs[1].tile_height = 3;
+            configs[2].tile_width = 1000; configs[2].tile_height = 1;
+            configs[3].cache_bytes = 2048; configs[3].num_threads = 3;
+            for (const auto &config : configs) {
+                TiledMatcher<uint8_t> matcher(width, height, kernel_size, -4, 20, config);
+                std::vector<uint8_t> dst(dst_size);
+                TEST_ASSERT(matcher.execute(src1.data(), src2.data(), dst.data()) == PlanStatus::OK);
+                TEST_ASSERT(dst == truth);
+
+                TiledMatcher<uint8_t, Wide> wide(width, height, kernel_size,
+                                                 DISPARITY_MIN_UNBOUNDED,
+                                                 DISPARITY_MAX_UNBOUNDED, config);
+                std::vector<uint16_t> dst_wide(dst_size);
+                // Tile eseguiti uno alla volta in ordine inverso
+                for (SizeType i = wide.tiles().size(); i-- > 0;)
+                    TEST_ASSERT(wide.execute_tile(src1.data(), src2.data(), dst_wide.data(), i) == PlanStatus::OK);
+                TEST_ASSERT(dst_wide == truth_wide);
+            }
+        }
+    }
+
+    void test_errors() {
+        const SizeType width = 20, height = 8;
+        const auto src = random_matrix(height, width, 3);
+        std::vector<uint8_t> dst(18 * 6, 7);
+
+        TiledMatcher<uint8_t> bad(width, height, 4);
+        TEST_ASSERT(bad.status() == PlanStatus::INVALID_KERNEL_SIZE);
+        TEST_ASSERT(bad.tiles().empty());
+        TEST_ASSERT(bad.execute(src.data(), src.data(), dst.data()) == PlanStatus::INVALID_PLAN);
+
+        TiledMatcher<uint8_t> matcher(width, height, 3);
+        TEST_ASSERT(matcher.execute(src.data(), nullptr, dst.data()) == PlanStatus::NULL_POINTER);
+        TEST_ASSERT(matcher.execute_tile(src.data(), src.data(), dst.data(), matcher.tiles().size()) == PlanStatus::INVALID_TILE);
+        TEST_ASSERT(matcher.plan().execute_tile(src.data(), src.data(), dst.data(), 0, 2, 5, 19) == PlanStatus::INVALID_TILE);
+        for (uint8_t v : dst) TEST_EQUAL(v, 7);
+    }
+};
+
+int main() {
+    TestTiled().test();
+    return TEST_FAILURES;
+}
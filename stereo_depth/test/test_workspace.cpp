@@ -0,0 +1,205 @@
+/***************************************************************************
+ *            test_workspace.cpp
+ *
+ *  Copyright  2022  Alessio Zattoni
+ *
+ ****************************************************************************/
+
+#include "test.hpp"
+#include "test_random.hpp"
+#include "stereodepth/workspace.hpp"
+#include "stereodepth/running_sum.hpp"
+#include "stereodepth/simd.hpp"
+#include "stereodepth/census.hpp"
+#include "stereodepth/pyramid.hpp"
+#include "stereodepth/sgm.hpp"
+#include "stereodepth/subpixel.hpp"
+#include "stereodepth/consistency.hpp"
+
+#include <vector>
+#include <iostream>
+#include <random>
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace std;
+using namespace stereodepth;
+
+// Conta le allocazioni sullo heap di tutto il programma, non solo del workspace
+static std::atomic<std::size_t> heap_allocations{0};
+
+void* operator new(std::size_t size) {
+    ++heap_allocations;
+    if (void *ptr = std::malloc(size ? size : 1)) return ptr;
+    throw std::bad_alloc();
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+
+class TestWorkspace {
+public:
+    void test() {
+        TEST_CALL(test_arena());
+        TEST_CALL(test_move());
+        TEST_CALL(test_with_copy());
+        TEST_CALL(test_steady_state());
+    }
+
+private:
+    void test_arena() {
+        TEST_EQUAL(MatcherWorkspace::bytes<uint8_t>(1), 64);
+        TEST_EQUAL(MatcherWorkspace::bytes<uint32_t>(16), 64);
+        TEST_EQUAL(MatcherWorkspace::bytes<uint32_t>(17), 128);
+
+        MatcherWorkspace workspace;
+        TEST_EQUAL(workspace.capacity(), 0);
+        TEST_ASSERT(workspace.reserve(100));
+        TEST_ASSERT(!workspace.reserve(128));
+        TEST_EQUAL(workspace.allocations(), 1);
+
+        // Ogni buffer è allineato a 64 byte
+        auto *a = workspace.allocate<uint8_t>(3);
+        auto *b = workspace.allocate<double>(2);
+        TEST_EQUAL(reinterpret_cast<std::uintptr_t>(a) % MatcherWorkspace::ALIGNMENT, 0);
+        TEST_EQUAL(reinterpret_cast<std::uintptr_t>(b) % MatcherWorkspace::ALIGNMENT, 0);
+        TEST_EQUAL(workspace.used(), 128);
+        TEST_THROWS(workspace.allocate<uint8_t>(1), std::length_error);
+        TEST_THROWS(workspace.reserve(1024), std::logic_error);
+
+        workspace.rewind(64);
+        TEST_ASSERT(workspace.allocate<double>(2) == b);
+        workspace.rewind(0);
+        TEST_ASSERT(workspace.reserve(1024));
+        TEST_EQUAL(workspace.allocations(), 2);
+    }
+
+    void test_move() {
+        MatcherWorkspace a(256);
+        (void) a.allocate<uint8_t>(10);
+        unsigned char *data = a.allocate<uint8_t>(1);
+
+        // Il workspace spostato resta vuoto e non condivide la memoria
+        MatcherWorkspace b(std::move(a));
+        TEST_EQUAL(a.capacity(), 0);
+        TEST_EQUAL(a.used(), 0);
+        TEST_EQUAL(a.allocations(), 0);
+        TEST_THROWS(a.allocate<uint8_t>(1), std::length_error);
+        TEST_EQUAL(b.capacity(), 256);
+        TEST_EQUAL(b.used(), 128);
+        TEST_EQUAL(b.allocations(), 1);
+        b.rewind(64);
+        TEST_ASSERT(b.allocate<uint8_t>(1) == data);
+
+        MatcherWorkspace c;
+        c = std::move(b);
+        TEST_EQUAL(b.capacity(), 0);
+        TEST_THROWS(b.allocate<uint8_t>(1), std::length_error);
+        TEST_EQUAL(c.used(), 128);
+        c.rewind(0);
+        TEST_ASSERT(a.reserve(64));
+        TEST_ASSERT(a.allocate<uint8_t>(1) != c.allocate<uint8_t>(1));
+    }
+
+    void test_with_copy() {
+        const SizeType width = 37, height = 13;
+        const auto src1 = random_matrix(height, width, 1);
+        const auto src2 = random_matrix(height, width, 2);
+
+        MatcherWorkspace workspace;
+        for (SizeType kernel_size : {3, 5, 9}) {
+            const SizeType dst_size = (width - (kernel_size - 1)) * (height - (kernel_size - 1));
+            std::vector<uint8_t> truth(dst_size), dst(dst_size);
+            argMaxCorrMat<uint8_t>(src1.data(), src2.data(), truth.data(),
+                                   width, height, kernel_size, -2, 8);
+            argMaxCorrMatWithCopy<uint8_t>(src1.data(), src2.data(), dst.data(),
+                                           width, height, kernel_size, workspace, -2, 8);
+            TEST_ASSERT(dst == truth);
+            TEST_EQUAL(workspace.used(), 0);
+        }
+    }
+
+    void test_steady_state() {
+        using Traits = WideMatchingTraits<uint8_t>;
+        const SizeType width = 64, height = 20, kernel_size = 5, levels = 2;
+        const std::int64_t min_d = -4, max_d = 12;
+        const SizeType dst_width = width - (kernel_size - 1), dst_height = height - (kernel_size - 1);
+        const SizeType dst_size = dst_width * dst_height;
+        SgmParameters params;
+        params.num_threads = 2;
+
+        // Dimensionato una volta per risoluzione, kernel e intervallo
+        MatcherWorkspace workspace(std::max({
+            withCopyWorkspaceSize<uint8_t, Traits>(width, kernel_size),
+            runningSumWorkspaceSize<uint8_t, Traits>(width, kernel_size, min_d, max_d),
+            simdWorkspaceSize<Traits>(width, kernel_size),
+            censusWorkspaceSize(width, height),
+            pyramidWorkspaceSize<uint8_t>(width, height, kernel_size, levels),
+            sgm_census_workspace_size(width, height, kernel_size, min_d, max_d, params),
+            left_right_workspace_size<uint16_t>(dst_height, dst_width)}));
+        TEST_EQUAL(workspace.allocations(), 1);
+
+        std::vector<std::vector<uint8_t>> src1, src2;
+        for (unsigned frame = 0; frame < 4; ++frame) {
+            src1.push_back(random_matrix(height, width, 10 + frame));
+            src2.push_back(random_matrix(height, width, 20 + frame));
+        }
+
+        std::vector<uint16_t> truth(dst_size), copy(dst_size), sum(dst_size), simd(dst_size);
+        std::vector<uint16_t> census_truth(dst_size), census(dst_size), pyramid(dst_size);
+        std::vector<uint16_t> sgm_truth(dst_size), sgm(dst_size);
+        std::vector<int16_t> disparity(dst_size), checked_truth(dst_size), checked(dst_size);
+        CostVolume<uint16_t> costs, aggregated;
+        SizeType invalidated = 0;
+
+        std::size_t steady_allocations = 0;
+        for (unsigned frame = 0; frame < 4; ++frame) {
+            const uint8_t *s1 = src1[frame].data(), *s2 = src2[frame].data();
+            argMaxCorrMat<uint8_t, Traits>(s1, s2, truth.data(), width, height, kernel_size, min_d, max_d);
+            argMinCensusMat<uint8_t, Traits>(s1, s2, census_truth.data(), width, height, kernel_size, min_d, max_d);
+            sgm_census_disparity(s1, s2, sgm_truth.data(), width, height, kernel_size, min_d, max_d, params);
+
+            // Nessuna macro di test nella finestra misurata
+            const std::size_t before = heap_allocations;
+            argMaxCorrMatWithCopy<uint8_t, Traits>(s1, s2, copy.data(),
+                                                   width, height, kernel_size, workspace, min_d, max_d);
+            argMaxCorrMatRunningSum<uint8_t, Traits>(s1, s2, sum.data(),
+                                                     width, height, kernel_size, workspace, min_d, max_d);
+            argMaxCorrMatSimd<Traits>(s1, s2, simd.data(), width, height, kernel_size, workspace, min_d, max_d);
+            argMinCensusMat<uint8_t, Traits>(s1, s2, census.data(), width, height, kernel_size, workspace,
+                                             min_d, max_d);
+            // Con raggio pari all'intervallo il risultato coincide con argMaxCorrMat
+            argMaxCorrMatPyramid<uint8_t, Traits>(s1, s2, pyramid.data(), width, height, kernel_size, levels,
+                                                  workspace, max_d - min_d, min_d, max_d);
+            sgm_census_disparity(s1, s2, sgm.data(), width, height, kernel_size,
+                                 costs, aggregated, workspace, min_d, max_d, params);
+            subpixel_disparity(disparity.data(), aggregated, CostOrder::MINIMIZE);
+            std::copy(disparity.begin(), disparity.end(), checked.begin());
+            invalidated = left_right_check(checked.data(), aggregated, CostOrder::MINIMIZE, 1, workspace);
+            const std::size_t after = heap_allocations;
+            // Il primo frame dimensiona i volumi dei costi
+            if (frame > 0) steady_allocations += after - before;
+
+            TEST_ASSERT(copy == truth);
+            TEST_ASSERT(sum == truth);
+            TEST_ASSERT(simd == truth);
+            TEST_ASSERT(census == census_truth);
+            TEST_ASSERT(pyramid == truth);
+            TEST_ASSERT(sgm == sgm_truth);
+            std::copy(disparity.begin(), disparity.end(), checked_truth.begin());
+            TEST_EQUAL(left_right_check(checked_truth.data(), aggregated, CostOrder::MINIMIZE, 1), invalidated);
+            TEST_ASSERT(checked == checked_truth);
+        }
+        // Nessuna allocazione sullo heap dopo il primo frame
+        TEST_EQUAL(steady_allocations, 0);
+        TEST_EQUAL(workspace.allocations(), 1);
+        TEST_EQUAL(workspace.used(), 0);
+    }
+};
+
+int main() {
+    TestWorkspace().test();
+    return TEST_FAILURES;
+}